@@ -0,0 +1,59 @@
+#ifndef COMPONENTPANEL_H
+#define COMPONENTPANEL_H
+
+#include <QWidget>
+#include <QColor>
+#include <QLabel>
+#include "meshsegmentation.h"
+
+class QTableWidget;
+
+// Lists the connected components of the loaded model with their statistics
+// and lets each one be shown, hidden, recolored and selected
+class ComponentPanel : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit ComponentPanel(QWidget *parent = nullptr);
+    
+    void setSegmentation(const Segmentation& segmentation);
+    void clear();
+    
+    // Selects the component's row alone, scrolled into view; a negative
+    // index clears the selection
+    void selectComponent(int component);
+    
+    // Packed color per component as drawn: the highlight for selected
+    // components, otherwise the component's own color
+    QVector<quint16> componentColors() const;
+    QVector<bool> visibility() const;
+
+signals:
+    void visibilityChanged();
+    void colorsChanged();
+
+private slots:
+    void onItemChanged();
+    void onCellDoubleClicked(int row, int column);
+    void showAll();
+    void hideSelected();
+    void isolateSelected();
+
+private:
+    enum Column {
+        VisibleColumn,
+        ColorColumn,
+        FacetsColumn,
+        VolumeColumn,
+        SizeColumn,
+        ColumnCount
+    };
+    
+    QLabel* m_summaryLabel;
+    QTableWidget* m_table;
+    QVector<QColor> m_colors;
+    bool m_updating;
+};
+
+#endif // COMPONENTPANEL_H
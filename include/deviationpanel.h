@@ -0,0 +1,43 @@
+#ifndef DEVIATIONPANEL_H
+#define DEVIATIONPANEL_H
+
+#include <QWidget>
+#include <QLabel>
+#include "meshdeviation.h"
+
+// Bar chart of a deviation histogram, colored like the viewer's color map
+class DeviationHistogram : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit DeviationHistogram(QWidget *parent = nullptr);
+    
+    void setHistogram(const QVector<qint64>& bins, float range);
+    QSize sizeHint() const override;
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+
+private:
+    QVector<qint64> m_bins;
+    float m_range;
+};
+
+class DeviationPanel : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit DeviationPanel(QWidget *parent = nullptr);
+    
+    void setResult(const QString& referenceName, const QString& testName,
+                   const DeviationResult& result);
+
+private:
+    QLabel* m_titleLabel;
+    QLabel* m_statsLabel;
+    DeviationHistogram* m_histogram;
+};
+
+#endif // DEVIATIONPANEL_H
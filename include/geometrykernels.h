@@ -0,0 +1,92 @@
+#ifndef GEOMETRYKERNELS_H
+#define GEOMETRYKERNELS_H
+
+#include <QtGlobal>
+
+// Structure-of-arrays views of a point set
+struct PointsSoA {
+    float* x;
+    float* y;
+    float* z;
+};
+
+struct ConstPointsSoA {
+    const float* x;
+    const float* y;
+    const float* z;
+};
+
+// Fixed-size scratch for streaming array-of-structures data through the
+// kernels one cache-resident block at a time
+struct PointBlock {
+    static constexpr qsizetype kSize = 1024;
+    
+    alignas(64) float x[kSize];
+    alignas(64) float y[kSize];
+    alignas(64) float z[kSize];
+    
+    void set(qsizetype i, float px, float py, float pz)
+    {
+        x[i] = px;
+        y[i] = py;
+        z[i] = pz;
+    }
+    
+    PointsSoA points() { return {x, y, z}; }
+    ConstPointsSoA constPoints() const { return {x, y, z}; }
+};
+
+// Per-point geometry kernels with SSE, AVX2 and AVX-512 implementations
+// picked at runtime for the host CPU, and a portable scalar fallback. Every
+// implementation performs the same IEEE operations in the same order, so
+// results are bit-identical whichever one runs (bounds only differ in the
+// sign of a zero when both -0 and +0 occur).
+class GeometryKernels
+{
+public:
+    enum class Isa {
+        Scalar,
+        SSE,
+        AVX2,
+        AVX512
+    };
+    
+    // Chosen once from the CPU; STLVIEWER_KERNEL_ISA=scalar|sse|avx2|avx512
+    // forces a lower level for comparison runs
+    static Isa activeIsa();
+    static Isa bestSupportedIsa();
+    static const char* isaName(Isa isa);
+    static bool setActiveIsa(Isa isa); // false if the CPU lacks it
+    
+    // n = normalize((b - a) x (c - a)); degenerate facets get a zero normal
+    static void facetNormals(ConstPointsSoA a, ConstPointsSoA b, ConstPointsSoA c,
+                             PointsSoA n, qsizetype count);
+    
+    // Grows minBounds/maxBounds (xyz) to enclose the points
+    static void extendBounds(ConstPointsSoA p, qsizetype count,
+                             float* minBounds, float* maxBounds);
+    
+    // p = (p + translation) * scale
+    static void translateScale(PointsSoA p, qsizetype count,
+                               const float* translation, float scale);
+    
+    // p = M * (p, 1) for a column-major 4x4 affine matrix
+    static void transform(PointsSoA p, qsizetype count, const float* matrix);
+    
+    // dots[i] = n[i] . direction; returns the sum of weights[i] over the
+    // points with dots[i] > threshold. The sum is kept in kPartialSums
+    // interleaved partials folded in a fixed order, so it too is identical
+    // on every path.
+    static constexpr int kPartialSums = 16;
+    static float facingWeight(ConstPointsSoA n, const float* weights, qsizetype count,
+                              const float* direction, float threshold, float* dots);
+    
+    // hits[i] = triangle (a[0], a[1], a[2])[i] properly crosses triangle
+    // (b[0], b[1], b[2])[i], by Moller's interval test. Touching and coplanar
+    // pairs do not count: corners closer to the other plane than 1e-5 of the
+    // square root of its triangle's doubled area lie on it.
+    static void trianglesCross(const ConstPointsSoA a[3], const ConstPointsSoA b[3],
+                               qsizetype count, bool* hits);
+};
+
+#endif // GEOMETRYKERNELS_H
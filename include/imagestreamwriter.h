@@ -0,0 +1,71 @@
+#ifndef IMAGESTREAMWRITER_H
+#define IMAGESTREAMWRITER_H
+
+#include <QString>
+#include <QFile>
+#include <QByteArray>
+#include <memory>
+
+// Writes an 8-bit RGB image a band of rows at a time, top row first, so an
+// image of any height is encoded without holding more than one band
+class ImageStreamWriter
+{
+public:
+    virtual ~ImageStreamWriter() = default;
+    
+    // Picks the encoder from the file suffix (.png, .tif, .tiff); null for
+    // anything else
+    static std::unique_ptr<ImageStreamWriter> create(const QString& filename);
+    static bool isSupported(const QString& filename);
+    
+    virtual bool begin(const QString& filename, int width, int height, QString& error) = 0;
+    // 'rgb' holds 'rows' tightly packed rows of width * 3 bytes
+    virtual bool writeRows(const uchar* rgb, int rows, QString& error) = 0;
+    virtual bool finish(QString& error) = 0;
+};
+
+class PngStreamWriter : public ImageStreamWriter
+{
+public:
+    PngStreamWriter();
+    ~PngStreamWriter() override;
+    
+    bool begin(const QString& filename, int width, int height, QString& error) override;
+    bool writeRows(const uchar* rgb, int rows, QString& error) override;
+    bool finish(QString& error) override;
+
+private:
+    void compress(const uchar* data, qsizetype size, bool last);
+    bool writeChunk(const char* type, const QByteArray& data);
+    bool flushImageData(bool force);
+    
+    QFile m_file;
+    int m_width;
+    int m_height;
+    int m_rowsWritten;
+    QByteArray m_filteredRow;
+    // Compressed bytes waiting to go out as the next IDAT chunk
+    QByteArray m_imageData;
+    // zlib stream state when built against zlib, otherwise the running
+    // Adler-32 of the uncompressed stored blocks
+    void* m_stream;
+    quint32 m_adler;
+};
+
+class TiffStreamWriter : public ImageStreamWriter
+{
+public:
+    TiffStreamWriter();
+    
+    bool begin(const QString& filename, int width, int height, QString& error) override;
+    bool writeRows(const uchar* rgb, int rows, QString& error) override;
+    bool finish(QString& error) override;
+
+private:
+    QFile m_file;
+    int m_width;
+    int m_height;
+    int m_rowsWritten;
+};
+
+#endif // IMAGESTREAMWRITER_H
@@ -11,8 +11,29 @@
 #include <QPushButton>
 #include <QStatusBar>
 #include <QProgressBar>
+#include <QFutureWatcher>
+#include <QElapsedTimer>
+#include "meshoverhang.h"
+#include "meshhull.h"
+#include "trianglebvh.h"
 
 class STLViewer;
+class MeshScene;
+struct ViewCamera;
+struct ParsedMesh;
+struct Comparison;
+struct InterferenceCheck;
+struct ComponentSearch;
+struct Voxelization;
+struct OrientationSearch;
+class DeviationPanel;
+class ComponentPanel;
+class OverhangPanel;
+class OrientationPanel;
+struct OrientationCandidate;
+class QDockWidget;
+class QAction;
+class QTimer;
 
 class MainWindow : public QMainWindow
 {
@@ -21,23 +42,112 @@ class MainWindow : public QMainWindow
 public:
     MainWindow(QWidget *parent = nullptr);
     ~MainWindow();
+    
+    // Shows the first of 'files' once 'parsing', its parse already running
+    // on a worker, has finished and the window is ready
+    void openFiles(const QStringList& files, const QFuture<ParsedMesh>& parsing);
+    
+    // Reference point for the time-to-first-frame log, normally the start
+    // of main()
+    void setStartupTimer(const QElapsedTimer& timer);
 
 private slots:
     void openFile();
+    void exportImage();
     void resetView();
     void showAbout();
+    void compareMeshes();
+    void onCompareFinished();
+    void checkInterference();
+    void onInterferenceChecked();
+    void clearAnalysis();
+    void findComponents();
+    void onComponentsFound();
+    void onPickRequested(const QVector3D& origin, const QVector3D& direction);
+    void onComponentVisibilityChanged();
+    void onComponentColorsChanged();
+    void analyzeOverhangs();
+    void updateOverhangs();
+    void voxelize();
+    void onVoxelized();
+    void optimizeOrientation();
+    void onOrientationsFound();
+    void onOrientationSelected(const OrientationCandidate& candidate);
     void onModelLoaded(const QString& filename, int triangleCount);
     void onLoadError(const QString& error);
+    void onMemoryUsageChanged();
+    void onParseFinished();
+    void onFrameSwapped();
+    void setFourViewports(bool enabled);
+    void setLinkCameras(bool enabled);
 
 private:
     void setupUI();
     void setupMenuBar();
     void setupStatusBar();
     
+    // Analyses that color the model through the scene's one facet overlay
+    enum class OverlayOwner {
+        None,
+        Components,
+        Overhangs,
+        ThinWalls,
+        Interference
+    };
+    
+    void onCameraChanged(STLViewer* source, const ViewCamera& camera);
+    void repaintLinkedViewers();
+    void startLoad(const QString& filename);
+    void watchLoad(const QFuture<ParsedMesh>& parsing);
+    void setAnalysisOverlay(OverlayOwner owner, const QVector<quint16>& colors);
+    
+    MeshScene* m_scene;
     STLViewer* m_viewer;
+    // Every viewport, including m_viewer; all draw the one shared scene
+    QList<STLViewer*> m_viewers;
+    bool m_linkCameras;
+    // Viewers that follow a linked camera repaint on this timer rather than
+    // with every move of the one being dragged
+    QTimer* m_linkedRepaintTimer;
+    STLViewer* m_cameraSource;
     QLabel* m_statusLabel;
+    QLabel* m_memoryLabel;
     QProgressBar* m_progressBar;
     QPushButton* m_resetButton;
+    DeviationPanel* m_deviationPanel;
+    QDockWidget* m_deviationDock;
+    ComponentPanel* m_componentPanel;
+    QDockWidget* m_componentDock;
+    // Facets of the segmented model, for picking components by clicking
+    TriangleBVH m_pickTree;
+    OverhangPanel* m_overhangPanel;
+    QDockWidget* m_overhangDock;
+    // Facet normals and areas of the loaded model, extracted on first use
+    MeshOverhang m_overhang;
+    QAction* m_showVoxelsAction;
+    OverlayOwner m_overlayOwner;
+    OrientationPanel* m_orientationPanel;
+    QDockWidget* m_orientationDock;
+    // Hull of the last orientation search, drawn under the selected box
+    ShapeSurface m_hullSurface;
+    
+    QFutureWatcher<ParsedMesh>* m_loadWatcher;
+    // Reference and test meshes of a comparison, parsed side by side and
+    // measured on a worker
+    QFutureWatcher<Comparison>* m_compareWatcher;
+    // Assembly parts parsed and checked against each other on a worker
+    QFutureWatcher<InterferenceCheck>* m_interferenceWatcher;
+    // Analyses of the loaded model, run on workers; loading another model
+    // cancels them so a late result is dropped
+    QFutureWatcher<ComponentSearch>* m_componentWatcher;
+    QFutureWatcher<Voxelization>* m_voxelWatcher;
+    QFutureWatcher<OrientationSearch>* m_orientationWatcher;
+    
+    // Time-to-first-frame measurement
+    QElapsedTimer m_startupTimer;
+    QElapsedTimer m_openTimer;
+    bool m_firstFrameLogged;
+    bool m_awaitingModelFrame;
 };
 
 #endif // MAINWINDOW_H
@@ -0,0 +1,35 @@
+#ifndef MESHDEVIATION_H
+#define MESHDEVIATION_H
+
+#include <QVector>
+#include <QVector3D>
+
+// Forward declaration - Triangle is defined in stlviewer.h
+struct Triangle;
+
+struct DeviationResult {
+    // Signed distance from each corner of the test mesh to the reference,
+    // three per facet in facet order; positive is outside the reference
+    QVector<float> cornerDistances;
+    
+    qsizetype vertexCount = 0;
+    float minDistance = 0.0f;
+    float maxDistance = 0.0f;
+    float maxAbsDistance = 0.0f;
+    float meanDistance = 0.0f;
+    float rmsDistance = 0.0f;
+    
+    // Equal-width bins over [-maxAbsDistance, maxAbsDistance]
+    QVector<qint64> histogram;
+    qint64 elapsedMs = 0;
+};
+
+class MeshDeviation
+{
+public:
+    static DeviationResult compute(const QVector<Triangle>& reference,
+                                   const QVector<Triangle>& test,
+                                   int histogramBins = 41);
+};
+
+#endif // MESHDEVIATION_H
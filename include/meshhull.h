@@ -0,0 +1,99 @@
+#ifndef MESHHULL_H
+#define MESHHULL_H
+
+#include <QVector>
+#include <QVector3D>
+#include <QPair>
+
+struct ConvexHull {
+    QVector<QVector3D> vertices;
+    QVector<quint32> indices; // three per face, counter-clockwise seen from outside
+    qint64 elapsedMs = 0;
+
+    bool isEmpty() const { return indices.isEmpty(); }
+    int faceCount() const { return int(indices.size() / 3); }
+};
+
+struct OrientedBox {
+    QVector3D center;
+    QVector3D axes[3];     // orthonormal and right-handed
+    QVector3D halfExtents; // along axes[0..2]
+    qint64 elapsedMs = 0;
+
+    QVector3D size() const { return 2.0f * halfExtents; }
+    double volume() const
+    {
+        return 8.0 * double(halfExtents.x()) * double(halfExtents.y()) * double(halfExtents.z());
+    }
+};
+
+// Faces as triangles with packed per-triangle colors (see
+// STLLoader::kFacetColorValid), ready for MeshScene::setShapeSurface()
+struct ShapeSurface {
+    QVector<QVector3D> vertices;
+    QVector<QVector3D> normals;
+    QVector<quint16> faceColors;
+
+    bool isEmpty() const { return vertices.isEmpty(); }
+    void append(const ShapeSurface& other)
+    {
+        vertices += other.vertices;
+        normals += other.normals;
+        faceColors += other.faceColors;
+    }
+};
+
+// Extent of a hull along a direction, and the smallest rectangle that
+// encloses it seen along that direction
+struct Footprint {
+    float height = 0.0f;
+    double area = 0.0;
+    QVector3D axis;      // one side of the rectangle, across the direction
+    float width = 0.0f;  // along axis
+    float depth = 0.0f;
+};
+
+class MeshHull
+{
+public:
+    // Quickhull. Points well inside the polytope of their extreme points are
+    // discarded up front, and large sets are split into chunks whose hulls
+    // are built in parallel and then merged. Side-of-plane tests run on the
+    // points snapped to a fine grid, so the hull is exact to about a
+    // millionth of the model size. Empty for coplanar input.
+    static ConvexHull compute(const QVector<QVector3D>& points);
+
+    // Approximately the smallest enclosing box. Candidate orientations come
+    // from the faces and edges of a hull simplified to a coarse grid: a box
+    // face flush with a face, an axis along an edge, or a face parallel to
+    // two edges. The best is turned in small steps, last against the full
+    // hull, while that shrinks it. Only this neighbourhood is searched, so the
+    // box can be larger than the true minimum, though never larger than the
+    // axis-aligned one. The extents are taken over every hull vertex, so the
+    // box always contains them. An empty hull gives a zero-size box at the
+    // origin.
+    static OrientedBox minimalBox(const ConvexHull& hull);
+
+    // Box with the given orthonormal, right-handed axes around every hull
+    // vertex
+    static OrientedBox boxAlong(const ConvexHull& hull, const QVector3D axes[3]);
+
+    // Corners snapped to a grid of 'cells' per side, one kept per cell, and
+    // their hull. Used to keep per-direction searches cheap on big hulls.
+    static ConvexHull simplified(const ConvexHull& hull, int cells);
+
+    // Rotating calipers around the hull seen along the direction; only the
+    // vertices on its silhouette are projected
+    static Footprint footprint(const ConvexHull& hull, const QVector3D& direction);
+
+    // Unit normal and area of each face, largest first, merging faces whose
+    // normals agree within about a degree
+    static QVector<QPair<QVector3D, double>> faceDirections(const ConvexHull& hull, int maxCount);
+
+    // Faces for display in one color. Large hulls are simplified first, so
+    // what is drawn may lie slightly inside the true hull.
+    static ShapeSurface surface(const ConvexHull& hull, quint16 color);
+    static ShapeSurface surface(const OrientedBox& box, quint16 color);
+};
+
+#endif // MESHHULL_H
@@ -0,0 +1,64 @@
+#ifndef MESHINTERFERENCE_H
+#define MESHINTERFERENCE_H
+
+#include <QVector>
+#include <QVector3D>
+
+// Forward declaration - Triangle is defined in stlviewer.h
+struct Triangle;
+
+// Interference between two parts of an assembly
+struct PartClearance {
+    int partA = 0;
+    int partB = 0;
+
+    // Facet pairs that cross each other; parts that only touch (shared
+    // faces, edges or vertices) have none
+    qint64 intersectingPairs = 0;
+
+    // Without crossing pairs, the part (partA or partB) that lies wholly
+    // inside the other, or -1
+    int enclosedPart = -1;
+
+    // Smallest distance between the surfaces, 0 when they intersect, nest
+    // or touch, and the closest points and facets when they do not intersect
+    float distance = 0.0f;
+    QVector3D pointA;
+    QVector3D pointB;
+    quint32 facetA = 0;
+    quint32 facetB = 0;
+
+    bool intersects() const { return intersectingPairs > 0 || enclosedPart >= 0; }
+};
+
+struct InterferenceResult {
+    // One entry per pair of parts, (0,1), (0,2), ... (1,2), ...
+    QVector<PartClearance> pairs;
+
+    // Per part, ascending indices of the facets that cross another part
+    QVector<QVector<quint32>> intersectingFacets;
+
+    float minDistance = 0.0f;
+    qint64 elapsedMs = 0;
+};
+
+class MeshInterference
+{
+public:
+    // Checks every pair of parts for crossing facets and measures the
+    // clearance of those that do not cross
+    static InterferenceResult compute(const QVector<QVector<Triangle>>& parts);
+
+    // True when the triangles properly cross; touching and coplanar
+    // triangles do not count
+    static bool trianglesIntersect(const QVector3D& a0, const QVector3D& a1, const QVector3D& a2,
+                                   const QVector3D& b0, const QVector3D& b1, const QVector3D& b2);
+
+    // Squared distance between two triangles that do not cross, with the
+    // closest point on each
+    static float triangleDistanceSquared(const QVector3D& a0, const QVector3D& a1, const QVector3D& a2,
+                                         const QVector3D& b0, const QVector3D& b1, const QVector3D& b2,
+                                         QVector3D& pointA, QVector3D& pointB);
+};
+
+#endif // MESHINTERFERENCE_H
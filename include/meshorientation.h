@@ -0,0 +1,52 @@
+#ifndef MESHORIENTATION_H
+#define MESHORIENTATION_H
+
+#include <QVector>
+#include <QVector3D>
+#include "meshhull.h"
+
+// Forward declaration - Triangle is defined in stlviewer.h
+struct Triangle;
+
+// Each term is a cost, divided by its largest value over the candidates
+// before weighting
+struct OrientationWeights {
+    double height = 0.5;
+    double support = 1.0;
+    double footprint = 0.25;
+};
+
+struct OrientationCandidate {
+    QVector3D up;               // build direction in model coordinates
+    float height = 0.0f;
+    double supportArea = 0.0;   // overhang area, plate contact excluded
+    double footprintArea = 0.0; // smallest rectangle on the plate
+    double score = 0.0;         // lower is better
+    // Upright around the hull, sides along the footprint rectangle; set for
+    // the candidates measured on the full mesh
+    OrientedBox box;
+};
+
+struct OrientationResult {
+    ConvexHull hull;
+    OrientedBox box;
+    QVector3D boundsSize; // axis-aligned, for comparison with the box
+    // Best first, measured on the full mesh
+    QVector<OrientationCandidate> candidates;
+    int evaluated = 0;    // directions scored in the coarse search
+    qint64 searchMs = 0;
+    qint64 elapsedMs = 0;
+};
+
+class MeshOrientation
+{
+public:
+    // Candidate build directions rest a large hull face or a side of the
+    // minimal box on the plate. All are scored from a facet normal histogram
+    // and a simplified hull in parallel; the best few are then measured
+    // exactly and ranked.
+    static OrientationResult optimize(const QVector<Triangle>& triangles, float criticalAngle,
+                                      const OrientationWeights& weights = OrientationWeights());
+};
+
+#endif // MESHORIENTATION_H
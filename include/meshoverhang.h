@@ -0,0 +1,50 @@
+#ifndef MESHOVERHANG_H
+#define MESHOVERHANG_H
+
+#include <QVector>
+#include <QVector3D>
+
+// Forward declaration - Triangle is defined in stlviewer.h
+struct Triangle;
+
+struct OverhangResult {
+    // Packed overlay color per facet (see STLLoader::kFacetColorValid):
+    // overhangs from yellow at the critical angle to red facing straight
+    // down, facets resting on the build plate in blue, the rest unset
+    QVector<quint16> facetColors;
+
+    qsizetype overhangFacets = 0;
+    double overhangArea = 0.0;
+    double plateArea = 0.0;
+    double totalArea = 0.0;
+    double elapsedMs = 0.0;
+};
+
+// Classifies facets by their angle to a build direction. The facet normals,
+// areas and centroids are extracted once per model, so reclassifying for a
+// new orientation only streams them through one vectorized pass.
+class MeshOverhang
+{
+public:
+    void setMesh(const QVector<Triangle>& triangles);
+    void clear();
+    bool isEmpty() const { return m_areas.isEmpty(); }
+
+    // A downward-facing facet needs support when it leans further than
+    // criticalAngle (degrees) from vertical
+    OverhangResult classify(const QVector3D& buildDirection, float criticalAngle) const;
+
+private:
+    // Unit geometric normals, areas and centroids, structure of arrays
+    QVector<float> m_normalX;
+    QVector<float> m_normalY;
+    QVector<float> m_normalZ;
+    QVector<float> m_areas;
+    QVector<float> m_centroidX;
+    QVector<float> m_centroidY;
+    QVector<float> m_centroidZ;
+    double m_totalArea = 0.0;
+    float m_size = 0.0f;
+};
+
+#endif // MESHOVERHANG_H
@@ -0,0 +1,240 @@
+#ifndef MESHSCENE_H
+#define MESHSCENE_H
+
+#include <QObject>
+#include <QOpenGLBuffer>
+#include <QOpenGLShaderProgram>
+#include <QOpenGLVertexArrayObject>
+#include <QMatrix4x4>
+#include <QVector3D>
+#include <QHash>
+#include "stlviewer.h"
+#include "meshsegmentation.h"
+
+class QOpenGLContext;
+class QOffscreenSurface;
+class QOpenGLExtraFunctions;
+struct VoxelSurface;
+struct ShapeSurface;
+
+// Bytes held by each copy of the geometry, on the CPU and on the GPU
+struct MemoryUsage {
+    qint64 triangles = 0;
+    qint64 vertices = 0;
+    qint64 normals = 0;
+    qint64 facetColors = 0;
+    qint64 components = 0;
+    qint64 gpuVertices = 0;
+    qint64 gpuNormals = 0;
+    qint64 gpuScalars = 0;
+    qint64 gpuFacetColors = 0;
+    qint64 gpuOverlay = 0;
+    qint64 gpuIndices = 0;
+    qint64 gpuVoxels = 0;
+    qint64 gpuShapes = 0;
+
+    qint64 cpuTotal() const { return triangles + vertices + normals + facetColors + components; }
+    qint64 gpuTotal() const
+    {
+        return gpuVertices + gpuNormals + gpuScalars + gpuFacetColors + gpuOverlay + gpuIndices
+             + gpuVoxels + gpuShapes;
+    }
+};
+
+// A file read and decoded off the GUI thread, ready for MeshScene to upload
+struct ParsedMesh {
+    QString filename;
+    QVector<Triangle> triangles;
+    QVector<quint16> facetColors;
+    QString error;
+    qint64 parseMs = 0;
+};
+
+// The loaded model and its GPU resources, shared by every viewport. Buffers,
+// textures and the shader program live in the application-wide share group
+// and are uploaded once through the scene's own offscreen context; each
+// context that draws the scene only gets its own vertex array object.
+class MeshScene : public QObject
+{
+    Q_OBJECT
+
+public:
+    // Which CPU copies of the geometry survive the GPU upload
+    enum class MemoryMode {
+        FullCopies,   // triangles plus the expanded vertex/normal arrays
+        Compact,      // triangles only; the expanded arrays live on the GPU
+        GpuResident   // no CPU copies at all once uploaded
+    };
+    
+    // Why the last load failed; loadError() carries the message
+    enum class LoadFailure {
+        None,
+        File,       // the file could not be read or decoded
+        TooLarge,   // more facets than one OpenGL buffer holds
+        NoContext   // the platform could not create an OpenGL context
+    };
+
+    explicit MeshScene(QObject *parent = nullptr);
+    ~MeshScene();
+
+    bool loadSTL(const QString& filename);
+    LoadFailure lastLoadFailure() const { return m_lastLoadFailure; }
+    
+    // Parsing touches no scene or GL state and may run on any thread;
+    // loadParsed() then uploads the result on the GUI thread
+    static ParsedMesh parse(const QString& filename);
+    bool loadParsed(ParsedMesh mesh);
+    
+    // Creates the upload context and builds the shaders ahead of the first
+    // load, so it can overlap with parsing
+    bool initialize();
+    bool isLoaded() const { return m_modelLoaded; }
+    QString currentFile() const { return m_currentFile; }
+    int facetCount() const { return m_vertexCount / 3; }
+    
+    // Uniform scale that fits the model into a 2-unit cube around the origin
+    float modelScale() const { return m_modelScale; }
+    QVector3D center() const { return m_center; }
+    
+    MemoryMode memoryMode() const { return m_memoryMode; }
+    void setMemoryMode(MemoryMode mode);
+    MemoryUsage memoryUsage() const;
+    
+    // Source triangles; empty when the memory mode has released them
+    const QVector<Triangle>& triangles() const { return m_triangles; }
+    
+    // Per-corner values (three per facet) drawn through a diverging color
+    // map over [-range, range] in place of the object color
+    void setVertexScalars(const QVector<float>& cornerValues, float range);
+    void clearVertexScalars();
+    
+    // Packed per-facet colors (see STLLoader::kFacetColorValid) drawn over
+    // the file colors; facets without the valid bit keep their own color.
+    // Replacing the overlay never touches the geometry buffers.
+    void setFacetOverlay(const QVector<quint16>& colors);
+    void clearFacetOverlay();
+    
+    // Once components are set the facets are drawn through an index buffer
+    // grouped by component, and hidden components are skipped in the draw
+    void setComponents(const Segmentation& segmentation);
+    void clearComponents();
+    const Segmentation& segmentation() const { return m_segmentation; }
+    bool isComponentVisible(int component) const { return m_componentVisible.value(component); }
+    void setComponentVisible(int component, bool visible);
+    void setComponentsVisible(const QVector<bool>& visible);
+    
+    // Voxel faces in model coordinates with packed per-triangle colors,
+    // drawn in place of the model while shown. Only the GPU keeps them.
+    void setVoxelSurface(const VoxelSurface& surface);
+    void clearVoxelSurface();
+    bool hasVoxelSurface() const { return m_voxelVertexCount > 0; }
+    bool voxelsShown() const { return m_showVoxels; }
+    void setVoxelsShown(bool shown);
+    
+    // Translucent faces in model coordinates with packed per-triangle
+    // colors, such as a hull or a bounding box, drawn over whatever else is
+    // shown. Only the GPU keeps them.
+    void setShapeSurface(const ShapeSurface& surface);
+    void clearShapeSurface();
+    bool hasShapeSurface() const { return m_shapeVertexCount > 0; }
+    
+    // Draws into the current context, which must share with the scene
+    void draw(const QMatrix4x4& model, const QMatrix4x4& view,
+              const QMatrix4x4& projection, const QVector3D& viewPos);
+
+signals:
+    void modelLoaded(const QString& filename, int triangleCount);
+    void loadError(const QString& error);
+    void memoryUsageChanged();
+    void changed();
+
+private:
+    bool makeCurrent();
+    void doneCurrent();
+    void setupShaders();
+    void setupBuffers();
+    void calculateBoundingBox();
+    void uploadGeometry();
+    void uploadFacetColors();
+    bool uploadPackedColors(QOpenGLBuffer& buffer, GLuint texture, const QVector<quint16>& colors);
+    void updateDrawRanges();
+    void releaseCpuCopies();
+    void logMemoryUsage() const;
+    void bindAttributes(QOpenGLVertexArrayObject* vao);
+    void bindSurfaceAttributes(QOpenGLVertexArrayObject* vao, QOpenGLBuffer& vertexBuffer,
+                               QOpenGLBuffer& normalBuffer);
+    void drawShapes(QOpenGLExtraFunctions* f, QOpenGLVertexArrayObject* vao);
+    
+    // Upload context in the global share group
+    QOpenGLContext* m_context;
+    QOffscreenSurface* m_surface;
+    
+    QOpenGLShaderProgram* m_shaderProgram;
+    QOpenGLBuffer m_vertexBuffer;
+    QOpenGLBuffer m_normalBuffer;
+    QOpenGLBuffer m_scalarBuffer;
+    QOpenGLBuffer m_facetColorBuffer;
+    GLuint m_facetColorTexture;
+    QOpenGLBuffer m_overlayBuffer;
+    GLuint m_overlayTexture;
+    // Vertex indices in component order; element arrays are VAO state, so
+    // this is attached per context in bindAttributes()
+    QOpenGLBuffer m_indexBuffer;
+    QOpenGLBuffer m_voxelVertexBuffer;
+    QOpenGLBuffer m_voxelNormalBuffer;
+    QOpenGLBuffer m_voxelColorBuffer;
+    GLuint m_voxelColorTexture;
+    QOpenGLBuffer m_shapeVertexBuffer;
+    QOpenGLBuffer m_shapeNormalBuffer;
+    QOpenGLBuffer m_shapeColorBuffer;
+    GLuint m_shapeColorTexture;
+    
+    // Vertex array objects are not shareable, so each drawing context gets
+    // one; the revision tells it when attribute bindings went stale
+    struct ContextVao {
+        QOpenGLVertexArrayObject* vao;
+        int revision;
+        QOpenGLVertexArrayObject* voxelVao;
+        int voxelRevision;
+        QOpenGLVertexArrayObject* shapeVao;
+        int shapeRevision;
+    };
+    QHash<QOpenGLContext*, ContextVao> m_vaos;
+    int m_attributeRevision;
+    int m_voxelRevision;
+    int m_shapeRevision;
+    
+    QVector<Triangle> m_triangles;
+    QVector<QVector3D> m_vertices;
+    QVector<QVector3D> m_normals;
+    QVector<quint16> m_facetColors;
+    bool m_hasFacetColors;
+    int m_vertexCount;
+    bool m_hasScalars;
+    float m_scalarRange;
+    bool m_hasOverlay;
+    int m_voxelVertexCount;
+    bool m_hasVoxelColors;
+    bool m_showVoxels;
+    int m_shapeVertexCount;
+    bool m_hasShapeColors;
+    MemoryMode m_memoryMode;
+    
+    // Components and the merged facet ranges of the visible ones, in
+    // Segmentation::facetOrder positions
+    Segmentation m_segmentation;
+    QVector<bool> m_componentVisible;
+    QVector<QPair<qsizetype, qsizetype>> m_drawRanges;
+    
+    // Model bounds
+    QVector3D m_minBounds;
+    QVector3D m_maxBounds;
+    QVector3D m_center;
+    float m_modelScale;
+    
+    bool m_modelLoaded;
+    LoadFailure m_lastLoadFailure;
+    QString m_currentFile;
+};
+
+#endif // MESHSCENE_H
@@ -0,0 +1,37 @@
+#ifndef MESHSEGMENTATION_H
+#define MESHSEGMENTATION_H
+
+#include <QVector>
+#include <QVector3D>
+
+// Forward declaration - Triangle is defined in stlviewer.h
+struct Triangle;
+
+struct MeshComponent {
+    QVector3D minBounds;
+    QVector3D maxBounds;
+    qsizetype facetCount = 0;
+    // Offset of the component's first facet in Segmentation::facetOrder
+    qsizetype firstFacet = 0;
+    // Signed enclosed volume; positive for a closed, outward-facing shell
+    double volume = 0.0;
+};
+
+// Facets split into shells that share no vertex with each other
+struct Segmentation {
+    // Component of each facet, in facet order
+    QVector<quint32> facetComponent;
+    // Facet indices grouped by component, file order within a component
+    QVector<quint32> facetOrder;
+    // Numbered by the first vertex of each shell, so they follow the file
+    QVector<MeshComponent> components;
+    qint64 elapsedMs = 0;
+};
+
+class MeshSegmentation
+{
+public:
+    static Segmentation compute(const QVector<Triangle>& triangles);
+};
+
+#endif // MESHSEGMENTATION_H
@@ -0,0 +1,94 @@
+#ifndef MESHVOXELIZER_H
+#define MESHVOXELIZER_H
+
+#include <QVector>
+#include <QVector3D>
+
+// Forward declaration - Triangle is defined in stlviewer.h
+struct Triangle;
+
+// Dense bit grid. Rows run along X and start on a word boundary, so
+// different rows can be written from different threads.
+class VoxelGrid
+{
+public:
+    VoxelGrid() = default;
+    VoxelGrid(int sizeX, int sizeY, int sizeZ);
+
+    int sizeX() const { return m_sizeX; }
+    int sizeY() const { return m_sizeY; }
+    int sizeZ() const { return m_sizeZ; }
+    int wordsPerRow() const { return m_wordsPerRow; }
+    bool isEmpty() const { return m_words.isEmpty(); }
+
+    quint64* row(int y, int z) { return m_words.data() + rowOffset(y, z); }
+    const quint64* row(int y, int z) const { return m_words.constData() + rowOffset(y, z); }
+
+    bool test(int x, int y, int z) const
+    {
+        return (row(y, z)[x >> 6] >> (x & 63)) & 1u;
+    }
+    void set(int x, int y, int z) { row(y, z)[x >> 6] |= quint64(1) << (x & 63); }
+
+    // Sets bits [begin, end) of a row
+    void setRange(int y, int z, int begin, int end);
+
+    qint64 count() const;
+    qint64 memoryBytes() const { return qint64(m_words.size()) * qint64(sizeof(quint64)); }
+
+private:
+    qsizetype rowOffset(int y, int z) const
+    {
+        return (qsizetype(z) * m_sizeY + y) * m_wordsPerRow;
+    }
+
+    int m_sizeX = 0;
+    int m_sizeY = 0;
+    int m_sizeZ = 0;
+    int m_wordsPerRow = 0;
+    QVector<quint64> m_words;
+};
+
+struct VoxelizationResult {
+    // Voxel (x, y, z) spans origin + [x, x + 1) * voxelSize on each axis
+    VoxelGrid solid;
+    VoxelGrid thinWalls; // solid voxels in walls thinner than the minimum
+    QVector3D origin;
+    float voxelSize = 0.0f;
+
+    qint64 surfaceVoxels = 0; // touched by a facet
+    qint64 solidVoxels = 0;   // surface or inside
+    qint64 insideVoxels = 0;  // center inside the mesh
+    qint64 thinVoxels = 0;
+    double volume = 0.0;      // insideVoxels * voxelSize^3
+    qint64 elapsedMs = 0;
+};
+
+// Exposed voxel faces as triangles, ready for MeshScene::setVoxelSurface()
+struct VoxelSurface {
+    QVector<QVector3D> vertices;
+    QVector<QVector3D> normals;
+    QVector<quint16> faceColors; // packed, one per triangle
+};
+
+class MeshVoxelizer
+{
+public:
+    // Conservative surface voxelization plus a parity fill of the interior
+    // along X scanlines. 'resolution' voxels span the longest side of the
+    // bounds. Solid voxels that no solid cube minWallThickness (model units)
+    // on a side covers are marked in thinWalls.
+    static VoxelizationResult voxelize(const QVector<Triangle>& triangles, int resolution,
+                                       float minWallThickness);
+
+    // Packed overlay color per facet: red where the facet's centroid lies in
+    // a thin wall
+    static QVector<quint16> thinWallFacetColors(const QVector<Triangle>& triangles,
+                                                const VoxelizationResult& result);
+
+    // Faces between solid and empty voxels, merged into blocks so that no
+    // side exceeds maxResolution blocks; thin blocks are colored red
+    static VoxelSurface surface(const VoxelizationResult& result, int maxResolution);
+};
+
+#endif // MESHVOXELIZER_H
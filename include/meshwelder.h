@@ -0,0 +1,23 @@
+#ifndef MESHWELDER_H
+#define MESHWELDER_H
+
+#include <QVector>
+#include <QVector3D>
+
+// Forward declaration - Triangle is defined in stlviewer.h
+struct Triangle;
+
+// Indexed form of a triangle soup: corners that share an exact position
+// share one entry in 'positions'.
+struct WeldedMesh {
+    QVector<QVector3D> positions;
+    QVector<quint32> indices; // three per facet, in facet order
+};
+
+class MeshWelder
+{
+public:
+    static WeldedMesh weld(const QVector<Triangle>& triangles);
+};
+
+#endif // MESHWELDER_H
@@ -0,0 +1,45 @@
+#ifndef ORIENTATIONPANEL_H
+#define ORIENTATIONPANEL_H
+
+#include <QWidget>
+#include <QLabel>
+#include <QVector3D>
+#include "meshorientation.h"
+
+class QTableWidget;
+
+// Convex hull and minimal box of the model, and the build orientations
+// ranked by the search; selecting one applies it to the overhang view and
+// shows its box
+class OrientationPanel : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit OrientationPanel(QWidget *parent = nullptr);
+
+    void setResult(const OrientationResult& result);
+    void clear();
+
+signals:
+    void candidateSelected(const OrientationCandidate& candidate);
+
+private slots:
+    void onSelectionChanged();
+
+private:
+    enum Column {
+        UpColumn,
+        HeightColumn,
+        SupportColumn,
+        FootprintColumn,
+        ScoreColumn,
+        ColumnCount
+    };
+
+    QLabel* m_summaryLabel;
+    QTableWidget* m_table;
+    QVector<OrientationCandidate> m_candidates;
+};
+
+#endif // ORIENTATIONPANEL_H
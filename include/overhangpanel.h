@@ -0,0 +1,45 @@
+#ifndef OVERHANGPANEL_H
+#define OVERHANGPANEL_H
+
+#include <QWidget>
+#include <QLabel>
+#include <QVector3D>
+#include "meshoverhang.h"
+
+class QSlider;
+class QFormLayout;
+
+// Build orientation and critical angle for the overhang analysis, and the
+// support area it found
+class OverhangPanel : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit OverhangPanel(QWidget *parent = nullptr);
+
+    // Up in model coordinates once the part is tilted onto the build plate
+    QVector3D buildDirection() const;
+    // Sets the tilts, to the nearest degree, that bring 'up' to the
+    // printer's Z; emits parametersChanged() once
+    void setBuildDirection(const QVector3D& up);
+    float criticalAngle() const;
+
+    void setResult(const OverhangResult& result);
+    void reset();
+
+signals:
+    void parametersChanged();
+
+private:
+    QSlider* addSlider(QFormLayout* form, const QString& label,
+                       int minimum, int maximum, int value);
+
+    QSlider* m_tiltXSlider;
+    QSlider* m_tiltYSlider;
+    QSlider* m_criticalSlider;
+    QLabel* m_statsLabel;
+    bool m_updating;
+};
+
+#endif // OVERHANGPANEL_H
@@ -0,0 +1,64 @@
+#ifndef PARALLELFOR_H
+#define PARALLELFOR_H
+
+#include <QVector>
+#include <QtConcurrent/QtConcurrentMap>
+#include <QtGlobal>
+#include <algorithm>
+#include <functional>
+
+// Runs fn(begin, end) over [0, count) in chunks of at most 'grain' items on
+// the global thread pool and blocks until every chunk has finished.
+template <typename Fn>
+void parallelFor(qsizetype count, qsizetype grain, Fn&& fn)
+{
+    if (count <= 0) return;
+    grain = qMax<qsizetype>(grain, 1);
+    
+    if (count <= grain) {
+        fn(qsizetype(0), count);
+        return;
+    }
+    
+    QVector<qsizetype> chunkStarts;
+    chunkStarts.reserve((count + grain - 1) / grain);
+    for (qsizetype begin = 0; begin < count; begin += grain) {
+        chunkStarts.append(begin);
+    }
+    
+    QtConcurrent::blockingMap(chunkStarts, [&](const qsizetype& begin) {
+        fn(begin, qMin(begin + grain, count));
+    });
+}
+
+// Sorts [first, last): chunks of 'grain' items are sorted in parallel, then
+// neighbouring runs are merged pairwise, each round in parallel. Not stable.
+template <typename RandomIt, typename Less = std::less<>>
+void parallelSort(RandomIt first, RandomIt last, qsizetype grain, Less less = Less())
+{
+    const qsizetype count = last - first;
+    grain = qMax<qsizetype>(grain, 1);
+    if (count <= grain) {
+        std::sort(first, last, less);
+        return;
+    }
+    
+    parallelFor(count, grain, [&](qsizetype begin, qsizetype end) {
+        std::sort(first + begin, first + end, less);
+    });
+    for (qsizetype run = grain; run < count; run *= 2) {
+        const qsizetype pairCount = (count + 2 * run - 1) / (2 * run);
+        parallelFor(pairCount, 1, [&](qsizetype begin, qsizetype end) {
+            for (qsizetype pair = begin; pair < end; ++pair) {
+                const qsizetype low = pair * 2 * run;
+                const qsizetype middle = low + run;
+                if (middle < count) {
+                    std::inplace_merge(first + low, first + middle,
+                                       first + qMin(middle + run, count), less);
+                }
+            }
+        });
+    }
+}
+
+#endif // PARALLELFOR_H
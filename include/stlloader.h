@@ -13,14 +13,37 @@ struct Triangle;
 class STLLoader
 {
 public:
-    static QVector<Triangle> loadSTL(const QString& filename, QString& error);
+    // Facet colors are packed as 5-bit red (bits 0-4), green (5-9) and
+    // blue (10-14); bit 15 is set when the facet has a color
+    static constexpr quint16 kFacetColorValid = 0x8000;
+    
+    // When facetColors is given it receives one packed color per facet, or
+    // stays empty if the file carries no colors
+    static QVector<Triangle> loadSTL(const QString& filename, QString& error,
+                                     QVector<quint16>* facetColors = nullptr);
+    
+    static quint16 packFacetColor(quint16 r5, quint16 g5, quint16 b5);
     
 private:
-    static QVector<Triangle> loadBinarySTL(QFile& file, QString& error);
+    enum class FacetColorFormat {
+        VisCAM,      // also SolidView
+        Materialise
+    };
+    
+    static QVector<Triangle> loadBinarySTL(QFile& file, QString& error,
+                                           QVector<quint16>* facetColors);
     static QVector<Triangle> loadAsciiSTL(QFile& file, QString& error);
     static bool isBinarySTL(QFile& file);
     static QVector3D parseVertex(const QString& line);
     static QVector3D parseNormal(const QString& line);
+    static FacetColorFormat facetColorFormat(const QByteArray& header);
+    static quint16 materialiseDefaultColor(const QByteArray& header);
+    static quint16 decodeFacetColor(quint16 attribute, FacetColorFormat format,
+                                    quint16 defaultColor);
+    static void computeMissingNormals(QVector<Triangle>& triangles,
+                                      const QVector<quint32>& facets);
+    static QVector3D readVector(const uchar* data);
+    static float readFloat(const uchar* data);
 };
 
 #endif // STLLOADER_H
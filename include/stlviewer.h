@@ -3,14 +3,15 @@
 
 #include <QOpenGLWidget>
 #include <QOpenGLFunctions>
-#include <QOpenGLBuffer>
-#include <QOpenGLVertexArrayObject>
-#include <QOpenGLShaderProgram>
 #include <QMatrix4x4>
 #include <QVector3D>
 #include <QMouseEvent>
 #include <QWheelEvent>
 #include <QTimer>
+#include <QElapsedTimer>
+
+class MeshScene;
+class QLabel;
 
 struct Triangle {
     QVector3D normal;
@@ -19,20 +20,58 @@ struct Triangle {
     QVector3D vertex3;
 };
 
+// Orbit camera state that linked viewports share
+struct ViewCamera {
+    float rotationX = 0.0f;
+    float rotationY = 0.0f;
+    float zoom = 1.0f;
+};
+
+// One viewport onto a shared MeshScene. The viewer owns only its camera and
+// projection; geometry and shaders are drawn from the scene.
 class STLViewer : public QOpenGLWidget, protected QOpenGLFunctions
 {
     Q_OBJECT
 
 public:
-    explicit STLViewer(QWidget *parent = nullptr);
+    // Fixed orientation applied before the camera rotation (Z up)
+    enum class ViewPreset {
+        Perspective,  // free orbit with a perspective projection
+        Top,          // looking down -Z, orthographic
+        Front,        // looking along +Y, orthographic
+        Side          // looking along -X, orthographic
+    };
+
+    explicit STLViewer(MeshScene *scene, QWidget *parent = nullptr);
     ~STLViewer();
 
-    void loadSTL(const QString& filename);
     void resetView();
+    
+    ViewPreset viewPreset() const { return m_preset; }
+    void setViewPreset(ViewPreset preset);
+    static QString presetName(ViewPreset preset);
+    
+    ViewCamera camera() const { return m_camera; }
+    
+    // The matrices paintGL() draws with, also used to render the same view
+    // offscreen at other sizes
+    static QMatrix4x4 modelMatrix(ViewPreset preset, const ViewCamera& camera, float modelScale);
+    static QMatrix4x4 viewMatrix();
+    static QMatrix4x4 projectionMatrix(ViewPreset preset, float aspect);
+    static QVector3D viewPosition();
+
+public slots:
+    // Does not emit cameraChanged, so linked viewers can follow each other.
+    // Without 'repaint' the caller schedules the update.
+    void setCamera(const ViewCamera& camera, bool repaint = true);
 
 signals:
-    void modelLoaded(const QString& filename, int triangleCount);
-    void loadError(const QString& error);
+    void cameraChanged(const ViewCamera& camera);
+    // The mouse button that was dragging the camera went up
+    void interactionFinished();
+    // The left button was clicked without dragging; the ray through the
+    // clicked pixel, in the coordinates of the model file
+    void pickRequested(const QVector3D& origin, const QVector3D& direction);
 
 protected:
     void initializeGL() override;
@@ -40,50 +79,36 @@ protected:
     void resizeGL(int width, int height) override;
     void mousePressEvent(QMouseEvent *event) override;
     void mouseMoveEvent(QMouseEvent *event) override;
+    void mouseReleaseEvent(QMouseEvent *event) override;
     void wheelEvent(QWheelEvent *event) override;
 
 private slots:
     void animate();
+    void onFrameSwapped();
 
 private:
-    void setupShaders();
-    void setupBuffers();
-    void calculateBoundingBox();
-    void centerModel();
+    void updateProjection();
+    void emitPickRay(const QPoint& position);
     
-    QOpenGLShaderProgram* m_shaderProgram;
-    QOpenGLBuffer m_vertexBuffer;
-    QOpenGLBuffer m_normalBuffer;
-    QOpenGLVertexArrayObject m_vao;
+    MeshScene* m_scene;
+    ViewPreset m_preset;
+    QLabel* m_presetLabel;
     
     QMatrix4x4 m_projection;
-    QMatrix4x4 m_view;
-    QMatrix4x4 m_model;
-    
-    QVector<Triangle> m_triangles;
-    QVector<QVector3D> m_vertices;
-    QVector<QVector3D> m_normals;
     
     // Camera controls
-    float m_rotationX;
-    float m_rotationY;
-    float m_zoom;
+    ViewCamera m_camera;
     QPoint m_lastMousePos;
+    QPoint m_pressMousePos;
     bool m_mousePressed;
     
-    // Model bounds
-    QVector3D m_minBounds;
-    QVector3D m_maxBounds;
-    QVector3D m_center;
-    float m_modelScale;
+    // Frames shown during the current drag, for the frame time log
+    QElapsedTimer m_dragTimer;
+    int m_dragFrames;
     
     // Animation
     QTimer* m_animationTimer;
     bool m_animationEnabled;
-    
-    // Rendering
-    bool m_modelLoaded;
-    QString m_currentFile;
 };
 
 #endif // STLVIEWER_H
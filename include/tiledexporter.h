@@ -0,0 +1,43 @@
+#ifndef TILEDEXPORTER_H
+#define TILEDEXPORTER_H
+
+#include <QMatrix4x4>
+#include <QVector3D>
+#include <QSize>
+#include <QRect>
+#include <QString>
+
+class MeshScene;
+
+// Camera for an export; the projection covers the whole image
+struct ExportView {
+    QMatrix4x4 model;
+    QMatrix4x4 view;
+    QMatrix4x4 projection;
+    QVector3D viewPos;
+};
+
+struct ExportStats {
+    qint64 pixels = 0;
+    int tiles = 0;
+    qint64 elapsedMs = 0;
+    double pixelsPerSecond = 0.0;
+};
+
+// Renders a view of the scene at any size by drawing it tile by tile into
+// an offscreen framebuffer and streaming each band of tiles to the image
+// writer. Uses its own context and needs no window.
+class TiledExporter
+{
+public:
+    static bool exportImage(MeshScene* scene, const ExportView& view, const QSize& size,
+                            const QString& filename, QString& error,
+                            ExportStats* stats = nullptr);
+    
+    // The part of 'projection' that lands on 'tile' (image pixels, top-down)
+    // stretched over the whole viewport
+    static QMatrix4x4 tileProjection(const QMatrix4x4& projection, const QSize& imageSize,
+                                     const QRect& tile);
+};
+
+#endif // TILEDEXPORTER_H
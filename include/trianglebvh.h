@@ -0,0 +1,95 @@
+#ifndef TRIANGLEBVH_H
+#define TRIANGLEBVH_H
+
+#include <QVector>
+#include <QVector3D>
+#include <functional>
+
+// Forward declaration - Triangle is defined in stlviewer.h
+struct Triangle;
+
+// Bounding volume hierarchy over a triangle list. Nodes are laid out depth
+// first; an interior node's left child immediately follows it.
+class TriangleBVH
+{
+public:
+    struct Node {
+        QVector3D minBounds;
+        QVector3D maxBounds;
+        quint32 first;  // leaf: first primitive; interior: right child index
+        quint32 count;  // leaf: primitive count; interior: 0
+        
+        bool isLeaf() const { return count != 0; }
+    };
+    
+    // Triangle corners in BVH order
+    struct Primitive {
+        QVector3D a;
+        QVector3D b;
+        QVector3D c;
+    };
+    
+    // Part of a triangle a closest point lies on. Vertex k is corner k of
+    // the facet; edge k runs from corner k to corner k + 1.
+    enum class Feature : quint8 {
+        Face,
+        Edge,
+        Vertex
+    };
+    
+    struct ClosestPoint {
+        QVector3D point;
+        Feature feature = Feature::Face;
+        quint8 featureIndex = 0;
+    };
+    
+    struct NearestHit {
+        float distanceSquared = -1.0f;
+        QVector3D point;
+        quint32 facet = 0; // index into the source triangle list
+        Feature feature = Feature::Face;
+        quint8 featureIndex = 0;
+        
+        bool isValid() const { return distanceSquared >= 0.0f; }
+    };
+    
+    struct RayHit {
+        float distance = -1.0f; // ray parameter; a length for a unit direction
+        quint32 facet = 0;      // index into the source triangle list
+        
+        bool isValid() const { return distance > 0.0f; }
+    };
+    
+    TriangleBVH() = default;
+    explicit TriangleBVH(const QVector<Triangle>& triangles);
+    
+    void build(const QVector<Triangle>& triangles);
+    bool isEmpty() const { return m_nodes.isEmpty(); }
+    
+    NearestHit nearest(const QVector3D& point) const;
+    
+    // First facet the ray origin + t * direction, t > 0, meets among those
+    // 'accept' passes (all when it is empty)
+    RayHit raycast(const QVector3D& origin, const QVector3D& direction,
+                   const std::function<bool(quint32)>& accept = {}) const;
+    
+    // True when the point lies inside the surface, by ray crossing parity;
+    // meaningful for closed meshes only
+    bool contains(const QVector3D& point) const;
+    
+    const QVector<Node>& nodes() const { return m_nodes; }
+    const QVector<Primitive>& primitives() const { return m_primitives; }
+    const QVector<quint32>& facetIndices() const { return m_facets; }
+    
+    static QVector3D closestPointOnTriangle(const QVector3D& p, const QVector3D& a,
+                                            const QVector3D& b, const QVector3D& c);
+    static ClosestPoint closestFeatureOnTriangle(const QVector3D& p, const QVector3D& a,
+                                                 const QVector3D& b, const QVector3D& c);
+    
+private:
+    QVector<Node> m_nodes;
+    QVector<Primitive> m_primitives;
+    QVector<quint32> m_facets;
+};
+
+#endif // TRIANGLEBVH_H
@@ -0,0 +1,198 @@
+#include "componentpanel.h"
+#include "stlloader.h"
+#include <QTableWidget>
+#include <QHeaderView>
+#include <QColorDialog>
+#include <QPushButton>
+#include <QVBoxLayout>
+#include <QHBoxLayout>
+#include <QSignalBlocker>
+#include <cmath>
+
+namespace {
+
+// Selected components are drawn in this color
+const QColor kHighlightColor(255, 200, 0);
+
+quint16 packColor(const QColor& color)
+{
+    return STLLoader::packFacetColor(quint16(color.red() >> 3), quint16(color.green() >> 3),
+                                     quint16(color.blue() >> 3));
+}
+
+// Golden-angle hue steps keep neighbouring components distinguishable
+QColor defaultColor(int component)
+{
+    const qreal hue = std::fmod(component * 0.381966, 1.0);
+    return QColor::fromHsvF(hue, 0.55, 0.9);
+}
+
+} // namespace
+
+ComponentPanel::ComponentPanel(QWidget *parent)
+    : QWidget(parent)
+    , m_summaryLabel(nullptr)
+    , m_table(nullptr)
+    , m_updating(false)
+{
+    QVBoxLayout* layout = new QVBoxLayout(this);
+    
+    m_summaryLabel = new QLabel(this);
+    m_summaryLabel->setWordWrap(true);
+    layout->addWidget(m_summaryLabel);
+    
+    m_table = new QTableWidget(0, ColumnCount, this);
+    m_table->setHorizontalHeaderLabels({"#", "Color", "Facets", "Volume", "Size"});
+    m_table->verticalHeader()->setDefaultSectionSize(fontMetrics().height() + 6);
+    m_table->horizontalHeader()->setSectionResizeMode(QHeaderView::ResizeToContents);
+    m_table->horizontalHeader()->setStretchLastSection(true);
+    m_table->setSelectionBehavior(QAbstractItemView::SelectRows);
+    m_table->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    layout->addWidget(m_table);
+    
+    QHBoxLayout* buttonLayout = new QHBoxLayout();
+    QPushButton* showAllButton = new QPushButton("Show All", this);
+    QPushButton* hideButton = new QPushButton("Hide", this);
+    QPushButton* isolateButton = new QPushButton("Isolate", this);
+    buttonLayout->addWidget(showAllButton);
+    buttonLayout->addWidget(hideButton);
+    buttonLayout->addWidget(isolateButton);
+    layout->addLayout(buttonLayout);
+    
+    connect(m_table, &QTableWidget::itemChanged, this, &ComponentPanel::onItemChanged);
+    connect(m_table, &QTableWidget::cellDoubleClicked, this, &ComponentPanel::onCellDoubleClicked);
+    connect(m_table, &QTableWidget::itemSelectionChanged, this, &ComponentPanel::colorsChanged);
+    connect(showAllButton, &QPushButton::clicked, this, &ComponentPanel::showAll);
+    connect(hideButton, &QPushButton::clicked, this, &ComponentPanel::hideSelected);
+    connect(isolateButton, &QPushButton::clicked, this, &ComponentPanel::isolateSelected);
+}
+
+void ComponentPanel::setSegmentation(const Segmentation& segmentation)
+{
+    const int count = int(segmentation.components.size());
+    
+    m_summaryLabel->setText(QString("%1 components (%2 ms)\n"
+                                    "Double-click a color to change it.")
+                           .arg(count).arg(segmentation.elapsedMs));
+    
+    QSignalBlocker blocker(m_table);
+    m_table->clearContents();
+    m_table->setRowCount(count);
+    m_colors.resize(count);
+    
+    for (int c = 0; c < count; ++c) {
+        const MeshComponent& component = segmentation.components[c];
+        const QVector3D size = component.maxBounds - component.minBounds;
+        m_colors[c] = defaultColor(c);
+        
+        QTableWidgetItem* visibleItem = new QTableWidgetItem(QString::number(c + 1));
+        visibleItem->setFlags(visibleItem->flags() | Qt::ItemIsUserCheckable);
+        visibleItem->setCheckState(Qt::Checked);
+        m_table->setItem(c, VisibleColumn, visibleItem);
+        
+        QTableWidgetItem* colorItem = new QTableWidgetItem();
+        colorItem->setBackground(m_colors[c]);
+        m_table->setItem(c, ColorColumn, colorItem);
+        
+        m_table->setItem(c, FacetsColumn, new QTableWidgetItem(QString::number(component.facetCount)));
+        m_table->setItem(c, VolumeColumn, new QTableWidgetItem(QString::number(component.volume, 'g', 5)));
+        m_table->setItem(c, SizeColumn, new QTableWidgetItem(QString("%1 x %2 x %3")
+                                                             .arg(size.x(), 0, 'g', 4)
+                                                             .arg(size.y(), 0, 'g', 4)
+                                                             .arg(size.z(), 0, 'g', 4)));
+    }
+}
+
+void ComponentPanel::clear()
+{
+    QSignalBlocker blocker(m_table);
+    m_table->setRowCount(0);
+    m_colors.clear();
+    m_summaryLabel->clear();
+}
+
+void ComponentPanel::selectComponent(int component)
+{
+    if (component < 0 || component >= m_table->rowCount()) {
+        m_table->clearSelection();
+        return;
+    }
+    m_table->selectRow(component);
+    m_table->scrollToItem(m_table->item(component, VisibleColumn));
+}
+
+QVector<quint16> ComponentPanel::componentColors() const
+{
+    QVector<quint16> colors(m_colors.size());
+    for (int c = 0; c < m_colors.size(); ++c) {
+        colors[c] = packColor(m_colors[c]);
+    }
+    
+    const QModelIndexList selected = m_table->selectionModel()->selectedRows();
+    for (const QModelIndex& index : selected) {
+        colors[index.row()] = packColor(kHighlightColor);
+    }
+    return colors;
+}
+
+QVector<bool> ComponentPanel::visibility() const
+{
+    QVector<bool> visible(m_table->rowCount());
+    for (int row = 0; row < m_table->rowCount(); ++row) {
+        visible[row] = m_table->item(row, VisibleColumn)->checkState() == Qt::Checked;
+    }
+    return visible;
+}
+
+void ComponentPanel::onItemChanged()
+{
+    if (!m_updating) {
+        emit visibilityChanged();
+    }
+}
+
+void ComponentPanel::onCellDoubleClicked(int row, int column)
+{
+    if (column != ColorColumn) return;
+    
+    const QColor color = QColorDialog::getColor(m_colors[row], this, "Component Color");
+    if (!color.isValid()) return;
+    
+    m_colors[row] = color;
+    m_updating = true;
+    m_table->item(row, ColorColumn)->setBackground(color);
+    m_updating = false;
+    emit colorsChanged();
+}
+
+void ComponentPanel::showAll()
+{
+    m_updating = true;
+    for (int row = 0; row < m_table->rowCount(); ++row) {
+        m_table->item(row, VisibleColumn)->setCheckState(Qt::Checked);
+    }
+    m_updating = false;
+    emit visibilityChanged();
+}
+
+void ComponentPanel::hideSelected()
+{
+    m_updating = true;
+    const QModelIndexList selected = m_table->selectionModel()->selectedRows();
+    for (const QModelIndex& index : selected) {
+        m_table->item(index.row(), VisibleColumn)->setCheckState(Qt::Unchecked);
+    }
+    m_updating = false;
+    emit visibilityChanged();
+}
+
+void ComponentPanel::isolateSelected()
+{
+    m_updating = true;
+    for (int row = 0; row < m_table->rowCount(); ++row) {
+        const bool selected = m_table->selectionModel()->isRowSelected(row, QModelIndex());
+        m_table->item(row, VisibleColumn)->setCheckState(selected ? Qt::Checked : Qt::Unchecked);
+    }
+    m_updating = false;
+    emit visibilityChanged();
+}
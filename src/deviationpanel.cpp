@@ -0,0 +1,121 @@
+#include "deviationpanel.h"
+#include <QPainter>
+#include <QVBoxLayout>
+#include <QtMath>
+
+namespace {
+
+// Mirrors scalarColor() in the viewer's fragment shader
+QColor scalarColor(float t)
+{
+    t = qBound(-1.0f, t, 1.0f);
+    const float zero[3] = {0.1f, 0.8f, 0.2f};
+    const float low[3] = {0.1f, 0.2f, 1.0f};
+    const float high[3] = {1.0f, 0.1f, 0.1f};
+    const float* target = t < 0.0f ? low : high;
+    const float s = qAbs(t);
+    return QColor::fromRgbF(zero[0] + (target[0] - zero[0]) * s,
+                            zero[1] + (target[1] - zero[1]) * s,
+                            zero[2] + (target[2] - zero[2]) * s);
+}
+
+} // namespace
+
+DeviationHistogram::DeviationHistogram(QWidget *parent)
+    : QWidget(parent)
+    , m_range(0.0f)
+{
+    setMinimumHeight(120);
+}
+
+void DeviationHistogram::setHistogram(const QVector<qint64>& bins, float range)
+{
+    m_bins = bins;
+    m_range = range;
+    update();
+}
+
+QSize DeviationHistogram::sizeHint() const
+{
+    return QSize(260, 160);
+}
+
+void DeviationHistogram::paintEvent(QPaintEvent *event)
+{
+    Q_UNUSED(event);
+    
+    QPainter painter(this);
+    painter.fillRect(rect(), palette().base());
+    
+    if (m_bins.isEmpty()) return;
+    
+    qint64 peak = 0;
+    for (qint64 count : m_bins) {
+        peak = qMax(peak, count);
+    }
+    if (peak == 0) return;
+    
+    const int labelHeight = fontMetrics().height() + 4;
+    const QRectF plot = QRectF(rect()).adjusted(4, 4, -4, -labelHeight);
+    const qreal barWidth = plot.width() / m_bins.size();
+    
+    for (int i = 0; i < m_bins.size(); ++i) {
+        // Log scale keeps sparse outlier bins visible next to the peak
+        const qreal fraction = qLn(1.0 + m_bins[i]) / qLn(1.0 + peak);
+        const qreal height = fraction * plot.height();
+        const float center = (i + 0.5f) / m_bins.size() * 2.0f - 1.0f;
+        painter.fillRect(QRectF(plot.left() + i * barWidth, plot.bottom() - height,
+                                qMax<qreal>(barWidth - 1.0, 1.0), height),
+                         scalarColor(center));
+    }
+    
+    painter.setPen(palette().text().color());
+    const QRectF labels(plot.left(), plot.bottom() + 2, plot.width(), labelHeight);
+    painter.drawText(labels, Qt::AlignLeft, QString::number(-m_range, 'g', 4));
+    painter.drawText(labels, Qt::AlignHCenter, "0");
+    painter.drawText(labels, Qt::AlignRight, QString::number(m_range, 'g', 4));
+}
+
+DeviationPanel::DeviationPanel(QWidget *parent)
+    : QWidget(parent)
+    , m_titleLabel(nullptr)
+    , m_statsLabel(nullptr)
+    , m_histogram(nullptr)
+{
+    QVBoxLayout* layout = new QVBoxLayout(this);
+    
+    m_titleLabel = new QLabel(this);
+    m_titleLabel->setWordWrap(true);
+    layout->addWidget(m_titleLabel);
+    
+    m_histogram = new DeviationHistogram(this);
+    layout->addWidget(m_histogram);
+    
+    m_statsLabel = new QLabel(this);
+    m_statsLabel->setTextInteractionFlags(Qt::TextSelectableByMouse);
+    layout->addWidget(m_statsLabel);
+    
+    layout->addStretch();
+}
+
+void DeviationPanel::setResult(const QString& referenceName, const QString& testName,
+                               const DeviationResult& result)
+{
+    m_titleLabel->setText(QString("<b>%1</b> against reference <b>%2</b>")
+                         .arg(testName.toHtmlEscaped(), referenceName.toHtmlEscaped()));
+    m_histogram->setHistogram(result.histogram, result.maxAbsDistance);
+    m_statsLabel->setText(QString("Vertices: %1\n"
+                                  "Min: %2\n"
+                                  "Max: %3\n"
+                                  "Max |d|: %4\n"
+                                  "Mean: %5\n"
+                                  "RMS: %6\n"
+                                  "Time: %7 ms")
+                         .arg(result.vertexCount)
+                         .arg(result.minDistance, 0, 'g', 5)
+                         .arg(result.maxDistance, 0, 'g', 5)
+                         .arg(result.maxAbsDistance, 0, 'g', 5)
+                         .arg(result.meanDistance, 0, 'g', 5)
+                         .arg(result.rmsDistance, 0, 'g', 5)
+                         .arg(result.elapsedMs));
+}
@@ -0,0 +1,222 @@
+#include "geometrykernels_p.h"
+#include <QByteArray>
+#include <QDebug>
+#include <atomic>
+
+#if defined(STLVIEWER_X86_KERNELS) && defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace {
+
+void scalarFacetNormalsKernel(ConstPointsSoA a, ConstPointsSoA b, ConstPointsSoA c,
+                              PointsSoA n, qsizetype count)
+{
+    scalarFacetNormals(a, b, c, n, 0, count);
+}
+
+void scalarExtendBoundsKernel(ConstPointsSoA p, qsizetype count,
+                              float* minBounds, float* maxBounds)
+{
+    scalarExtendBounds(p, 0, count, minBounds, maxBounds);
+}
+
+void scalarTranslateScaleKernel(PointsSoA p, qsizetype count,
+                                const float* translation, float scale)
+{
+    scalarTranslateScale(p, 0, count, translation, scale);
+}
+
+void scalarTransformKernel(PointsSoA p, qsizetype count, const float* matrix)
+{
+    scalarTransform(p, 0, count, matrix);
+}
+
+void scalarFacingWeightKernel(ConstPointsSoA n, const float* weights, qsizetype count,
+                              const float* direction, float threshold, float* dots,
+                              float* partials)
+{
+    scalarFacingWeight(n, weights, 0, count, direction, threshold, dots, partials);
+}
+
+void scalarTrianglesCrossKernel(const ConstPointsSoA a[3], const ConstPointsSoA b[3],
+                                qsizetype count, bool* hits)
+{
+    scalarTrianglesCross(a, b, 0, count, hits);
+}
+
+const KernelTable kScalarTable = {
+    scalarFacetNormalsKernel,
+    scalarExtendBoundsKernel,
+    scalarTranslateScaleKernel,
+    scalarTransformKernel,
+    scalarFacingWeightKernel,
+    scalarTrianglesCrossKernel
+};
+
+#if defined(STLVIEWER_X86_KERNELS) && defined(_MSC_VER)
+bool cpuHasIsa(GeometryKernels::Isa isa)
+{
+    int info[4];
+    __cpuid(info, 1);
+    const bool osxsave = (info[2] & (1 << 27)) != 0;
+    const bool avx = (info[2] & (1 << 28)) != 0;
+    if (isa == GeometryKernels::Isa::SSE) return true; // x86-64 baseline
+    if (!osxsave || !avx) return false;
+    
+    const unsigned long long xcr0 = _xgetbv(0);
+    __cpuidex(info, 7, 0);
+    if (isa == GeometryKernels::Isa::AVX2) {
+        return (xcr0 & 0x6) == 0x6 && (info[1] & (1 << 5)) != 0;
+    }
+    // AVX-512F also needs the opmask and upper ZMM state enabled by the OS
+    return (xcr0 & 0xE6) == 0xE6 && (info[1] & (1 << 16)) != 0;
+}
+#elif defined(STLVIEWER_X86_KERNELS)
+bool cpuHasIsa(GeometryKernels::Isa isa)
+{
+    __builtin_cpu_init();
+    switch (isa) {
+    case GeometryKernels::Isa::Scalar:
+    case GeometryKernels::Isa::SSE:
+        return true; // x86-64 baseline
+    case GeometryKernels::Isa::AVX2:
+        return __builtin_cpu_supports("avx2");
+    case GeometryKernels::Isa::AVX512:
+        return __builtin_cpu_supports("avx512f");
+    }
+    return false;
+}
+#else
+bool cpuHasIsa(GeometryKernels::Isa isa)
+{
+    return isa == GeometryKernels::Isa::Scalar;
+}
+#endif
+
+const KernelTable& tableFor(GeometryKernels::Isa isa)
+{
+    switch (isa) {
+#if defined(STLVIEWER_X86_KERNELS)
+    case GeometryKernels::Isa::SSE:
+        return sseKernelTable();
+    case GeometryKernels::Isa::AVX2:
+        return avx2KernelTable();
+    case GeometryKernels::Isa::AVX512:
+        return avx512KernelTable();
+#endif
+    default:
+        return kScalarTable;
+    }
+}
+
+GeometryKernels::Isa initialIsa()
+{
+    GeometryKernels::Isa isa = GeometryKernels::bestSupportedIsa();
+    
+    const QByteArray forced = qgetenv("STLVIEWER_KERNEL_ISA").toLower();
+    if (!forced.isEmpty()) {
+        const GeometryKernels::Isa levels[] = {
+            GeometryKernels::Isa::Scalar, GeometryKernels::Isa::SSE,
+            GeometryKernels::Isa::AVX2, GeometryKernels::Isa::AVX512
+        };
+        for (GeometryKernels::Isa level : levels) {
+            if (forced == QByteArray(GeometryKernels::isaName(level)).toLower()) {
+                if (cpuHasIsa(level)) {
+                    isa = level;
+                } else {
+                    qWarning() << "STLVIEWER_KERNEL_ISA:" << forced << "is not supported by this CPU";
+                }
+            }
+        }
+    }
+    
+    qInfo() << "Geometry kernels:" << GeometryKernels::isaName(isa);
+    return isa;
+}
+
+std::atomic<GeometryKernels::Isa>& activeIsaStorage()
+{
+    static std::atomic<GeometryKernels::Isa> isa(initialIsa());
+    return isa;
+}
+
+const KernelTable& kernels()
+{
+    return tableFor(activeIsaStorage().load(std::memory_order_relaxed));
+}
+
+} // namespace
+
+GeometryKernels::Isa GeometryKernels::activeIsa()
+{
+    return activeIsaStorage().load();
+}
+
+GeometryKernels::Isa GeometryKernels::bestSupportedIsa()
+{
+    if (cpuHasIsa(Isa::AVX512)) return Isa::AVX512;
+    if (cpuHasIsa(Isa::AVX2)) return Isa::AVX2;
+    if (cpuHasIsa(Isa::SSE)) return Isa::SSE;
+    return Isa::Scalar;
+}
+
+const char* GeometryKernels::isaName(Isa isa)
+{
+    switch (isa) {
+    case Isa::Scalar: return "Scalar";
+    case Isa::SSE: return "SSE";
+    case Isa::AVX2: return "AVX2";
+    case Isa::AVX512: return "AVX512";
+    }
+    return "Unknown";
+}
+
+bool GeometryKernels::setActiveIsa(Isa isa)
+{
+    if (!cpuHasIsa(isa)) return false;
+    activeIsaStorage().store(isa);
+    return true;
+}
+
+void GeometryKernels::facetNormals(ConstPointsSoA a, ConstPointsSoA b, ConstPointsSoA c,
+                                   PointsSoA n, qsizetype count)
+{
+    kernels().facetNormals(a, b, c, n, count);
+}
+
+void GeometryKernels::extendBounds(ConstPointsSoA p, qsizetype count,
+                                   float* minBounds, float* maxBounds)
+{
+    kernels().extendBounds(p, count, minBounds, maxBounds);
+}
+
+void GeometryKernels::translateScale(PointsSoA p, qsizetype count,
+                                     const float* translation, float scale)
+{
+    kernels().translateScale(p, count, translation, scale);
+}
+
+void GeometryKernels::transform(PointsSoA p, qsizetype count, const float* matrix)
+{
+    kernels().transform(p, count, matrix);
+}
+
+float GeometryKernels::facingWeight(ConstPointsSoA n, const float* weights, qsizetype count,
+                                    const float* direction, float threshold, float* dots)
+{
+    alignas(64) float partials[kPartialSums] = {};
+    kernels().facingWeight(n, weights, count, direction, threshold, dots, partials);
+    
+    float sum = 0.0f;
+    for (float partial : partials) {
+        sum += partial;
+    }
+    return sum;
+}
+
+void GeometryKernels::trianglesCross(const ConstPointsSoA a[3], const ConstPointsSoA b[3],
+                                     qsizetype count, bool* hits)
+{
+    kernels().trianglesCross(a, b, count, hits);
+}
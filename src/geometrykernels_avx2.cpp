@@ -0,0 +1,40 @@
+#include "geometrykernels_p.h"
+#include <immintrin.h>
+
+namespace {
+
+struct Avx2Ops {
+    using Reg = __m256;
+    static const int kWidth = 8;
+    
+    static Reg load(const float* p) { return _mm256_loadu_ps(p); }
+    static void store(float* p, Reg v) { _mm256_storeu_ps(p, v); }
+    static Reg set1(float v) { return _mm256_set1_ps(v); }
+    static Reg add(Reg a, Reg b) { return _mm256_add_ps(a, b); }
+    static Reg sub(Reg a, Reg b) { return _mm256_sub_ps(a, b); }
+    static Reg mul(Reg a, Reg b) { return _mm256_mul_ps(a, b); }
+    static Reg div(Reg a, Reg b) { return _mm256_div_ps(a, b); }
+    static Reg sqrt(Reg a) { return _mm256_sqrt_ps(a); }
+    static Reg min(Reg a, Reg b) { return _mm256_min_ps(a, b); }
+    static Reg max(Reg a, Reg b) { return _mm256_max_ps(a, b); }
+    static Reg zeroUnlessPositive(Reg test, Reg value)
+    {
+        return _mm256_and_ps(_mm256_cmp_ps(test, _mm256_setzero_ps(), _CMP_GT_OQ), value);
+    }
+    
+    using Mask = __m256;
+    static Mask greater(Reg a, Reg b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+    static Mask both(Mask a, Mask b) { return _mm256_and_ps(a, b); }
+    static Mask either(Mask a, Mask b) { return _mm256_or_ps(a, b); }
+    static Mask andNot(Mask a, Mask b) { return _mm256_andnot_ps(b, a); }
+    static Reg select(Mask m, Reg a, Reg b) { return _mm256_blendv_ps(b, a, m); }
+    static int bits(Mask m) { return _mm256_movemask_ps(m); }
+};
+
+} // namespace
+
+const KernelTable& avx2KernelTable()
+{
+    static const KernelTable table = simdKernelTable<Avx2Ops>();
+    return table;
+}
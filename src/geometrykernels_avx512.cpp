@@ -0,0 +1,40 @@
+#include "geometrykernels_p.h"
+#include <immintrin.h>
+
+namespace {
+
+struct Avx512Ops {
+    using Reg = __m512;
+    static const int kWidth = 16;
+    
+    static Reg load(const float* p) { return _mm512_loadu_ps(p); }
+    static void store(float* p, Reg v) { _mm512_storeu_ps(p, v); }
+    static Reg set1(float v) { return _mm512_set1_ps(v); }
+    static Reg add(Reg a, Reg b) { return _mm512_add_ps(a, b); }
+    static Reg sub(Reg a, Reg b) { return _mm512_sub_ps(a, b); }
+    static Reg mul(Reg a, Reg b) { return _mm512_mul_ps(a, b); }
+    static Reg div(Reg a, Reg b) { return _mm512_div_ps(a, b); }
+    static Reg sqrt(Reg a) { return _mm512_sqrt_ps(a); }
+    static Reg min(Reg a, Reg b) { return _mm512_min_ps(a, b); }
+    static Reg max(Reg a, Reg b) { return _mm512_max_ps(a, b); }
+    static Reg zeroUnlessPositive(Reg test, Reg value)
+    {
+        return _mm512_maskz_mov_ps(_mm512_cmp_ps_mask(test, _mm512_setzero_ps(), _CMP_GT_OQ), value);
+    }
+    
+    using Mask = __mmask16;
+    static Mask greater(Reg a, Reg b) { return _mm512_cmp_ps_mask(a, b, _CMP_GT_OQ); }
+    static Mask both(Mask a, Mask b) { return Mask(a & b); }
+    static Mask either(Mask a, Mask b) { return Mask(a | b); }
+    static Mask andNot(Mask a, Mask b) { return Mask(a & ~b); }
+    static Reg select(Mask m, Reg a, Reg b) { return _mm512_mask_blend_ps(m, b, a); }
+    static int bits(Mask m) { return int(m); }
+};
+
+} // namespace
+
+const KernelTable& avx512KernelTable()
+{
+    static const KernelTable table = simdKernelTable<Avx512Ops>();
+    return table;
+}
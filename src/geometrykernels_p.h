@@ -0,0 +1,472 @@
+#ifndef GEOMETRYKERNELS_P_H
+#define GEOMETRYKERNELS_P_H
+
+// Shared by the per-instruction-set translation units. Everything here has
+// internal linkage: the SIMD units are compiled with wider -m flags, and an
+// inline function with external linkage could be merged into callers on
+// CPUs that lack those instructions.
+
+#include "geometrykernels.h"
+#if !defined(__GNUC__)
+#include <math.h>
+#endif
+
+struct KernelTable {
+    void (*facetNormals)(ConstPointsSoA a, ConstPointsSoA b, ConstPointsSoA c,
+                         PointsSoA n, qsizetype count);
+    void (*extendBounds)(ConstPointsSoA p, qsizetype count, float* minBounds, float* maxBounds);
+    void (*translateScale)(PointsSoA p, qsizetype count, const float* translation, float scale);
+    void (*transform)(PointsSoA p, qsizetype count, const float* matrix);
+    // Adds into partials[GeometryKernels::kPartialSums]
+    void (*facingWeight)(ConstPointsSoA n, const float* weights, qsizetype count,
+                         const float* direction, float threshold, float* dots, float* partials);
+    void (*trianglesCross)(const ConstPointsSoA a[3], const ConstPointsSoA b[3],
+                           qsizetype count, bool* hits);
+};
+
+namespace {
+
+// Not std::sqrt: that is an inline function with external linkage, so each
+// SIMD unit would emit its own copy of it. Both forms round like sqrtps.
+inline float kernelSqrt(float v)
+{
+#if defined(__GNUC__)
+    return __builtin_sqrtf(v);
+#else
+    return sqrtf(v);
+#endif
+}
+
+// Scalar reference versions; the SIMD loops finish their tails with these
+
+inline void scalarFacetNormals(ConstPointsSoA a, ConstPointsSoA b, ConstPointsSoA c,
+                               PointsSoA n, qsizetype begin, qsizetype end)
+{
+    for (qsizetype i = begin; i < end; ++i) {
+        const float e1x = b.x[i] - a.x[i];
+        const float e1y = b.y[i] - a.y[i];
+        const float e1z = b.z[i] - a.z[i];
+        const float e2x = c.x[i] - a.x[i];
+        const float e2y = c.y[i] - a.y[i];
+        const float e2z = c.z[i] - a.z[i];
+        
+        const float nx = e1y * e2z - e1z * e2y;
+        const float ny = e1z * e2x - e1x * e2z;
+        const float nz = e1x * e2y - e1y * e2x;
+        const float length2 = nx * nx + ny * ny + nz * nz;
+        
+        if (length2 > 0.0f) {
+            const float length = kernelSqrt(length2);
+            n.x[i] = nx / length;
+            n.y[i] = ny / length;
+            n.z[i] = nz / length;
+        } else {
+            n.x[i] = 0.0f;
+            n.y[i] = 0.0f;
+            n.z[i] = 0.0f;
+        }
+    }
+}
+
+inline void scalarExtendBounds(ConstPointsSoA p, qsizetype begin, qsizetype end,
+                               float* minBounds, float* maxBounds)
+{
+    for (qsizetype i = begin; i < end; ++i) {
+        minBounds[0] = p.x[i] < minBounds[0] ? p.x[i] : minBounds[0];
+        minBounds[1] = p.y[i] < minBounds[1] ? p.y[i] : minBounds[1];
+        minBounds[2] = p.z[i] < minBounds[2] ? p.z[i] : minBounds[2];
+        maxBounds[0] = p.x[i] > maxBounds[0] ? p.x[i] : maxBounds[0];
+        maxBounds[1] = p.y[i] > maxBounds[1] ? p.y[i] : maxBounds[1];
+        maxBounds[2] = p.z[i] > maxBounds[2] ? p.z[i] : maxBounds[2];
+    }
+}
+
+inline void scalarTranslateScale(PointsSoA p, qsizetype begin, qsizetype end,
+                                 const float* translation, float scale)
+{
+    for (qsizetype i = begin; i < end; ++i) {
+        p.x[i] = (p.x[i] + translation[0]) * scale;
+        p.y[i] = (p.y[i] + translation[1]) * scale;
+        p.z[i] = (p.z[i] + translation[2]) * scale;
+    }
+}
+
+inline void scalarTransform(PointsSoA p, qsizetype begin, qsizetype end, const float* m)
+{
+    for (qsizetype i = begin; i < end; ++i) {
+        const float x = p.x[i];
+        const float y = p.y[i];
+        const float z = p.z[i];
+        p.x[i] = m[0] * x + m[4] * y + m[8] * z + m[12];
+        p.y[i] = m[1] * x + m[5] * y + m[9] * z + m[13];
+        p.z[i] = m[2] * x + m[6] * y + m[10] * z + m[14];
+    }
+}
+
+// Partial k collects the points with index k modulo kPartialSums, so the
+// vector loops can keep them in registers and still add in the same order
+inline void scalarFacingWeight(ConstPointsSoA n, const float* weights, qsizetype begin,
+                               qsizetype end, const float* d, float threshold,
+                               float* dots, float* partials)
+{
+    for (qsizetype i = begin; i < end; ++i) {
+        const float dot = n.x[i] * d[0] + n.y[i] * d[1] + n.z[i] * d[2];
+        dots[i] = dot;
+        partials[i % GeometryKernels::kPartialSums] += (dot - threshold) > 0.0f ? weights[i] : 0.0f;
+    }
+}
+
+// Vector versions written once against a small register interface; each
+// SIMD unit instantiates them with its own intrinsics. Ops supplies Reg,
+// kWidth, load/store/set1, add/sub/mul/div/sqrt, min/max (a < b ? a : b and
+// a > b ? a : b, as the scalar code) and zeroUnlessPositive(test, value).
+// The triangle test also needs Mask, greater(a, b) (false when unordered),
+// both/either/andNot on masks, select(mask, a, b) and bits(mask).
+
+template <typename Ops>
+void simdFacetNormals(ConstPointsSoA a, ConstPointsSoA b, ConstPointsSoA c,
+                      PointsSoA n, qsizetype count)
+{
+    qsizetype i = 0;
+    for (; i + Ops::kWidth <= count; i += Ops::kWidth) {
+        const typename Ops::Reg ax = Ops::load(a.x + i);
+        const typename Ops::Reg ay = Ops::load(a.y + i);
+        const typename Ops::Reg az = Ops::load(a.z + i);
+        const typename Ops::Reg e1x = Ops::sub(Ops::load(b.x + i), ax);
+        const typename Ops::Reg e1y = Ops::sub(Ops::load(b.y + i), ay);
+        const typename Ops::Reg e1z = Ops::sub(Ops::load(b.z + i), az);
+        const typename Ops::Reg e2x = Ops::sub(Ops::load(c.x + i), ax);
+        const typename Ops::Reg e2y = Ops::sub(Ops::load(c.y + i), ay);
+        const typename Ops::Reg e2z = Ops::sub(Ops::load(c.z + i), az);
+        
+        const typename Ops::Reg nx = Ops::sub(Ops::mul(e1y, e2z), Ops::mul(e1z, e2y));
+        const typename Ops::Reg ny = Ops::sub(Ops::mul(e1z, e2x), Ops::mul(e1x, e2z));
+        const typename Ops::Reg nz = Ops::sub(Ops::mul(e1x, e2y), Ops::mul(e1y, e2x));
+        const typename Ops::Reg length2 = Ops::add(Ops::add(Ops::mul(nx, nx), Ops::mul(ny, ny)),
+                                                   Ops::mul(nz, nz));
+        const typename Ops::Reg length = Ops::sqrt(length2);
+        
+        Ops::store(n.x + i, Ops::zeroUnlessPositive(length2, Ops::div(nx, length)));
+        Ops::store(n.y + i, Ops::zeroUnlessPositive(length2, Ops::div(ny, length)));
+        Ops::store(n.z + i, Ops::zeroUnlessPositive(length2, Ops::div(nz, length)));
+    }
+    scalarFacetNormals(a, b, c, n, i, count);
+}
+
+template <typename Ops>
+void simdExtendBounds(ConstPointsSoA p, qsizetype count, float* minBounds, float* maxBounds)
+{
+    qsizetype i = 0;
+    if (count >= Ops::kWidth) {
+        typename Ops::Reg minX = Ops::set1(minBounds[0]);
+        typename Ops::Reg minY = Ops::set1(minBounds[1]);
+        typename Ops::Reg minZ = Ops::set1(minBounds[2]);
+        typename Ops::Reg maxX = Ops::set1(maxBounds[0]);
+        typename Ops::Reg maxY = Ops::set1(maxBounds[1]);
+        typename Ops::Reg maxZ = Ops::set1(maxBounds[2]);
+        
+        for (; i + Ops::kWidth <= count; i += Ops::kWidth) {
+            const typename Ops::Reg x = Ops::load(p.x + i);
+            const typename Ops::Reg y = Ops::load(p.y + i);
+            const typename Ops::Reg z = Ops::load(p.z + i);
+            minX = Ops::min(x, minX);
+            minY = Ops::min(y, minY);
+            minZ = Ops::min(z, minZ);
+            maxX = Ops::max(x, maxX);
+            maxY = Ops::max(y, maxY);
+            maxZ = Ops::max(z, maxZ);
+        }
+        
+        // Fold the lanes with the scalar comparison
+        alignas(64) float lanes[6][Ops::kWidth];
+        Ops::store(lanes[0], minX);
+        Ops::store(lanes[1], minY);
+        Ops::store(lanes[2], minZ);
+        Ops::store(lanes[3], maxX);
+        Ops::store(lanes[4], maxY);
+        Ops::store(lanes[5], maxZ);
+        const ConstPointsSoA minLanes{lanes[0], lanes[1], lanes[2]};
+        const ConstPointsSoA maxLanes{lanes[3], lanes[4], lanes[5]};
+        float unused[3];
+        scalarExtendBounds(minLanes, 0, Ops::kWidth, minBounds, unused);
+        scalarExtendBounds(maxLanes, 0, Ops::kWidth, unused, maxBounds);
+    }
+    scalarExtendBounds(p, i, count, minBounds, maxBounds);
+}
+
+template <typename Ops>
+void simdTranslateScale(PointsSoA p, qsizetype count, const float* translation, float scale)
+{
+    const typename Ops::Reg tx = Ops::set1(translation[0]);
+    const typename Ops::Reg ty = Ops::set1(translation[1]);
+    const typename Ops::Reg tz = Ops::set1(translation[2]);
+    const typename Ops::Reg s = Ops::set1(scale);
+    
+    qsizetype i = 0;
+    for (; i + Ops::kWidth <= count; i += Ops::kWidth) {
+        Ops::store(p.x + i, Ops::mul(Ops::add(Ops::load(p.x + i), tx), s));
+        Ops::store(p.y + i, Ops::mul(Ops::add(Ops::load(p.y + i), ty), s));
+        Ops::store(p.z + i, Ops::mul(Ops::add(Ops::load(p.z + i), tz), s));
+    }
+    scalarTranslateScale(p, i, count, translation, scale);
+}
+
+template <typename Ops>
+void simdTransform(PointsSoA p, qsizetype count, const float* m)
+{
+    typename Ops::Reg column[12];
+    for (int k = 0; k < 12; ++k) {
+        // Rows 0-2 of each column; the projective row is ignored
+        column[k] = Ops::set1(m[(k / 3) * 4 + k % 3]);
+    }
+    
+    qsizetype i = 0;
+    for (; i + Ops::kWidth <= count; i += Ops::kWidth) {
+        const typename Ops::Reg x = Ops::load(p.x + i);
+        const typename Ops::Reg y = Ops::load(p.y + i);
+        const typename Ops::Reg z = Ops::load(p.z + i);
+        float* out[3] = {p.x + i, p.y + i, p.z + i};
+        for (int row = 0; row < 3; ++row) {
+            const typename Ops::Reg r = Ops::add(Ops::add(Ops::add(Ops::mul(column[row], x),
+                                                                   Ops::mul(column[3 + row], y)),
+                                                          Ops::mul(column[6 + row], z)),
+                                                 column[9 + row]);
+            Ops::store(out[row], r);
+        }
+    }
+    scalarTransform(p, i, count, m);
+}
+
+template <typename Ops>
+void simdFacingWeight(ConstPointsSoA n, const float* weights, qsizetype count,
+                      const float* d, float threshold, float* dots, float* partials)
+{
+    const int kPartialSums = GeometryKernels::kPartialSums;
+    const int kRegisters = kPartialSums / Ops::kWidth;
+    const typename Ops::Reg dx = Ops::set1(d[0]);
+    const typename Ops::Reg dy = Ops::set1(d[1]);
+    const typename Ops::Reg dz = Ops::set1(d[2]);
+    const typename Ops::Reg t = Ops::set1(threshold);
+    
+    typename Ops::Reg sums[kRegisters];
+    for (int r = 0; r < kRegisters; ++r) {
+        sums[r] = Ops::load(partials + r * Ops::kWidth);
+    }
+    
+    qsizetype i = 0;
+    for (; i + kPartialSums <= count; i += kPartialSums) {
+        for (int r = 0; r < kRegisters; ++r) {
+            const qsizetype j = i + r * Ops::kWidth;
+            const typename Ops::Reg dot = Ops::add(Ops::add(Ops::mul(Ops::load(n.x + j), dx),
+                                                            Ops::mul(Ops::load(n.y + j), dy)),
+                                                   Ops::mul(Ops::load(n.z + j), dz));
+            Ops::store(dots + j, dot);
+            sums[r] = Ops::add(sums[r], Ops::zeroUnlessPositive(Ops::sub(dot, t),
+                                                                Ops::load(weights + j)));
+        }
+    }
+    
+    for (int r = 0; r < kRegisters; ++r) {
+        Ops::store(partials + r * Ops::kWidth, sums[r]);
+    }
+    scalarFacingWeight(n, weights, i, count, d, threshold, dots, partials);
+}
+
+// The triangle test is too branchy to mirror by hand, so its scalar
+// reference instantiates the same template with one-lane ops; the operation
+// order cannot drift between the paths
+struct ScalarOps {
+    using Reg = float;
+    using Mask = bool;
+    static const int kWidth = 1;
+    
+    static Reg load(const float* p) { return *p; }
+    static Reg set1(float v) { return v; }
+    static Reg add(Reg a, Reg b) { return a + b; }
+    static Reg sub(Reg a, Reg b) { return a - b; }
+    static Reg mul(Reg a, Reg b) { return a * b; }
+    static Reg div(Reg a, Reg b) { return a / b; }
+    static Reg sqrt(Reg a) { return kernelSqrt(a); }
+    static Reg min(Reg a, Reg b) { return a < b ? a : b; }
+    static Reg max(Reg a, Reg b) { return a > b ? a : b; }
+    static Mask greater(Reg a, Reg b) { return a > b; }
+    static Mask both(Mask a, Mask b) { return a && b; }
+    static Mask either(Mask a, Mask b) { return a || b; }
+    static Mask andNot(Mask a, Mask b) { return a && !b; }
+    static Reg select(Mask m, Reg a, Reg b) { return m ? a : b; }
+    static int bits(Mask m) { return m ? 1 : 0; }
+};
+
+template <typename Ops>
+struct Vec3 {
+    typename Ops::Reg x;
+    typename Ops::Reg y;
+    typename Ops::Reg z;
+    
+    static Vec3 load(ConstPointsSoA p, qsizetype i)
+    {
+        return {Ops::load(p.x + i), Ops::load(p.y + i), Ops::load(p.z + i)};
+    }
+    Vec3 operator-(const Vec3& o) const { return {Ops::sub(x, o.x), Ops::sub(y, o.y), Ops::sub(z, o.z)}; }
+    
+    static Vec3 cross(const Vec3& a, const Vec3& b)
+    {
+        return {Ops::sub(Ops::mul(a.y, b.z), Ops::mul(a.z, b.y)),
+                Ops::sub(Ops::mul(a.z, b.x), Ops::mul(a.x, b.z)),
+                Ops::sub(Ops::mul(a.x, b.y), Ops::mul(a.y, b.x))};
+    }
+    static typename Ops::Reg dot(const Vec3& a, const Vec3& b)
+    {
+        return Ops::add(Ops::add(Ops::mul(a.x, b.x), Ops::mul(a.y, b.y)), Ops::mul(a.z, b.z));
+    }
+};
+
+template <typename Ops>
+typename Ops::Reg absolute(typename Ops::Reg v)
+{
+    return Ops::max(v, Ops::sub(Ops::set1(0.0f), v));
+}
+
+// Unnormalized distances of p[] to the plane of t[], snapped to zero near
+// it. The mask is set where the plane is defined and the corners lie
+// strictly on both sides.
+template <typename Ops>
+typename Ops::Mask planeStraddle(const Vec3<Ops> t[3], const Vec3<Ops> p[3],
+                                 Vec3<Ops>& normal, typename Ops::Reg d[3])
+{
+    using Reg = typename Ops::Reg;
+    using Mask = typename Ops::Mask;
+    const Reg zero = Ops::set1(0.0f);
+    
+    normal = Vec3<Ops>::cross(t[1] - t[0], t[2] - t[0]);
+    const Reg length2 = Vec3<Ops>::dot(normal, normal);
+    const Reg length = Ops::sqrt(length2);
+    const Reg epsilon = Ops::mul(Ops::mul(Ops::set1(1e-5f), length), Ops::sqrt(length));
+    
+    for (int k = 0; k < 3; ++k) {
+        d[k] = Vec3<Ops>::dot(normal, p[k] - t[0]);
+        d[k] = Ops::select(Ops::greater(absolute<Ops>(d[k]), epsilon), d[k], zero);
+    }
+    const Mask below = Ops::either(Ops::either(Ops::greater(zero, d[0]), Ops::greater(zero, d[1])),
+                                   Ops::greater(zero, d[2]));
+    const Mask above = Ops::either(Ops::either(Ops::greater(d[0], zero), Ops::greater(d[1], zero)),
+                                   Ops::greater(d[2], zero));
+    return Ops::both(Ops::greater(length2, zero), Ops::both(below, above));
+}
+
+// Interval of the planes' intersection line covered by a triangle, from its
+// corners projected onto the line and their distances to the other plane.
+// The corner alone on its side of the plane is the pivot.
+template <typename Ops>
+void lineInterval(const typename Ops::Reg p[3], const typename Ops::Reg d[3],
+                  typename Ops::Reg& low, typename Ops::Reg& high)
+{
+    using Reg = typename Ops::Reg;
+    using Mask = typename Ops::Mask;
+    const Reg zero = Ops::set1(0.0f);
+    
+    // The first of these that holds picks the pivot: d0 d1 > 0 (corner 2),
+    // d0 d2 > 0 (corner 1), d1 d2 > 0 or d0 != 0 (corner 0), d1 != 0
+    // (corner 1), else corner 2
+    const Mask pivot2 = Ops::greater(Ops::mul(d[0], d[1]), zero);
+    const Mask pivot1 = Ops::andNot(Ops::greater(Ops::mul(d[0], d[2]), zero), pivot2);
+    const Mask pivot0 = Ops::andNot(Ops::andNot(Ops::either(Ops::greater(Ops::mul(d[1], d[2]), zero),
+                                                            Ops::greater(absolute<Ops>(d[0]), zero)),
+                                                pivot2), pivot1);
+    const Mask pivot1b = Ops::andNot(Ops::andNot(Ops::andNot(Ops::greater(absolute<Ops>(d[1]), zero),
+                                                             pivot2), pivot1), pivot0);
+    const Mask one = Ops::either(pivot1, pivot1b);
+    
+    // Corners rotated so the pivot comes first
+    auto rotated = [&](const Reg v[3], int k) {
+        return Ops::select(pivot0, v[k % 3], Ops::select(one, v[(k + 1) % 3], v[(k + 2) % 3]));
+    };
+    const Reg pi = rotated(p, 0);
+    const Reg pj = rotated(p, 1);
+    const Reg pk = rotated(p, 2);
+    const Reg di = rotated(d, 0);
+    const Reg dj = rotated(d, 1);
+    const Reg dk = rotated(d, 2);
+    
+    const Reg t1 = Ops::add(pi, Ops::div(Ops::mul(Ops::sub(pj, pi), di), Ops::sub(di, dj)));
+    const Reg t2 = Ops::add(pi, Ops::div(Ops::mul(Ops::sub(pk, pi), di), Ops::sub(di, dk)));
+    low = Ops::min(t1, t2);
+    high = Ops::max(t1, t2);
+}
+
+template <typename Ops>
+typename Ops::Mask trianglesCrossLanes(const ConstPointsSoA a[3], const ConstPointsSoA b[3],
+                                       qsizetype i)
+{
+    using Reg = typename Ops::Reg;
+    using Mask = typename Ops::Mask;
+    const Vec3<Ops> ta[3] = {Vec3<Ops>::load(a[0], i), Vec3<Ops>::load(a[1], i),
+                             Vec3<Ops>::load(a[2], i)};
+    const Vec3<Ops> tb[3] = {Vec3<Ops>::load(b[0], i), Vec3<Ops>::load(b[1], i),
+                             Vec3<Ops>::load(b[2], i)};
+    
+    // Each triangle must straddle the other's plane
+    Vec3<Ops> normalA;
+    Vec3<Ops> normalB;
+    Reg da[3];
+    Reg db[3];
+    const Mask straddle = Ops::both(planeStraddle<Ops>(tb, ta, normalB, da),
+                                    planeStraddle<Ops>(ta, tb, normalA, db));
+    
+    // and their intervals on the line overlap, compared on its dominant axis
+    const Vec3<Ops> direction = Vec3<Ops>::cross(normalA, normalB);
+    const Reg ax = absolute<Ops>(direction.x);
+    const Reg ay = absolute<Ops>(direction.y);
+    const Mask useY = Ops::greater(ay, ax);
+    const Mask useZ = Ops::greater(absolute<Ops>(direction.z), Ops::select(useY, ay, ax));
+    auto project = [&](const Vec3<Ops>& v) {
+        return Ops::select(useZ, v.z, Ops::select(useY, v.y, v.x));
+    };
+    const Reg pa[3] = {project(ta[0]), project(ta[1]), project(ta[2])};
+    const Reg pb[3] = {project(tb[0]), project(tb[1]), project(tb[2])};
+    Reg lowA, highA, lowB, highB;
+    lineInterval<Ops>(pa, da, lowA, highA);
+    lineInterval<Ops>(pb, db, lowB, highB);
+    
+    return Ops::both(straddle, Ops::both(Ops::greater(highA, lowB), Ops::greater(highB, lowA)));
+}
+
+inline void scalarTrianglesCross(const ConstPointsSoA a[3], const ConstPointsSoA b[3],
+                                 qsizetype begin, qsizetype end, bool* hits)
+{
+    for (qsizetype i = begin; i < end; ++i) {
+        hits[i] = trianglesCrossLanes<ScalarOps>(a, b, i);
+    }
+}
+
+template <typename Ops>
+void simdTrianglesCross(const ConstPointsSoA a[3], const ConstPointsSoA b[3],
+                        qsizetype count, bool* hits)
+{
+    qsizetype i = 0;
+    for (; i + Ops::kWidth <= count; i += Ops::kWidth) {
+        const int lanes = Ops::bits(trianglesCrossLanes<Ops>(a, b, i));
+        for (int k = 0; k < Ops::kWidth; ++k) {
+            hits[i + k] = (lanes >> k) & 1;
+        }
+    }
+    scalarTrianglesCross(a, b, i, count, hits);
+}
+
+template <typename Ops>
+KernelTable simdKernelTable()
+{
+    return {simdFacetNormals<Ops>, simdExtendBounds<Ops>,
+            simdTranslateScale<Ops>, simdTransform<Ops>, simdFacingWeight<Ops>,
+            simdTrianglesCross<Ops>};
+}
+
+} // namespace
+
+#if defined(STLVIEWER_X86_KERNELS)
+const KernelTable& sseKernelTable();
+const KernelTable& avx2KernelTable();
+const KernelTable& avx512KernelTable();
+#endif
+
+#endif // GEOMETRYKERNELS_P_H
@@ -0,0 +1,40 @@
+#include "geometrykernels_p.h"
+#include <immintrin.h>
+
+namespace {
+
+struct SseOps {
+    using Reg = __m128;
+    static const int kWidth = 4;
+    
+    static Reg load(const float* p) { return _mm_loadu_ps(p); }
+    static void store(float* p, Reg v) { _mm_storeu_ps(p, v); }
+    static Reg set1(float v) { return _mm_set1_ps(v); }
+    static Reg add(Reg a, Reg b) { return _mm_add_ps(a, b); }
+    static Reg sub(Reg a, Reg b) { return _mm_sub_ps(a, b); }
+    static Reg mul(Reg a, Reg b) { return _mm_mul_ps(a, b); }
+    static Reg div(Reg a, Reg b) { return _mm_div_ps(a, b); }
+    static Reg sqrt(Reg a) { return _mm_sqrt_ps(a); }
+    static Reg min(Reg a, Reg b) { return _mm_min_ps(a, b); }
+    static Reg max(Reg a, Reg b) { return _mm_max_ps(a, b); }
+    static Reg zeroUnlessPositive(Reg test, Reg value)
+    {
+        return _mm_and_ps(_mm_cmpgt_ps(test, _mm_setzero_ps()), value);
+    }
+    
+    using Mask = __m128;
+    static Mask greater(Reg a, Reg b) { return _mm_cmpgt_ps(a, b); }
+    static Mask both(Mask a, Mask b) { return _mm_and_ps(a, b); }
+    static Mask either(Mask a, Mask b) { return _mm_or_ps(a, b); }
+    static Mask andNot(Mask a, Mask b) { return _mm_andnot_ps(b, a); }
+    static Reg select(Mask m, Reg a, Reg b) { return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b)); }
+    static int bits(Mask m) { return _mm_movemask_ps(m); }
+};
+
+} // namespace
+
+const KernelTable& sseKernelTable()
+{
+    static const KernelTable table = simdKernelTable<SseOps>();
+    return table;
+}
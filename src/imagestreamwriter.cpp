@@ -0,0 +1,396 @@
+#include "imagestreamwriter.h"
+#include <QFileInfo>
+#include <QtEndian>
+#include <algorithm>
+#include <limits>
+
+#ifdef STLVIEWER_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+namespace {
+
+// Flush compressed data as an IDAT chunk once this much has built up
+constexpr qsizetype kImageDataChunkSize = 1 << 20;
+
+// Largest payload of one uncompressed deflate block
+constexpr qsizetype kStoredBlockSize = 65535;
+
+// Rows per TIFF strip; readers load a strip at a time
+constexpr int kTiffRowsPerStrip = 64;
+
+quint32 crc32Update(quint32 crc, const uchar* data, qsizetype size)
+{
+    static quint32 table[256];
+    static const bool initialized = [] {
+        for (quint32 n = 0; n < 256; ++n) {
+            quint32 c = n;
+            for (int k = 0; k < 8; ++k) {
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            table[n] = c;
+        }
+        return true;
+    }();
+    Q_UNUSED(initialized);
+    
+    crc = ~crc;
+    for (qsizetype i = 0; i < size; ++i) {
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+quint32 adler32Update(quint32 adler, const uchar* data, qsizetype size)
+{
+    quint32 a = adler & 0xFFFF;
+    quint32 b = adler >> 16;
+    while (size > 0) {
+        // 5552 bytes is the most that can be summed before b can overflow
+        const qsizetype n = qMin<qsizetype>(size, 5552);
+        for (qsizetype i = 0; i < n; ++i) {
+            a += data[i];
+            b += a;
+        }
+        a %= 65521;
+        b %= 65521;
+        data += n;
+        size -= n;
+    }
+    return (b << 16) | a;
+}
+
+void appendBigEndian(QByteArray& out, quint32 value)
+{
+    uchar bytes[4];
+    qToBigEndian(value, bytes);
+    out.append(reinterpret_cast<const char*>(bytes), 4);
+}
+
+void appendLittleEndian16(QByteArray& out, quint16 value)
+{
+    uchar bytes[2];
+    qToLittleEndian(value, bytes);
+    out.append(reinterpret_cast<const char*>(bytes), 2);
+}
+
+void appendLittleEndian32(QByteArray& out, quint32 value)
+{
+    uchar bytes[4];
+    qToLittleEndian(value, bytes);
+    out.append(reinterpret_cast<const char*>(bytes), 4);
+}
+
+} // namespace
+
+std::unique_ptr<ImageStreamWriter> ImageStreamWriter::create(const QString& filename)
+{
+    const QString suffix = QFileInfo(filename).suffix().toLower();
+    if (suffix == "png") {
+        return std::unique_ptr<ImageStreamWriter>(new PngStreamWriter());
+    }
+    if (suffix == "tif" || suffix == "tiff") {
+        return std::unique_ptr<ImageStreamWriter>(new TiffStreamWriter());
+    }
+    return nullptr;
+}
+
+bool ImageStreamWriter::isSupported(const QString& filename)
+{
+    return create(filename) != nullptr;
+}
+
+PngStreamWriter::PngStreamWriter()
+    : m_width(0)
+    , m_height(0)
+    , m_rowsWritten(0)
+    , m_stream(nullptr)
+    , m_adler(1)
+{
+}
+
+PngStreamWriter::~PngStreamWriter()
+{
+#ifdef STLVIEWER_HAVE_ZLIB
+    if (m_stream) {
+        deflateEnd(static_cast<z_stream*>(m_stream));
+        delete static_cast<z_stream*>(m_stream);
+    }
+#endif
+}
+
+bool PngStreamWriter::begin(const QString& filename, int width, int height, QString& error)
+{
+    if (width <= 0 || height <= 0) {
+        error = "Image size must be positive";
+        return false;
+    }
+    
+    m_file.setFileName(filename);
+    if (!m_file.open(QIODevice::WriteOnly)) {
+        error = QString("Cannot write file: %1").arg(m_file.errorString());
+        return false;
+    }
+    
+    m_width = width;
+    m_height = height;
+    m_rowsWritten = 0;
+    m_filteredRow.resize(1 + qsizetype(width) * 3);
+    m_imageData.clear();
+    
+    static const char signature[8] = {'\x89', 'P', 'N', 'G', '\r', '\n', '\x1A', '\n'};
+    m_file.write(signature, sizeof(signature));
+    
+    // 8-bit truecolor, no interlacing
+    QByteArray header;
+    appendBigEndian(header, quint32(width));
+    appendBigEndian(header, quint32(height));
+    header.append(char(8));
+    header.append(char(2));
+    header.append(char(0));
+    header.append(char(0));
+    header.append(char(0));
+    if (!writeChunk("IHDR", header)) {
+        error = QString("Cannot write file: %1").arg(m_file.errorString());
+        return false;
+    }
+    
+#ifdef STLVIEWER_HAVE_ZLIB
+    z_stream* stream = new z_stream();
+    if (deflateInit(stream, Z_BEST_SPEED) != Z_OK) {
+        delete stream;
+        error = "Cannot initialize the PNG compressor";
+        return false;
+    }
+    m_stream = stream;
+#else
+    // zlib header for a stream of stored (uncompressed) deflate blocks
+    m_imageData.append(char(0x78));
+    m_imageData.append(char(0x01));
+    m_adler = 1;
+#endif
+    return true;
+}
+
+bool PngStreamWriter::writeRows(const uchar* rgb, int rows, QString& error)
+{
+    const qsizetype rowBytes = qsizetype(m_width) * 3;
+    uchar* filtered = reinterpret_cast<uchar*>(m_filteredRow.data());
+    
+    for (int r = 0; r < rows; ++r) {
+        const uchar* row = rgb + r * rowBytes;
+#ifdef STLVIEWER_HAVE_ZLIB
+        // Sub filter: each byte minus the same channel of the pixel to its
+        // left, which makes smooth shading compress well
+        filtered[0] = 1;
+        for (qsizetype i = 0; i < 3; ++i) {
+            filtered[1 + i] = row[i];
+        }
+        for (qsizetype i = 3; i < rowBytes; ++i) {
+            filtered[1 + i] = uchar(row[i] - row[i - 3]);
+        }
+#else
+        filtered[0] = 0;
+        std::copy(row, row + rowBytes, filtered + 1);
+#endif
+        compress(filtered, m_filteredRow.size(), false);
+        
+        if (!flushImageData(false)) {
+            error = QString("Cannot write file: %1").arg(m_file.errorString());
+            return false;
+        }
+    }
+    
+    m_rowsWritten += rows;
+    return true;
+}
+
+void PngStreamWriter::compress(const uchar* data, qsizetype size, bool last)
+{
+#ifdef STLVIEWER_HAVE_ZLIB
+    z_stream* stream = static_cast<z_stream*>(m_stream);
+    stream->next_in = const_cast<Bytef*>(data);
+    stream->avail_in = uInt(size);
+    
+    uchar buffer[16384];
+    do {
+        stream->next_out = buffer;
+        stream->avail_out = sizeof(buffer);
+        deflate(stream, last ? Z_FINISH : Z_NO_FLUSH);
+        m_imageData.append(reinterpret_cast<const char*>(buffer),
+                           qsizetype(sizeof(buffer) - stream->avail_out));
+    } while (stream->avail_out == 0);
+#else
+    // Stored blocks: a header byte, then the length and its complement
+    m_adler = adler32Update(m_adler, data, size);
+    do {
+        const qsizetype n = qMin(size, kStoredBlockSize);
+        const bool finalBlock = last && n == size;
+        m_imageData.append(char(finalBlock ? 1 : 0));
+        appendLittleEndian16(m_imageData, quint16(n));
+        appendLittleEndian16(m_imageData, quint16(~n));
+        m_imageData.append(reinterpret_cast<const char*>(data), n);
+        data += n;
+        size -= n;
+    } while (size > 0);
+    
+    if (last) {
+        appendBigEndian(m_imageData, m_adler);
+    }
+#endif
+}
+
+bool PngStreamWriter::flushImageData(bool force)
+{
+    if (m_imageData.size() < kImageDataChunkSize && !(force && !m_imageData.isEmpty())) {
+        return true;
+    }
+    const bool written = writeChunk("IDAT", m_imageData);
+    m_imageData.clear();
+    return written;
+}
+
+bool PngStreamWriter::finish(QString& error)
+{
+    if (m_rowsWritten != m_height) {
+        error = QString("Image has %1 of %2 rows").arg(m_rowsWritten).arg(m_height);
+        return false;
+    }
+    
+    compress(nullptr, 0, true);
+    if (!flushImageData(true) || !writeChunk("IEND", QByteArray())) {
+        error = QString("Cannot write file: %1").arg(m_file.errorString());
+        return false;
+    }
+    m_file.close();
+    return true;
+}
+
+bool PngStreamWriter::writeChunk(const char* type, const QByteArray& data)
+{
+    QByteArray header;
+    appendBigEndian(header, quint32(data.size()));
+    header.append(type, 4);
+    
+    quint32 crc = crc32Update(0, reinterpret_cast<const uchar*>(type), 4);
+    crc = crc32Update(crc, reinterpret_cast<const uchar*>(data.constData()), data.size());
+    QByteArray trailer;
+    appendBigEndian(trailer, crc);
+    
+    return m_file.write(header) == header.size()
+        && m_file.write(data) == data.size()
+        && m_file.write(trailer) == trailer.size();
+}
+
+TiffStreamWriter::TiffStreamWriter()
+    : m_width(0)
+    , m_height(0)
+    , m_rowsWritten(0)
+{
+}
+
+bool TiffStreamWriter::begin(const QString& filename, int width, int height, QString& error)
+{
+    if (width <= 0 || height <= 0) {
+        error = "Image size must be positive";
+        return false;
+    }
+    
+    // Uncompressed strips have known sizes, so the whole directory can be
+    // written up front and the pixels appended after it
+    const qint64 rowBytes = qint64(width) * 3;
+    const quint32 stripCount = quint32((height + kTiffRowsPerStrip - 1) / kTiffRowsPerStrip);
+    const qint64 entryCount = 10;
+    const qint64 ifdSize = 2 + entryCount * 12 + 4;
+    const qint64 bitsOffset = 8 + ifdSize;
+    const qint64 offsetsOffset = bitsOffset + 6;
+    const qint64 countsOffset = offsetsOffset + 4 * stripCount;
+    const qint64 dataOffset = countsOffset + 4 * stripCount;
+    
+    if (dataOffset + rowBytes * height > std::numeric_limits<quint32>::max()) {
+        error = "Image is too large for a TIFF file; use PNG";
+        return false;
+    }
+    
+    m_file.setFileName(filename);
+    if (!m_file.open(QIODevice::WriteOnly)) {
+        error = QString("Cannot write file: %1").arg(m_file.errorString());
+        return false;
+    }
+    
+    m_width = width;
+    m_height = height;
+    m_rowsWritten = 0;
+    
+    QByteArray header;
+    header.append("II*", 3);
+    header.append(char(0));
+    appendLittleEndian32(header, 8);
+    
+    enum FieldType : quint16 { Short = 3, Long = 4 };
+    auto entry = [&header](quint16 tag, FieldType type, quint32 count, quint32 value) {
+        appendLittleEndian16(header, tag);
+        appendLittleEndian16(header, type);
+        appendLittleEndian32(header, count);
+        if (type == Short && count == 1) {
+            // Short values sit in the low bytes of the value field
+            appendLittleEndian16(header, quint16(value));
+            appendLittleEndian16(header, 0);
+        } else {
+            appendLittleEndian32(header, value);
+        }
+    };
+    
+    // Single values are stored inline, arrays by offset
+    const bool oneStrip = stripCount == 1;
+    appendLittleEndian16(header, quint16(entryCount));
+    entry(256, Long, 1, quint32(width));                 // ImageWidth
+    entry(257, Long, 1, quint32(height));                // ImageLength
+    entry(258, Short, 3, quint32(bitsOffset));           // BitsPerSample
+    entry(259, Short, 1, 1);                             // Compression: none
+    entry(262, Short, 1, 2);                             // Photometric: RGB
+    entry(273, Long, stripCount, oneStrip ? quint32(dataOffset) : quint32(offsetsOffset));
+    entry(277, Short, 1, 3);                             // SamplesPerPixel
+    entry(278, Long, 1, kTiffRowsPerStrip);              // RowsPerStrip
+    entry(279, Long, stripCount, oneStrip ? quint32(rowBytes * height) : quint32(countsOffset));
+    entry(284, Short, 1, 1);                             // PlanarConfiguration
+    appendLittleEndian32(header, 0);                     // no further directories
+    
+    for (int i = 0; i < 3; ++i) {
+        appendLittleEndian16(header, 8);
+    }
+    for (quint32 s = 0; s < stripCount; ++s) {
+        appendLittleEndian32(header, quint32(dataOffset + rowBytes * kTiffRowsPerStrip * s));
+    }
+    for (quint32 s = 0; s < stripCount; ++s) {
+        const int rows = qMin(kTiffRowsPerStrip, height - int(s) * kTiffRowsPerStrip);
+        appendLittleEndian32(header, quint32(rowBytes * rows));
+    }
+    
+    if (m_file.write(header) != header.size()) {
+        error = QString("Cannot write file: %1").arg(m_file.errorString());
+        return false;
+    }
+    return true;
+}
+
+bool TiffStreamWriter::writeRows(const uchar* rgb, int rows, QString& error)
+{
+    const qint64 bytes = qint64(m_width) * 3 * rows;
+    if (m_file.write(reinterpret_cast<const char*>(rgb), bytes) != bytes) {
+        error = QString("Cannot write file: %1").arg(m_file.errorString());
+        return false;
+    }
+    m_rowsWritten += rows;
+    return true;
+}
+
+bool TiffStreamWriter::finish(QString& error)
+{
+    if (m_rowsWritten != m_height) {
+        error = QString("Image has %1 of %2 rows").arg(m_rowsWritten).arg(m_height);
+        return false;
+    }
+    m_file.close();
+    return true;
+}
@@ -1,16 +1,274 @@
 #include <QApplication>
+#include <QSurfaceFormat>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QTextStream>
+#include <QProcess>
+#include <QtConcurrent/QtConcurrentRun>
+#include <QDebug>
+#include <cstring>
+#include <memory>
 #include "mainwindow.h"
+#include "meshscene.h"
+#include "stlviewer.h"
+#include "tiledexporter.h"
+#include "meshorientation.h"
+
+namespace {
+
+enum class RunMode {
+    Window,
+    Export,
+    Orient
+};
+
+// Decided before the application object exists, since a headless export
+// must not create a QApplication and the orientation report needs no GUI
+RunMode runMode(int argc, char *argv[])
+{
+    RunMode mode = RunMode::Window;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--orient") == 0) {
+            return RunMode::Orient;
+        }
+        if (std::strcmp(argv[i], "--export") == 0 || std::strncmp(argv[i], "--export=", 9) == 0) {
+            mode = RunMode::Export;
+        }
+    }
+    return mode;
+}
+
+// Whether a desktop platform plugin has a display to connect to
+bool hasDisplay()
+{
+#if defined(Q_OS_UNIX) && !defined(Q_OS_MACOS)
+    return qEnvironmentVariableIsSet("DISPLAY") || qEnvironmentVariableIsSet("WAYLAND_DISPLAY");
+#else
+    return true;
+#endif
+}
+
+// Runs the same export in a child process on Qt's default platform plugin.
+// QT_QPA_PLATFORM is set but empty there, which Qt reads as its default and
+// main() reads as a choice it must not override.
+int rerunOnDefaultPlatform()
+{
+    QProcessEnvironment environment = QProcessEnvironment::systemEnvironment();
+    environment.insert("QT_QPA_PLATFORM", QString());
+    QProcess process;
+    process.setProcessEnvironment(environment);
+    process.setProcessChannelMode(QProcess::ForwardedChannels);
+    process.start(QCoreApplication::applicationFilePath(), QCoreApplication::arguments().mid(1));
+    if (!process.waitForFinished(-1) || process.exitStatus() != QProcess::NormalExit) {
+        qCritical() << "Could not rerun the export on the default platform";
+        return 1;
+    }
+    return process.exitCode();
+}
+
+// 'offscreenForced' is set when main() picked the offscreen platform itself
+int runExport(const QCommandLineParser& parser, bool offscreenForced)
+{
+    const QStringList files = parser.positionalArguments();
+    if (files.size() != 1) {
+        qCritical() << "--export needs exactly one STL file";
+        return 1;
+    }
+    
+    const QStringList sizeParts = parser.value("size").split('x');
+    const int width = sizeParts.value(0).toInt();
+    const int height = sizeParts.value(1).toInt();
+    if (sizeParts.size() != 2 || width <= 0 || height <= 0) {
+        qCritical() << "Invalid --size" << parser.value("size") << "(expected WIDTHxHEIGHT)";
+        return 1;
+    }
+    
+    STLViewer::ViewPreset preset = STLViewer::ViewPreset::Perspective;
+    bool presetFound = false;
+    for (STLViewer::ViewPreset candidate : {STLViewer::ViewPreset::Perspective, STLViewer::ViewPreset::Top,
+                                            STLViewer::ViewPreset::Front, STLViewer::ViewPreset::Side}) {
+        if (STLViewer::presetName(candidate).compare(parser.value("view"), Qt::CaseInsensitive) == 0) {
+            preset = candidate;
+            presetFound = true;
+        }
+    }
+    if (!presetFound) {
+        qCritical() << "Unknown --view" << parser.value("view");
+        return 1;
+    }
+    
+    MeshScene scene;
+    QString error;
+    QObject::connect(&scene, &MeshScene::loadError, [&error](const QString& message) {
+        error = message;
+    });
+    if (!scene.loadSTL(files.first())) {
+        if (scene.lastLoadFailure() != MeshScene::LoadFailure::NoContext) {
+            qCritical().noquote() << "Failed to load STL file:" << error;
+            return 1;
+        }
+        // The offscreen plugin needs a driver that can render without a
+        // window system; a desktop session usually has a better one
+        if (offscreenForced && hasDisplay()) {
+            qWarning() << "The offscreen platform could not create an OpenGL context;"
+                          " retrying on the default platform";
+            return rerunOnDefaultPlatform();
+        }
+        qCritical() << "The" << QGuiApplication::platformName()
+                    << "platform could not create an OpenGL context; set QT_QPA_PLATFORM"
+                       " (e.g. xcb under xvfb-run) to use another one";
+        return 1;
+    }
+    
+    ExportView view;
+    view.model = STLViewer::modelMatrix(preset, ViewCamera(), scene.modelScale());
+    view.view = STLViewer::viewMatrix();
+    view.projection = STLViewer::projectionMatrix(preset, float(width) / float(height));
+    view.viewPos = STLViewer::viewPosition();
+    
+    if (!TiledExporter::exportImage(&scene, view, QSize(width, height),
+                                    parser.value("export"), error)) {
+        qCritical().noquote() << "Export failed:" << error;
+        return 1;
+    }
+    return 0;
+}
+
+int runOrient(const QCommandLineParser& parser)
+{
+    const QStringList files = parser.positionalArguments();
+    if (files.size() != 1) {
+        qCritical() << "--orient needs exactly one STL file";
+        return 1;
+    }
+    
+    bool ok = false;
+    const float criticalAngle = parser.value("critical-angle").toFloat(&ok);
+    if (!ok || criticalAngle < 0.0f || criticalAngle >= 90.0f) {
+        qCritical() << "Invalid --critical-angle" << parser.value("critical-angle")
+                    << "(expected degrees from 0 to 89)";
+        return 1;
+    }
+    
+    const ParsedMesh mesh = MeshScene::parse(files.first());
+    if (!mesh.error.isEmpty()) {
+        qCritical().noquote() << "Failed to load STL file:" << mesh.error;
+        return 1;
+    }
+    
+    const OrientationResult result = MeshOrientation::optimize(mesh.triangles, criticalAngle);
+    if (result.candidates.isEmpty()) {
+        qCritical() << "The model is flat; there is no orientation to choose";
+        return 1;
+    }
+    
+    // The report goes to stdout; the timing log stays on stderr
+    QTextStream out(stdout);
+    const QVector3D boxSize = result.box.size();
+    const QVector3D& bounds = result.boundsSize;
+    out << QString("Convex hull: %1 vertices, %2 faces\n")
+               .arg(result.hull.vertices.size()).arg(result.hull.faceCount());
+    out << QString("Minimal box: %1 x %2 x %3, volume %4\n")
+               .arg(boxSize.x(), 0, 'g', 6).arg(boxSize.y(), 0, 'g', 6).arg(boxSize.z(), 0, 'g', 6)
+               .arg(result.box.volume(), 0, 'g', 6);
+    for (int axis = 0; axis < 3; ++axis) {
+        out << QString("  axis %1: %2, %3, %4\n").arg(axis + 1)
+                   .arg(result.box.axes[axis].x(), 0, 'f', 4)
+                   .arg(result.box.axes[axis].y(), 0, 'f', 4)
+                   .arg(result.box.axes[axis].z(), 0, 'f', 4);
+    }
+    out << QString("Axis-aligned box: %1 x %2 x %3, volume %4\n")
+               .arg(bounds.x(), 0, 'g', 6).arg(bounds.y(), 0, 'g', 6).arg(bounds.z(), 0, 'g', 6)
+               .arg(double(bounds.x()) * bounds.y() * bounds.z(), 0, 'g', 6);
+    out << QString("Orientations (%1 searched, critical angle %2°):\n")
+               .arg(result.evaluated).arg(criticalAngle);
+    out << "  rank  up                          height      support     footprint   score\n";
+    for (int i = 0; i < result.candidates.size(); ++i) {
+        const OrientationCandidate& candidate = result.candidates[i];
+        const QString up = QString("%1, %2, %3").arg(candidate.up.x(), 0, 'f', 4)
+                               .arg(candidate.up.y(), 0, 'f', 4).arg(candidate.up.z(), 0, 'f', 4);
+        out << QString("  %1  %2  %3  %4  %5  %6\n")
+                   .arg(i + 1, 4)
+                   .arg(up, -26)
+                   .arg(candidate.height, -10, 'g', 6)
+                   .arg(candidate.supportArea, -10, 'g', 6)
+                   .arg(candidate.footprintArea, -10, 'g', 6)
+                   .arg(candidate.score, 0, 'f', 3);
+    }
+    return 0;
+}
+
+} // namespace
 
 int main(int argc, char *argv[])
 {
-    QApplication app(argc, argv);
+    QElapsedTimer startupTimer;
+    startupTimer.start();
+    
+    // All viewports share one context group so the scene's buffers and
+    // shaders are uploaded once; both must be set before QApplication
+    QCoreApplication::setAttribute(Qt::AA_ShareOpenGLContexts);
+    
+    // Enable multisampling for smoother rendering
+    QSurfaceFormat format = QSurfaceFormat::defaultFormat();
+    format.setSamples(4);
+    QSurfaceFormat::setDefaultFormat(format);
+    
+    const RunMode mode = runMode(argc, argv);
+    std::unique_ptr<QCoreApplication> app;
+    bool offscreenForced = false;
+    if (mode == RunMode::Orient) {
+        app.reset(new QCoreApplication(argc, argv));
+    } else if (mode == RunMode::Export) {
+        // No display is needed unless the user picked a platform plugin
+        if (!qEnvironmentVariableIsSet("QT_QPA_PLATFORM")) {
+            qputenv("QT_QPA_PLATFORM", "offscreen");
+            offscreenForced = true;
+        }
+        app.reset(new QGuiApplication(argc, argv));
+    } else {
+        app.reset(new QApplication(argc, argv));
+    }
+    
+    app->setApplicationName("STL Viewer");
+    app->setApplicationVersion("1.0");
+    app->setOrganizationName("STL Viewer");
+    
+    QCommandLineParser parser;
+    parser.setApplicationDescription("A simple STL file viewer built with Qt and OpenGL.");
+    parser.addHelpOption();
+    parser.addVersionOption();
+    parser.addPositionalArgument("files", "STL file to open.", "[files...]");
+    parser.addOption({"export", "Render the file to an image (.png, .tif) without opening a window.",
+                      "image"});
+    parser.addOption({"size", "Size of the exported image.", "WIDTHxHEIGHT", "4096x3072"});
+    parser.addOption({"view", "View to export: perspective, top, front or side.", "view",
+                      "perspective"});
+    parser.addOption({"orient", "Print the convex hull, minimal bounding box and ranked build "
+                      "orientations of the file without opening a window."});
+    parser.addOption({"critical-angle", "Overhang angle from vertical that needs support, for --orient.",
+                      "degrees", "45"});
+    parser.process(*app);
+    
+    if (mode == RunMode::Orient) {
+        return runOrient(parser);
+    }
+    if (mode == RunMode::Export) {
+        return runExport(parser, offscreenForced);
+    }
     
-    app.setApplicationName("STL Viewer");
-    app.setApplicationVersion("1.0");
-    app.setOrganizationName("STL Viewer");
+    // Parsing starts on a worker before the window, its widgets and its GL
+    // contexts are built, so the two overlap
+    const QStringList files = parser.positionalArguments();
+    QFuture<ParsedMesh> parsing;
+    if (!files.isEmpty()) {
+        parsing = QtConcurrent::run(&MeshScene::parse, files.first());
+    }
     
     MainWindow window;
+    window.setStartupTimer(startupTimer);
+    window.openFiles(files, parsing);
     window.show();
     
-    return app.exec();
+    return app->exec();
 }
@@ -1,16 +1,196 @@
 #include "mainwindow.h"
 #include "stlviewer.h"
+#include "meshscene.h"
+#include "stlloader.h"
+#include "meshdeviation.h"
+#include "meshinterference.h"
+#include "deviationpanel.h"
+#include "meshsegmentation.h"
+#include "componentpanel.h"
+#include "overhangpanel.h"
+#include "meshvoxelizer.h"
+#include "meshorientation.h"
+#include "orientationpanel.h"
+#include "parallelfor.h"
+#include "tiledexporter.h"
+#include "imagestreamwriter.h"
 #include <QApplication>
 #include <QStyle>
 #include <QScreen>
 #include <QFileInfo>
+#include <QActionGroup>
+#include <QLocale>
+#include <QDockWidget>
+#include <QGridLayout>
+#include <QInputDialog>
+#include <QTimer>
+#include <QtConcurrent/QtConcurrentMap>
+#include <QtConcurrent/QtConcurrentRun>
+#include <QDebug>
+
+// Both files of a comparison are parsed side by side on workers, then the
+// test mesh is measured against the reference on the same worker
+struct Comparison {
+    ParsedMesh test;
+    QString referenceFile;
+    QString error;
+    DeviationResult result;
+};
+
+// Assembly parts parsed side by side and checked against each other on a
+// worker. The parts are shown together as one model, in file order; part i
+// holds facets firstFacet[i] to firstFacet[i + 1] of the assembly.
+struct InterferenceCheck {
+    QStringList files;
+    QString error;
+    ParsedMesh assembly;
+    QVector<qsizetype> firstFacet;
+    InterferenceResult result;
+};
+
+// A voxelization with the overlay and voxel view drawn from it, computed on
+// a worker
+struct Voxelization {
+    VoxelizationResult result;
+    float minWall = 0.0f;
+    QVector<quint16> thinWallColors;
+    VoxelSurface surface;
+};
+
+// Ranked build orientations with the hull and box surfaces drawn over the
+// model, computed on a worker
+struct OrientationSearch {
+    OrientationResult result;
+    ShapeSurface hullSurface;
+    ShapeSurface boxSurface;
+};
+
+// Components of the loaded model and the tree that picks them by clicking,
+// both built on a worker
+struct ComponentSearch {
+    Segmentation segmentation;
+    TriangleBVH pickTree;
+};
+
+namespace {
+// Linked viewers follow the dragged one at about 10 frames per second
+const int kLinkedRepaintMs = 100;
+
+Comparison compareFiles(const QString& referenceFile, const QString& testFile)
+{
+    Comparison comparison;
+    comparison.referenceFile = referenceFile;
+    QList<ParsedMesh> meshes = QtConcurrent::blockingMapped(QStringList{referenceFile, testFile},
+                                                            &MeshScene::parse);
+    for (const ParsedMesh& mesh : std::as_const(meshes)) {
+        if (!mesh.error.isEmpty()) {
+            comparison.error = QString("%1: %2").arg(QFileInfo(mesh.filename).fileName(), mesh.error);
+            return comparison;
+        }
+    }
+    
+    // Measured on the parsed copy, so GPU-resident mode works too
+    comparison.result = MeshDeviation::compute(meshes[0].triangles, meshes[1].triangles);
+    comparison.test = std::move(meshes[1]);
+    return comparison;
+}
+
+InterferenceCheck checkParts(const QStringList& files)
+{
+    InterferenceCheck check;
+    check.files = files;
+    const QList<ParsedMesh> meshes = QtConcurrent::blockingMapped(files, &MeshScene::parse);
+    QVector<QVector<Triangle>> parts;
+    for (const ParsedMesh& mesh : meshes) {
+        if (!mesh.error.isEmpty()) {
+            check.error = QString("%1: %2").arg(QFileInfo(mesh.filename).fileName(), mesh.error);
+            return check;
+        }
+        parts.append(mesh.triangles);
+    }
+    
+    check.result = MeshInterference::compute(parts);
+    
+    check.assembly.filename = files.first();
+    bool anyColor = false;
+    for (const ParsedMesh& mesh : meshes) {
+        check.firstFacet.append(check.assembly.triangles.size());
+        check.assembly.triangles += mesh.triangles;
+        anyColor |= !mesh.facetColors.isEmpty();
+    }
+    check.firstFacet.append(check.assembly.triangles.size());
+    if (anyColor) {
+        for (const ParsedMesh& mesh : meshes) {
+            check.assembly.facetColors += mesh.facetColors.isEmpty()
+                ? QVector<quint16>(mesh.triangles.size(), 0) : mesh.facetColors;
+        }
+    }
+    return check;
+}
+
+Voxelization voxelizeModel(const QVector<Triangle>& triangles, int resolution, float minWall)
+{
+    Voxelization voxelization;
+    voxelization.minWall = minWall;
+    voxelization.result = MeshVoxelizer::voxelize(triangles, resolution, minWall);
+    if (voxelization.result.solid.isEmpty()) return voxelization;
+    
+    // Thin walls on the model's own facets at full resolution; the voxel
+    // view is coarser so its face count stays bounded
+    voxelization.thinWallColors = MeshVoxelizer::thinWallFacetColors(triangles, voxelization.result);
+    voxelization.surface = MeshVoxelizer::surface(voxelization.result, 192);
+    return voxelization;
+}
+
+OrientationSearch searchOrientations(const QVector<Triangle>& triangles, float criticalAngle)
+{
+    OrientationSearch search;
+    search.result = MeshOrientation::optimize(triangles, criticalAngle);
+    if (search.result.candidates.isEmpty()) return search;
+    
+    search.hullSurface = MeshHull::surface(search.result.hull, STLLoader::packFacetColor(20, 20, 20));
+    search.boxSurface = MeshHull::surface(search.result.box, STLLoader::packFacetColor(31, 16, 0));
+    return search;
+}
+
+ComponentSearch searchComponents(const QVector<Triangle>& triangles)
+{
+    ComponentSearch search;
+    search.segmentation = MeshSegmentation::compute(triangles);
+    search.pickTree.build(triangles);
+    return search;
+}
+}
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
+    , m_scene(nullptr)
     , m_viewer(nullptr)
+    , m_linkCameras(true)
+    , m_linkedRepaintTimer(nullptr)
+    , m_cameraSource(nullptr)
     , m_statusLabel(nullptr)
+    , m_memoryLabel(nullptr)
     , m_progressBar(nullptr)
     , m_resetButton(nullptr)
+    , m_deviationPanel(nullptr)
+    , m_deviationDock(nullptr)
+    , m_componentPanel(nullptr)
+    , m_componentDock(nullptr)
+    , m_overhangPanel(nullptr)
+    , m_overhangDock(nullptr)
+    , m_showVoxelsAction(nullptr)
+    , m_overlayOwner(OverlayOwner::None)
+    , m_orientationPanel(nullptr)
+    , m_orientationDock(nullptr)
+    , m_loadWatcher(nullptr)
+    , m_compareWatcher(nullptr)
+    , m_interferenceWatcher(nullptr)
+    , m_componentWatcher(nullptr)
+    , m_voxelWatcher(nullptr)
+    , m_orientationWatcher(nullptr)
+    , m_firstFrameLogged(false)
+    , m_awaitingModelFrame(false)
 {
     setupUI();
     setupMenuBar();
@@ -40,9 +220,44 @@ void MainWindow::setupUI()
     
     QVBoxLayout* mainLayout = new QVBoxLayout(centralWidget);
     
-    // Create the STL viewer
-    m_viewer = new STLViewer(this);
-    mainLayout->addWidget(m_viewer);
+    m_linkedRepaintTimer = new QTimer(this);
+    m_linkedRepaintTimer->setSingleShot(true);
+    m_linkedRepaintTimer->setInterval(kLinkedRepaintMs);
+    connect(m_linkedRepaintTimer, &QTimer::timeout, this, &MainWindow::repaintLinkedViewers);
+    
+    // One scene holds the model and its GPU buffers; the viewports only add
+    // a camera each and draw it from their own contexts
+    m_scene = new MeshScene(this);
+    
+    QWidget* viewportArea = new QWidget(this);
+    QGridLayout* viewportLayout = new QGridLayout(viewportArea);
+    viewportLayout->setContentsMargins(0, 0, 0, 0);
+    viewportLayout->setSpacing(2);
+    
+    auto addViewport = [&](STLViewer::ViewPreset preset, int row, int column) {
+        STLViewer* viewer = new STLViewer(m_scene, viewportArea);
+        viewer->setViewPreset(preset);
+        viewportLayout->addWidget(viewer, row, column);
+        m_viewers.append(viewer);
+        connect(viewer, &STLViewer::cameraChanged, this, [this, viewer](const ViewCamera& camera) {
+            onCameraChanged(viewer, camera);
+        });
+        connect(viewer, &STLViewer::pickRequested, this, &MainWindow::onPickRequested);
+        // The followers catch up with the final camera as soon as a drag ends
+        connect(viewer, &STLViewer::interactionFinished, this, [this]() {
+            if (m_linkedRepaintTimer->isActive()) {
+                m_linkedRepaintTimer->stop();
+                repaintLinkedViewers();
+            }
+        });
+        return viewer;
+    };
+    addViewport(STLViewer::ViewPreset::Top, 0, 0);
+    addViewport(STLViewer::ViewPreset::Front, 0, 1);
+    addViewport(STLViewer::ViewPreset::Side, 1, 0);
+    m_viewer = addViewport(STLViewer::ViewPreset::Perspective, 1, 1);
+    mainLayout->addWidget(viewportArea);
+    setFourViewports(false);
     
     // Create control panel
     QHBoxLayout* controlLayout = new QHBoxLayout();
@@ -58,11 +273,65 @@ void MainWindow::setupUI()
     
     mainLayout->addLayout(controlLayout);
     
+    // Deviation results, shown once a comparison has run
+    m_deviationPanel = new DeviationPanel(this);
+    m_deviationDock = new QDockWidget("Deviation", this);
+    m_deviationDock->setWidget(m_deviationPanel);
+    m_deviationDock->setVisible(false);
+    addDockWidget(Qt::RightDockWidgetArea, m_deviationDock);
+    
+    // Connected components, shown once the model has been segmented
+    m_componentPanel = new ComponentPanel(this);
+    m_componentDock = new QDockWidget("Components", this);
+    m_componentDock->setWidget(m_componentPanel);
+    m_componentDock->setVisible(false);
+    addDockWidget(Qt::RightDockWidgetArea, m_componentDock);
+    connect(m_componentPanel, &ComponentPanel::visibilityChanged,
+            this, &MainWindow::onComponentVisibilityChanged);
+    connect(m_componentPanel, &ComponentPanel::colorsChanged,
+            this, &MainWindow::onComponentColorsChanged);
+    
+    // Overhang classification, updated live as the build orientation changes
+    m_overhangPanel = new OverhangPanel(this);
+    m_overhangDock = new QDockWidget("Overhangs", this);
+    m_overhangDock->setWidget(m_overhangPanel);
+    m_overhangDock->setVisible(false);
+    addDockWidget(Qt::RightDockWidgetArea, m_overhangDock);
+    connect(m_overhangPanel, &OverhangPanel::parametersChanged,
+            this, &MainWindow::updateOverhangs);
+    
+    // Ranked build orientations; choosing one drives the overhang view
+    m_orientationPanel = new OrientationPanel(this);
+    m_orientationDock = new QDockWidget("Orientation", this);
+    m_orientationDock->setWidget(m_orientationPanel);
+    m_orientationDock->setVisible(false);
+    addDockWidget(Qt::RightDockWidgetArea, m_orientationDock);
+    connect(m_orientationPanel, &OrientationPanel::candidateSelected,
+            this, &MainWindow::onOrientationSelected);
+    
     // Connect signals
     connect(openButton, &QPushButton::clicked, this, &MainWindow::openFile);
     connect(m_resetButton, &QPushButton::clicked, this, &MainWindow::resetView);
-    connect(m_viewer, &STLViewer::modelLoaded, this, &MainWindow::onModelLoaded);
-    connect(m_viewer, &STLViewer::loadError, this, &MainWindow::onLoadError);
+    connect(m_scene, &MeshScene::modelLoaded, this, &MainWindow::onModelLoaded);
+    connect(m_scene, &MeshScene::loadError, this, &MainWindow::onLoadError);
+    connect(m_scene, &MeshScene::memoryUsageChanged, this, &MainWindow::onMemoryUsageChanged);
+    
+    m_loadWatcher = new QFutureWatcher<ParsedMesh>(this);
+    connect(m_loadWatcher, &QFutureWatcher<ParsedMesh>::finished, this, &MainWindow::onParseFinished);
+    m_compareWatcher = new QFutureWatcher<Comparison>(this);
+    connect(m_compareWatcher, &QFutureWatcher<Comparison>::finished, this, &MainWindow::onCompareFinished);
+    m_interferenceWatcher = new QFutureWatcher<InterferenceCheck>(this);
+    connect(m_interferenceWatcher, &QFutureWatcher<InterferenceCheck>::finished,
+            this, &MainWindow::onInterferenceChecked);
+    m_componentWatcher = new QFutureWatcher<ComponentSearch>(this);
+    connect(m_componentWatcher, &QFutureWatcher<ComponentSearch>::finished,
+            this, &MainWindow::onComponentsFound);
+    m_voxelWatcher = new QFutureWatcher<Voxelization>(this);
+    connect(m_voxelWatcher, &QFutureWatcher<Voxelization>::finished, this, &MainWindow::onVoxelized);
+    m_orientationWatcher = new QFutureWatcher<OrientationSearch>(this);
+    connect(m_orientationWatcher, &QFutureWatcher<OrientationSearch>::finished,
+            this, &MainWindow::onOrientationsFound);
+    connect(m_viewer, &QOpenGLWidget::frameSwapped, this, &MainWindow::onFrameSwapped);
 }
 
 void MainWindow::setupMenuBar()
@@ -76,6 +345,10 @@ void MainWindow::setupMenuBar()
     openAction->setShortcut(QKeySequence::Open);
     connect(openAction, &QAction::triggered, this, &MainWindow::openFile);
     
+    QAction* exportAction = fileMenu->addAction("&Export Image...");
+    exportAction->setShortcut(QKeySequence("Ctrl+E"));
+    connect(exportAction, &QAction::triggered, this, &MainWindow::exportImage);
+    
     fileMenu->addSeparator();
     
     QAction* exitAction = fileMenu->addAction("E&xit");
@@ -89,6 +362,67 @@ void MainWindow::setupMenuBar()
     resetAction->setShortcut(QKeySequence("Ctrl+R"));
     connect(resetAction, &QAction::triggered, this, &MainWindow::resetView);
     
+    viewMenu->addSeparator();
+    
+    QAction* fourViewAction = viewMenu->addAction("&Four Viewports");
+    fourViewAction->setShortcut(QKeySequence("Ctrl+4"));
+    fourViewAction->setCheckable(true);
+    connect(fourViewAction, &QAction::toggled, this, &MainWindow::setFourViewports);
+    
+    QAction* linkAction = viewMenu->addAction("&Link Cameras");
+    linkAction->setCheckable(true);
+    linkAction->setChecked(m_linkCameras);
+    connect(linkAction, &QAction::toggled, this, &MainWindow::setLinkCameras);
+    
+    // Enabled once Analysis > Voxelize has built a voxel surface
+    m_showVoxelsAction = viewMenu->addAction("Show &Voxels");
+    m_showVoxelsAction->setCheckable(true);
+    m_showVoxelsAction->setEnabled(false);
+    connect(m_showVoxelsAction, &QAction::toggled, m_scene, &MeshScene::setVoxelsShown);
+    
+    viewMenu->addSeparator();
+    
+    // Geometry memory submenu
+    QMenu* memoryMenu = viewMenu->addMenu("Geometry &Memory");
+    QActionGroup* memoryGroup = new QActionGroup(this);
+    
+    auto addMemoryMode = [&](const QString& text, MeshScene::MemoryMode mode) {
+        QAction* action = memoryMenu->addAction(text);
+        action->setCheckable(true);
+        action->setChecked(m_scene->memoryMode() == mode);
+        memoryGroup->addAction(action);
+        connect(action, &QAction::triggered, this, [this, mode]() {
+            m_scene->setMemoryMode(mode);
+        });
+    };
+    addMemoryMode("Keep All CPU Copies", MeshScene::MemoryMode::FullCopies);
+    addMemoryMode("Compact (Triangles Only)", MeshScene::MemoryMode::Compact);
+    addMemoryMode("GPU Resident", MeshScene::MemoryMode::GpuResident);
+    
+    // Analysis menu
+    QMenu* analysisMenu = menuBar->addMenu("&Analysis");
+    
+    QAction* compareAction = analysisMenu->addAction("&Compare Meshes...");
+    connect(compareAction, &QAction::triggered, this, &MainWindow::compareMeshes);
+    
+    QAction* interferenceAction = analysisMenu->addAction("Check &Interference...");
+    connect(interferenceAction, &QAction::triggered, this, &MainWindow::checkInterference);
+    
+    QAction* componentsAction = analysisMenu->addAction("Find &Components");
+    connect(componentsAction, &QAction::triggered, this, &MainWindow::findComponents);
+    
+    QAction* overhangAction = analysisMenu->addAction("&Overhangs");
+    connect(overhangAction, &QAction::triggered, this, &MainWindow::analyzeOverhangs);
+    
+    QAction* voxelizeAction = analysisMenu->addAction("&Voxelize...");
+    connect(voxelizeAction, &QAction::triggered, this, &MainWindow::voxelize);
+    
+    QAction* orientationAction = analysisMenu->addAction("Optimize O&rientation");
+    connect(orientationAction, &QAction::triggered, this, &MainWindow::optimizeOrientation);
+    
+    QAction* clearAnalysisAction = analysisMenu->addAction("C&lear Analysis Colors");
+    connect(clearAnalysisAction, &QAction::triggered, this, &MainWindow::clearAnalysis);
+    
     // Help menu
     QMenu* helpMenu = menuBar->addMenu("&Help");
     
@@ -101,6 +435,9 @@ void MainWindow::setupStatusBar()
     m_statusLabel = new QLabel("Ready");
     statusBar()->addWidget(m_statusLabel);
     
+    m_memoryLabel = new QLabel();
+    statusBar()->addPermanentWidget(m_memoryLabel);
+    
     m_progressBar = new QProgressBar();
     m_progressBar->setVisible(false);
     statusBar()->addPermanentWidget(m_progressBar);
@@ -116,18 +453,595 @@ void MainWindow::openFile()
     );
     
     if (!filename.isEmpty()) {
-        m_statusLabel->setText("Loading STL file...");
-        m_progressBar->setVisible(true);
-        m_progressBar->setRange(0, 0); // Indeterminate progress
-        
-        m_viewer->loadSTL(filename);
+        startLoad(filename);
+    }
+}
+
+void MainWindow::exportImage()
+{
+    if (!m_scene->isLoaded()) return;
+    
+    // Export what the last viewport used shows, at its aspect ratio
+    STLViewer* viewer = qobject_cast<STLViewer*>(focusWidget());
+    if (!viewer) {
+        viewer = m_viewer;
+    }
+    
+    QString filename = QFileDialog::getSaveFileName(
+        this,
+        "Export Image",
+        "",
+        "PNG Images (*.png);;TIFF Images (*.tif *.tiff)"
+    );
+    if (filename.isEmpty()) return;
+    if (!ImageStreamWriter::isSupported(filename)) {
+        filename += ".png";
+    }
+    
+    bool ok = false;
+    const int width = QInputDialog::getInt(this, "Export Image", "Width in pixels:",
+                                           16384, 16, 65536, 1, &ok);
+    if (!ok) return;
+    const int height = qMax(1, qRound(double(width) * viewer->height() / qMax(viewer->width(), 1)));
+    
+    ExportView view;
+    view.model = STLViewer::modelMatrix(viewer->viewPreset(), viewer->camera(), m_scene->modelScale());
+    view.view = STLViewer::viewMatrix();
+    view.projection = STLViewer::projectionMatrix(viewer->viewPreset(), float(width) / float(height));
+    view.viewPos = STLViewer::viewPosition();
+    
+    m_statusLabel->setText("Exporting image...");
+    QApplication::setOverrideCursor(Qt::WaitCursor);
+    
+    ExportStats stats;
+    QString error;
+    ok = TiledExporter::exportImage(m_scene, view, QSize(width, height), filename, error, &stats);
+    
+    QApplication::restoreOverrideCursor();
+    
+    if (!ok) {
+        m_statusLabel->setText("Ready");
+        QMessageBox::critical(this, "Export Error",
+            QString("Failed to export image:\n%1").arg(error));
+        return;
+    }
+    
+    m_statusLabel->setText(QString("Exported %1 (%2 x %3) in %4 ms, %5 Mpixel/s")
+                          .arg(QFileInfo(filename).fileName())
+                          .arg(width).arg(height).arg(stats.elapsedMs)
+                          .arg(stats.pixelsPerSecond / 1e6, 0, 'f', 1));
+}
+
+void MainWindow::openFiles(const QStringList& files, const QFuture<ParsedMesh>& parsing)
+{
+    if (files.isEmpty()) return;
+    if (files.size() > 1) {
+        qWarning() << "Only one model is shown at a time; opening" << files.first();
+    }
+    
+    // The parse started with the process, before the window existed
+    if (m_startupTimer.isValid()) {
+        m_openTimer = m_startupTimer;
+    } else {
+        m_openTimer.start();
+    }
+    watchLoad(parsing);
+    
+    // Build the upload context and shaders while the worker parses
+    m_scene->initialize();
+}
+
+void MainWindow::setStartupTimer(const QElapsedTimer& timer)
+{
+    m_startupTimer = timer;
+}
+
+void MainWindow::startLoad(const QString& filename)
+{
+    m_openTimer.start();
+    watchLoad(QtConcurrent::run(&MeshScene::parse, filename));
+}
+
+void MainWindow::watchLoad(const QFuture<ParsedMesh>& parsing)
+{
+    m_statusLabel->setText("Loading STL file...");
+    m_progressBar->setVisible(true);
+    m_progressBar->setRange(0, 0); // Indeterminate progress
+    
+    // A newer request replaces the watched future; a parse still running
+    // for an older one finishes unobserved
+    m_awaitingModelFrame = false;
+    m_loadWatcher->setFuture(parsing);
+}
+
+void MainWindow::onParseFinished()
+{
+    m_awaitingModelFrame = m_scene->loadParsed(m_loadWatcher->result());
+    m_viewer->update();
+}
+
+void MainWindow::onFrameSwapped()
+{
+    if (!m_firstFrameLogged && m_startupTimer.isValid()) {
+        m_firstFrameLogged = true;
+        qInfo() << "First frame" << m_startupTimer.elapsed() << "ms after launch";
+    }
+    
+    if (m_awaitingModelFrame) {
+        m_awaitingModelFrame = false;
+        qInfo().noquote() << QString("%1 on screen %2 ms after opening")
+                                 .arg(QFileInfo(m_scene->currentFile()).fileName())
+                                 .arg(m_openTimer.elapsed());
+        if (m_startupTimer.isValid()) {
+            qInfo() << "Model visible" << m_startupTimer.elapsed() << "ms after launch";
+            m_startupTimer.invalidate();
+        }
     }
 }
 
 void MainWindow::resetView()
 {
-    if (m_viewer) {
-        m_viewer->resetView();
+    for (STLViewer* viewer : std::as_const(m_viewers)) {
+        viewer->resetView();
+    }
+}
+
+void MainWindow::setFourViewports(bool enabled)
+{
+    // The perspective viewport is always shown; the others share its scene,
+    // so showing them costs no extra uploads
+    for (STLViewer* viewer : std::as_const(m_viewers)) {
+        if (viewer != m_viewer) {
+            viewer->setVisible(enabled);
+        }
+    }
+}
+
+void MainWindow::setLinkCameras(bool enabled)
+{
+    m_linkCameras = enabled;
+    if (enabled) {
+        onCameraChanged(m_viewer, m_viewer->camera());
+    }
+}
+
+void MainWindow::onCameraChanged(STLViewer* source, const ViewCamera& camera)
+{
+    if (!m_linkCameras) return;
+    
+    // setCamera() does not re-emit. Only the source repaints with every
+    // move; the others take the camera now but draw it on a throttle timer,
+    // so a drag over four viewports costs about one full draw per frame.
+    for (STLViewer* viewer : std::as_const(m_viewers)) {
+        if (viewer != source) {
+            viewer->setCamera(camera, false);
+        }
+    }
+    m_cameraSource = source;
+    if (!m_linkedRepaintTimer->isActive()) {
+        m_linkedRepaintTimer->start();
+    }
+}
+
+void MainWindow::repaintLinkedViewers()
+{
+    for (STLViewer* viewer : std::as_const(m_viewers)) {
+        if (viewer != m_cameraSource && viewer->isVisible()) {
+            viewer->update();
+        }
+    }
+}
+
+void MainWindow::compareMeshes()
+{
+    QString referenceFile = QFileDialog::getOpenFileName(
+        this,
+        "Open Reference STL",
+        "",
+        "STL Files (*.stl);;All Files (*)"
+    );
+    if (referenceFile.isEmpty()) return;
+    
+    QString testFile = QFileDialog::getOpenFileName(
+        this,
+        "Open Test STL",
+        QFileInfo(referenceFile).absolutePath(),
+        "STL Files (*.stl);;All Files (*)"
+    );
+    if (testFile.isEmpty()) return;
+    
+    m_statusLabel->setText("Comparing meshes...");
+    m_progressBar->setVisible(true);
+    m_progressBar->setRange(0, 0);
+    
+    // Parsing and measuring both stay off the GUI thread, like a normal load
+    m_compareWatcher->setFuture(QtConcurrent::run(&compareFiles, referenceFile, testFile));
+}
+
+void MainWindow::onCompareFinished()
+{
+    Comparison comparison = m_compareWatcher->result();
+    if (!comparison.error.isEmpty()) {
+        onLoadError(comparison.error);
+        return;
+    }
+    const QString referenceName = QFileInfo(comparison.referenceFile).fileName();
+    const QString testName = QFileInfo(comparison.test.filename).fileName();
+    const DeviationResult& result = comparison.result;
+    
+    // The test mesh is the one displayed, colored by its deviation
+    if (!m_scene->loadParsed(std::move(comparison.test))) return;
+    m_scene->setVertexScalars(result.cornerDistances, result.maxAbsDistance);
+    
+    m_deviationPanel->setResult(referenceName, testName, result);
+    m_deviationDock->setVisible(true);
+    
+    m_progressBar->setVisible(false);
+    m_statusLabel->setText(QString("Deviation: max %1, RMS %2 (%3 ms)")
+                          .arg(result.maxAbsDistance, 0, 'g', 4)
+                          .arg(result.rmsDistance, 0, 'g', 4)
+                          .arg(result.elapsedMs));
+}
+
+void MainWindow::checkInterference()
+{
+    const QStringList files = QFileDialog::getOpenFileNames(
+        this,
+        "Open Assembly Parts",
+        "",
+        "STL Files (*.stl);;All Files (*)"
+    );
+    if (files.isEmpty()) return;
+    if (files.size() < 2) {
+        QMessageBox::warning(this, "Check Interference",
+            "Choose two or more parts to check against each other.");
+        return;
+    }
+    
+    m_statusLabel->setText("Checking interference...");
+    m_progressBar->setVisible(true);
+    m_progressBar->setRange(0, 0);
+    
+    m_interferenceWatcher->setFuture(QtConcurrent::run(&checkParts, files));
+}
+
+void MainWindow::onInterferenceChecked()
+{
+    InterferenceCheck check = m_interferenceWatcher->result();
+    if (!check.error.isEmpty()) {
+        onLoadError(check.error);
+        return;
+    }
+    const QStringList& files = check.files;
+    const QVector<qsizetype>& firstFacet = check.firstFacet;
+    const InterferenceResult& result = check.result;
+    const qsizetype facetCount = check.assembly.triangles.size();
+    if (!m_scene->loadParsed(std::move(check.assembly))) return;
+    
+    // Crossing facets and whole nested parts in red; without any, the
+    // closest facets of the tightest pair in orange
+    const quint16 red = STLLoader::packFacetColor(31, 0, 0);
+    QVector<quint16> overlay(facetCount, 0);
+    bool anyIntersection = false;
+    for (qsizetype part = 0; part < result.intersectingFacets.size(); ++part) {
+        for (quint32 facet : result.intersectingFacets[part]) {
+            overlay[firstFacet[part] + facet] = red;
+            anyIntersection = true;
+        }
+    }
+    QString summary;
+    const PartClearance* tightest = nullptr;
+    for (const PartClearance& pair : result.pairs) {
+        const QString nameA = QFileInfo(files[pair.partA]).fileName();
+        const QString nameB = QFileInfo(files[pair.partB]).fileName();
+        if (pair.enclosedPart >= 0) {
+            const int inner = pair.enclosedPart;
+            for (qsizetype facet = firstFacet[inner]; facet < firstFacet[inner + 1]; ++facet) {
+                overlay[facet] = red;
+            }
+            anyIntersection = true;
+            summary += inner == pair.partA
+                ? QString("%1 lies inside %2\n").arg(nameA, nameB)
+                : QString("%1 lies inside %2\n").arg(nameB, nameA);
+        } else {
+            summary += QString("%1 / %2: ").arg(nameA, nameB);
+            summary += pair.intersects()
+                ? QString("%1 crossing facet pairs\n").arg(pair.intersectingPairs)
+                : QString("clearance %1\n").arg(pair.distance, 0, 'g', 4);
+        }
+        if (!tightest || pair.distance < tightest->distance) {
+            tightest = &pair;
+        }
+    }
+    if (!anyIntersection && tightest) {
+        const quint16 orange = STLLoader::packFacetColor(31, 16, 0);
+        overlay[firstFacet[tightest->partA] + tightest->facetA] = orange;
+        overlay[firstFacet[tightest->partB] + tightest->facetB] = orange;
+    }
+    setAnalysisOverlay(OverlayOwner::Interference, overlay);
+    
+    m_progressBar->setVisible(false);
+    m_statusLabel->setText(anyIntersection
+        ? QString("Interference: parts intersect (%1 ms)").arg(result.elapsedMs)
+        : QString("Interference: none, minimum clearance %1 (%2 ms)")
+              .arg(result.minDistance, 0, 'g', 4).arg(result.elapsedMs));
+    QMessageBox::information(this, "Check Interference", summary.trimmed());
+}
+
+void MainWindow::setAnalysisOverlay(OverlayOwner owner, const QVector<quint16>& colors)
+{
+    // The overlay holds one analysis at a time; the one it replaces loses
+    // its dock so no stale results stay on screen. Deviation colors are
+    // drawn over any overlay, so they go too.
+    if (owner != m_overlayOwner) {
+        switch (m_overlayOwner) {
+        case OverlayOwner::Components:
+            // Hidden components could not be shown again without the panel
+            m_scene->clearComponents();
+            m_pickTree = TriangleBVH();
+            m_componentPanel->clear();
+            m_componentDock->setVisible(false);
+            break;
+        case OverlayOwner::Overhangs:
+            m_overhangDock->setVisible(false);
+            break;
+        case OverlayOwner::None:
+        case OverlayOwner::ThinWalls:
+        case OverlayOwner::Interference:
+            break;
+        }
+        m_scene->clearVertexScalars();
+        m_deviationDock->setVisible(false);
+        m_overlayOwner = owner;
+    }
+    m_scene->setFacetOverlay(colors);
+}
+
+void MainWindow::clearAnalysis()
+{
+    m_overlayOwner = OverlayOwner::None;
+    m_scene->clearVertexScalars();
+    m_scene->clearFacetOverlay();
+    m_scene->clearComponents();
+    m_pickTree = TriangleBVH();
+    m_scene->clearVoxelSurface();
+    m_scene->clearShapeSurface();
+    m_hullSurface = ShapeSurface();
+    m_showVoxelsAction->setChecked(false);
+    m_showVoxelsAction->setEnabled(false);
+    m_componentPanel->clear();
+    m_orientationPanel->clear();
+    m_deviationDock->setVisible(false);
+    m_componentDock->setVisible(false);
+    m_overhangDock->setVisible(false);
+    m_orientationDock->setVisible(false);
+}
+
+void MainWindow::findComponents()
+{
+    if (!m_scene->isLoaded()) return;
+    if (m_scene->triangles().isEmpty()) {
+        QMessageBox::warning(this, "Find Components",
+            "The model geometry is not available on the CPU.\n"
+            "Choose a memory mode other than GPU Resident and reload the model.");
+        return;
+    }
+    
+    m_statusLabel->setText("Finding components...");
+    
+    // The worker keeps its own reference to the triangles, so a reload
+    // cannot pull them away mid-search
+    m_componentWatcher->setFuture(QtConcurrent::run(&searchComponents, m_scene->triangles()));
+}
+
+void MainWindow::onComponentsFound()
+{
+    // Canceled when another model was loaded meanwhile
+    if (m_componentWatcher->isCanceled()) return;
+    
+    ComponentSearch search = m_componentWatcher->result();
+    const Segmentation& segmentation = search.segmentation;
+    m_pickTree = std::move(search.pickTree);
+    m_scene->setComponents(segmentation);
+    m_componentPanel->setSegmentation(segmentation);
+    onComponentColorsChanged();
+    m_componentDock->setVisible(true);
+    
+    m_statusLabel->setText(QString("%1 components (%2 ms)")
+                          .arg(segmentation.components.size())
+                          .arg(segmentation.elapsedMs));
+}
+
+void MainWindow::onPickRequested(const QVector3D& origin, const QVector3D& direction)
+{
+    const QVector<quint32>& facetComponent = m_scene->segmentation().facetComponent;
+    if (m_pickTree.isEmpty() || facetComponent.isEmpty()) return;
+    
+    // Hidden components are not drawn, so the ray passes through them
+    const QVector<bool> visible = m_componentPanel->visibility();
+    const TriangleBVH::RayHit hit = m_pickTree.raycast(origin, direction, [&](quint32 facet) {
+        return visible.value(facetComponent[facet], false);
+    });
+    m_componentPanel->selectComponent(hit.isValid() ? int(facetComponent[hit.facet]) : -1);
+}
+
+void MainWindow::onComponentVisibilityChanged()
+{
+    m_scene->setComponentsVisible(m_componentPanel->visibility());
+}
+
+void MainWindow::onComponentColorsChanged()
+{
+    const Segmentation& segmentation = m_scene->segmentation();
+    if (segmentation.components.isEmpty()) return;
+    
+    // Expand the per-component colors to the per-facet overlay
+    const QVector<quint16> componentColors = m_componentPanel->componentColors();
+    const qsizetype facetCount = segmentation.facetComponent.size();
+    QVector<quint16> overlay(facetCount);
+    parallelFor(facetCount, 65536, [&](qsizetype begin, qsizetype end) {
+        for (qsizetype f = begin; f < end; ++f) {
+            overlay[f] = componentColors[segmentation.facetComponent[f]];
+        }
+    });
+    setAnalysisOverlay(OverlayOwner::Components, overlay);
+}
+
+void MainWindow::analyzeOverhangs()
+{
+    if (!m_scene->isLoaded()) return;
+    
+    if (m_overhang.isEmpty()) {
+        if (m_scene->triangles().isEmpty()) {
+            QMessageBox::warning(this, "Overhangs",
+                "The model geometry is not available on the CPU.\n"
+                "Choose a memory mode other than GPU Resident and reload the model.");
+            return;
+        }
+        m_overhang.setMesh(m_scene->triangles());
+    }
+    
+    m_overhangDock->setVisible(true);
+    updateOverhangs();
+}
+
+void MainWindow::updateOverhangs()
+{
+    if (m_overhang.isEmpty() || !m_overhangDock->isVisible()) return;
+    
+    // Only the per-facet overlay is uploaded; the geometry stays as it is
+    const OverhangResult result = m_overhang.classify(m_overhangPanel->buildDirection(),
+                                                      m_overhangPanel->criticalAngle());
+    setAnalysisOverlay(OverlayOwner::Overhangs, result.facetColors);
+    m_overhangPanel->setResult(result);
+    
+    m_statusLabel->setText(QString("Overhang area %1 (%2 ms)")
+                          .arg(result.overhangArea, 0, 'g', 5)
+                          .arg(result.elapsedMs, 0, 'f', 1));
+}
+
+void MainWindow::voxelize()
+{
+    if (!m_scene->isLoaded()) return;
+    if (m_scene->triangles().isEmpty()) {
+        QMessageBox::warning(this, "Voxelize",
+            "The model geometry is not available on the CPU.\n"
+            "Choose a memory mode other than GPU Resident and reload the model.");
+        return;
+    }
+    
+    bool ok = false;
+    const int resolution = QInputDialog::getInt(this, "Voxelize",
+                                                "Voxels along the longest side:",
+                                                512, 16, 1024, 1, &ok);
+    if (!ok) return;
+    const double minWall = QInputDialog::getDouble(this, "Voxelize",
+                                                   "Minimum wall thickness (model units):",
+                                                   1.0, 0.0, 1e6, 3, &ok);
+    if (!ok) return;
+    
+    m_statusLabel->setText("Voxelizing...");
+    m_progressBar->setVisible(true);
+    m_progressBar->setRange(0, 0);
+    
+    m_voxelWatcher->setFuture(QtConcurrent::run(&voxelizeModel, m_scene->triangles(), resolution,
+                                                float(minWall)));
+}
+
+void MainWindow::onVoxelized()
+{
+    // Canceled when another model was loaded meanwhile
+    if (m_voxelWatcher->isCanceled()) return;
+    
+    // Taken rather than copied, so the grids are freed once shown
+    const Voxelization voxelization = m_voxelWatcher->future().takeResult();
+    const VoxelizationResult& result = voxelization.result;
+    if (result.solid.isEmpty()) {
+        m_progressBar->setVisible(false);
+        m_statusLabel->setText("Voxelize: the model has no extent");
+        return;
+    }
+    
+    setAnalysisOverlay(OverlayOwner::ThinWalls, voxelization.thinWallColors);
+    m_scene->setVoxelSurface(voxelization.surface);
+    m_showVoxelsAction->setEnabled(true);
+    m_showVoxelsAction->setChecked(true);
+    
+    const QLocale locale;
+    m_progressBar->setVisible(false);
+    m_statusLabel->setText(QString("Voxel volume %1 (%2 ms)")
+                          .arg(result.volume, 0, 'g', 6).arg(result.elapsedMs));
+    QMessageBox::information(this, "Voxelize",
+        QString("Grid: %1 x %2 x %3 voxels of %4\n"
+                "Volume: %5\n"
+                "Surface voxels: %6\n"
+                "Solid voxels: %7\n"
+                "Thin-wall voxels (under %8): %9\n"
+                "Grid memory: %10\n"
+                "Time: %11 ms")
+            .arg(result.solid.sizeX()).arg(result.solid.sizeY()).arg(result.solid.sizeZ())
+            .arg(result.voxelSize, 0, 'g', 4)
+            .arg(result.volume, 0, 'g', 6)
+            .arg(result.surfaceVoxels)
+            .arg(result.solidVoxels)
+            .arg(voxelization.minWall, 0, 'g', 4)
+            .arg(result.thinVoxels)
+            .arg(locale.formattedDataSize(result.solid.memoryBytes() + result.thinWalls.memoryBytes()))
+            .arg(result.elapsedMs));
+}
+
+void MainWindow::optimizeOrientation()
+{
+    if (!m_scene->isLoaded()) return;
+    if (m_scene->triangles().isEmpty()) {
+        QMessageBox::warning(this, "Optimize Orientation",
+            "The model geometry is not available on the CPU.\n"
+            "Choose a memory mode other than GPU Resident and reload the model.");
+        return;
+    }
+    
+    m_statusLabel->setText("Searching build orientations...");
+    m_progressBar->setVisible(true);
+    m_progressBar->setRange(0, 0);
+    
+    m_orientationWatcher->setFuture(QtConcurrent::run(&searchOrientations, m_scene->triangles(),
+                                                      m_overhangPanel->criticalAngle()));
+}
+
+void MainWindow::onOrientationsFound()
+{
+    // Canceled when another model was loaded meanwhile
+    if (m_orientationWatcher->isCanceled()) return;
+    
+    const OrientationSearch search = m_orientationWatcher->result();
+    const OrientationResult& result = search.result;
+    m_progressBar->setVisible(false);
+    if (result.candidates.isEmpty()) {
+        m_statusLabel->setText("Optimize Orientation: the model is flat");
+        return;
+    }
+    
+    m_hullSurface = search.hullSurface;
+    ShapeSurface shapes = m_hullSurface;
+    shapes.append(search.boxSurface);
+    m_scene->setShapeSurface(shapes);
+    
+    m_orientationPanel->setResult(result);
+    m_orientationDock->setVisible(true);
+    m_statusLabel->setText(QString("%1 orientations searched (%2 ms)")
+                          .arg(result.evaluated).arg(result.elapsedMs));
+}
+
+void MainWindow::onOrientationSelected(const OrientationCandidate& candidate)
+{
+    ShapeSurface shapes = m_hullSurface;
+    shapes.append(MeshHull::surface(candidate.box, STLLoader::packFacetColor(31, 16, 0)));
+    m_scene->setShapeSurface(shapes);
+    
+    // The overhang view colors the supports and plate contact for the choice
+    m_overhangPanel->setBuildDirection(candidate.up);
+    if (!m_overhangDock->isVisible()) {
+        analyzeOverhangs();
     }
 }
 
@@ -143,7 +1057,8 @@ void MainWindow::showAbout()
         "Controls:\n"
         "• Left click + drag: Rotate model\n"
         "• Mouse wheel: Zoom in/out\n"
-        "• Ctrl+R: Reset view");
+        "• Ctrl+R: Reset view\n"
+        "• Ctrl+4: Toggle top/front/side viewports");
 }
 
 void MainWindow::onModelLoaded(const QString& filename, int triangleCount)
@@ -153,6 +1068,24 @@ void MainWindow::onModelLoaded(const QString& filename, int triangleCount)
                           .arg(QFileInfo(filename).fileName())
                           .arg(triangleCount));
     m_resetButton->setEnabled(true);
+    
+    // The scene drops analysis results with the old geometry
+    m_overlayOwner = OverlayOwner::None;
+    m_deviationDock->setVisible(false);
+    m_componentWatcher->cancel();
+    m_voxelWatcher->cancel();
+    m_orientationWatcher->cancel();
+    m_pickTree = TriangleBVH();
+    m_componentPanel->clear();
+    m_componentDock->setVisible(false);
+    m_overhang.clear();
+    m_overhangPanel->reset();
+    m_overhangDock->setVisible(false);
+    m_orientationPanel->clear();
+    m_orientationDock->setVisible(false);
+    m_hullSurface = ShapeSurface();
+    m_showVoxelsAction->setChecked(false);
+    m_showVoxelsAction->setEnabled(false);
 }
 
 void MainWindow::onLoadError(const QString& error)
@@ -163,3 +1096,31 @@ void MainWindow::onLoadError(const QString& error)
     QMessageBox::critical(this, "Load Error", 
         QString("Failed to load STL file:\n%1").arg(error));
 }
+
+void MainWindow::onMemoryUsageChanged()
+{
+    const MemoryUsage usage = m_scene->memoryUsage();
+    const QLocale locale;
+    
+    m_memoryLabel->setText(QString("CPU: %1 | GPU: %2")
+                          .arg(locale.formattedDataSize(usage.cpuTotal()))
+                          .arg(locale.formattedDataSize(usage.gpuTotal())));
+    m_memoryLabel->setToolTip(QString("Triangles: %1\nVertices: %2\nNormals: %3\nFacet colors: %4\n"
+                                      "Components: %5\nGPU vertices: %6\nGPU normals: %7\n"
+                                      "GPU scalars: %8\nGPU facet colors: %9")
+                             .arg(locale.formattedDataSize(usage.triangles),
+                                  locale.formattedDataSize(usage.vertices),
+                                  locale.formattedDataSize(usage.normals),
+                                  locale.formattedDataSize(usage.facetColors),
+                                  locale.formattedDataSize(usage.components),
+                                  locale.formattedDataSize(usage.gpuVertices),
+                                  locale.formattedDataSize(usage.gpuNormals),
+                                  locale.formattedDataSize(usage.gpuScalars),
+                                  locale.formattedDataSize(usage.gpuFacetColors))
+                             + QString("\nGPU overlay: %1\nGPU indices: %2\nGPU voxels: %3\n"
+                                       "GPU shapes: %4")
+                             .arg(locale.formattedDataSize(usage.gpuOverlay),
+                                  locale.formattedDataSize(usage.gpuIndices),
+                                  locale.formattedDataSize(usage.gpuVoxels),
+                                  locale.formattedDataSize(usage.gpuShapes)));
+}
@@ -0,0 +1,204 @@
+#include "meshdeviation.h"
+#include "meshwelder.h"
+#include "trianglebvh.h"
+#include "stlviewer.h"
+#include "parallelfor.h"
+#include <QElapsedTimer>
+#include <QDebug>
+#include <QtMath>
+#include <QPair>
+#include <algorithm>
+
+namespace {
+// Facets whose corner angle has a smaller sine than 1e-6 count as degenerate
+const float kMinSineSquared = 1e-12f;
+
+// Reference facets per chunk of the sliver filter
+const qsizetype kFilterGrain = 65536;
+
+// Angle-weighted pseudo-normals of the welded reference (Baerentzen and
+// Aanaes). The sign of p - q against the pseudo-normal of the feature q lies
+// on is correct on edges and corners too, where a single facet normal is not.
+struct PseudoNormals {
+    QVector<QVector3D> faces;    // one per facet
+    QVector<QVector3D> edges;    // three per facet, edge k from corner k to k + 1
+    QVector<QVector3D> vertices; // one per welded position
+    QVector<quint32> corners;    // welded position of each facet corner
+    
+    QVector3D at(const TriangleBVH::NearestHit& hit) const
+    {
+        switch (hit.feature) {
+        case TriangleBVH::Feature::Vertex:
+            return vertices[corners[3 * hit.facet + hit.featureIndex]];
+        case TriangleBVH::Feature::Edge:
+            return edges[3 * hit.facet + hit.featureIndex];
+        case TriangleBVH::Feature::Face:
+            break;
+        }
+        return faces[hit.facet];
+    }
+};
+
+PseudoNormals pseudoNormals(const QVector<Triangle>& surface)
+{
+    WeldedMesh welded = MeshWelder::weld(surface);
+    const qsizetype facetCount = surface.size();
+    
+    PseudoNormals normals;
+    normals.faces.resize(facetCount);
+    normals.edges.resize(3 * facetCount);
+    normals.vertices.fill(QVector3D(), welded.positions.size());
+    normals.corners = std::move(welded.indices);
+    
+    parallelFor(facetCount, 65536, [&](qsizetype begin, qsizetype end) {
+        for (qsizetype f = begin; f < end; ++f) {
+            const Triangle& t = surface[f];
+            normals.faces[f] = QVector3D::crossProduct(t.vertex2 - t.vertex1,
+                                                       t.vertex3 - t.vertex1).normalized();
+        }
+    });
+    
+    // Each corner adds its facet normal weighted by the corner angle; each
+    // edge adds the normals of the facets on both sides, found by sorting
+    // the edges on their welded end points. Only the scatter into shared
+    // vertices runs on one thread.
+    QVector<float> cornerAngles(3 * facetCount);
+    QVector<QPair<quint64, quint32>> edgeKeys(3 * facetCount);
+    parallelFor(facetCount, 65536, [&](qsizetype begin, qsizetype end) {
+        for (qsizetype f = begin; f < end; ++f) {
+            const Triangle& t = surface[f];
+            const QVector3D corners[3] = {t.vertex1, t.vertex2, t.vertex3};
+            for (int k = 0; k < 3; ++k) {
+                const QVector3D toNext = (corners[(k + 1) % 3] - corners[k]).normalized();
+                const QVector3D toPrevious = (corners[(k + 2) % 3] - corners[k]).normalized();
+                cornerAngles[3 * f + k] = qAcos(qBound(-1.0f, QVector3D::dotProduct(toNext, toPrevious), 1.0f));
+                
+                const quint32 from = normals.corners[3 * f + k];
+                const quint32 to = normals.corners[3 * f + (k + 1) % 3];
+                edgeKeys[3 * f + k] = qMakePair(quint64(qMin(from, to)) << 32 | qMax(from, to),
+                                                quint32(3 * f + k));
+            }
+        }
+    });
+    for (qsizetype corner = 0; corner < cornerAngles.size(); ++corner) {
+        normals.vertices[normals.corners[corner]] += cornerAngles[corner] * normals.faces[corner / 3];
+    }
+    parallelSort(edgeKeys.begin(), edgeKeys.end(), 1 << 18);
+    for (qsizetype i = 0; i < edgeKeys.size();) {
+        qsizetype j = i;
+        QVector3D sum;
+        for (; j < edgeKeys.size() && edgeKeys[j].first == edgeKeys[i].first; ++j) {
+            sum += normals.faces[edgeKeys[j].second / 3];
+        }
+        for (; i < j; ++i) {
+            normals.edges[edgeKeys[i].second] = sum;
+        }
+    }
+    return normals;
+}
+}
+
+DeviationResult MeshDeviation::compute(const QVector<Triangle>& reference,
+                                       const QVector<Triangle>& test,
+                                       int histogramBins)
+{
+    DeviationResult result;
+    if (reference.isEmpty() || test.isEmpty()) return result;
+    
+    QElapsedTimer timer;
+    timer.start();
+    
+    // Degenerate slivers add no surface but their normals would give the
+    // distance an arbitrary sign. Each chunk counts its keepers, then copies
+    // them to its offset.
+    const qsizetype referenceCount = reference.size();
+    const qsizetype chunkCount = (referenceCount + kFilterGrain - 1) / kFilterGrain;
+    QVector<char> keep(referenceCount);
+    QVector<qsizetype> chunkOffsets(chunkCount + 1, 0);
+    parallelFor(referenceCount, kFilterGrain, [&](qsizetype begin, qsizetype end) {
+        qsizetype kept = 0;
+        for (qsizetype f = begin; f < end; ++f) {
+            const Triangle& facet = reference[f];
+            const QVector3D edge1 = facet.vertex2 - facet.vertex1;
+            const QVector3D edge2 = facet.vertex3 - facet.vertex1;
+            const float sine2 = QVector3D::crossProduct(edge1, edge2).lengthSquared()
+                                / (edge1.lengthSquared() * edge2.lengthSquared());
+            keep[f] = sine2 > kMinSineSquared;
+            kept += keep[f];
+        }
+        chunkOffsets[begin / kFilterGrain + 1] = kept;
+    });
+    for (qsizetype c = 0; c < chunkCount; ++c) {
+        chunkOffsets[c + 1] += chunkOffsets[c];
+    }
+    if (chunkOffsets.last() == 0) return result;
+    QVector<Triangle> surface(chunkOffsets.last());
+    parallelFor(referenceCount, kFilterGrain, [&](qsizetype begin, qsizetype end) {
+        qsizetype out = chunkOffsets[begin / kFilterGrain];
+        for (qsizetype f = begin; f < end; ++f) {
+            if (keep[f]) surface[out++] = reference[f];
+        }
+    });
+    
+    // Shared corners are queried once instead of once per facet
+    const WeldedMesh welded = MeshWelder::weld(test);
+    const TriangleBVH bvh(surface);
+    const PseudoNormals normals = pseudoNormals(surface);
+    
+    const qsizetype vertexCount = welded.positions.size();
+    QVector<float> distances(vertexCount);
+    
+    parallelFor(vertexCount, 4096, [&](qsizetype begin, qsizetype end) {
+        for (qsizetype i = begin; i < end; ++i) {
+            const QVector3D& p = welded.positions[i];
+            const TriangleBVH::NearestHit hit = bvh.nearest(p);
+            
+            const float distance = qSqrt(hit.distanceSquared);
+            distances[i] = QVector3D::dotProduct(p - hit.point, normals.at(hit)) < 0.0f
+                         ? -distance : distance;
+        }
+    });
+    
+    // Statistics
+    double sum = 0.0;
+    double sumSquares = 0.0;
+    result.minDistance = distances[0];
+    result.maxDistance = distances[0];
+    for (float d : distances) {
+        result.minDistance = qMin(result.minDistance, d);
+        result.maxDistance = qMax(result.maxDistance, d);
+        sum += d;
+        sumSquares += double(d) * d;
+    }
+    result.vertexCount = vertexCount;
+    result.maxAbsDistance = qMax(qAbs(result.minDistance), qAbs(result.maxDistance));
+    result.meanDistance = float(sum / vertexCount);
+    result.rmsDistance = float(qSqrt(sumSquares / vertexCount));
+    
+    result.histogram.fill(0, qMax(histogramBins, 1));
+    const float range = result.maxAbsDistance;
+    for (float d : distances) {
+        int bin = result.histogram.size() / 2;
+        if (range > 0.0f) {
+            bin = int((d + range) / (2.0f * range) * result.histogram.size());
+            bin = qBound(0, bin, int(result.histogram.size()) - 1);
+        }
+        ++result.histogram[bin];
+    }
+    
+    result.cornerDistances.resize(welded.indices.size());
+    for (qsizetype i = 0; i < welded.indices.size(); ++i) {
+        result.cornerDistances[i] = distances[welded.indices[i]];
+    }
+    
+    result.elapsedMs = timer.elapsed();
+    qInfo().noquote() << QString("Deviation: %1 reference facets, %2 test vertices in %3 ms "
+                                 "(max %4, RMS %5)")
+        .arg(reference.size())
+        .arg(vertexCount)
+        .arg(result.elapsedMs)
+        .arg(result.maxAbsDistance)
+        .arg(result.rmsDistance);
+    
+    return result;
+}
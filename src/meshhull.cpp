@@ -0,0 +1,1278 @@
+#include "meshhull.h"
+#include "parallelfor.h"
+#include <QElapsedTimer>
+#include <QThreadPool>
+#include <QDebug>
+#include <QtMath>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <utility>
+
+namespace {
+
+const qsizetype kGrain = 65536;
+
+// Below this many points per chunk the merge costs more than it saves
+const qsizetype kMinChunkPoints = 65536;
+
+// Chunk hulls only pay off when they drop most of their points; when the
+// Akl-Toussaint filter keeps more than this share, most points are on the
+// hull and the chunks would hand nearly all of them on
+const double kMaxChunkedShare = 0.5;
+
+// Points orphaned by one insertion are reassigned in parallel from this many
+const qsizetype kParallelOrphans = 8192;
+const qsizetype kOrphanGrain = 2048;
+
+// Points are snapped to a grid of 2^20 steps along the longest side of their
+// bounds. Plane normals then fit in 42 bits and every side-of-plane test is
+// exact in 64-bit integers, so near-coplanar input cannot fold the hull.
+const int kGridBits = 20;
+
+// Simplified hull used for the box and direction searches
+const int kSearchCells = 32;
+const int kSearchVertices = 4096;
+const int kBoxDirections = 512;
+// Edge directions tried as box axes, and pairwise as the normal of a box
+// face parallel to both edges
+const int kBoxEdges = 24;
+// Best directions on the simplified hull that are measured again on the full one
+const int kBoxRefined = 8;
+// The winning box is then turned while that shrinks it: by steps of 1 down
+// to 0.05 degrees and up to 3 degrees in all on the simplified hull, then by
+// 0.2 down to 0.01 and up to 0.6 degrees on the full one
+const double kCoarseTurn[3] = {1.0, 0.05, 3.0};
+const double kFineTurn[3] = {0.2, 0.01, 0.6};
+
+// Cube-map cells per face side for grouping face normals, about 1.4 degrees
+const int kDirectionCells = 64;
+
+// Hulls drawn in the viewer are simplified to this grid beyond
+// kSearchVertices vertices, which keeps their GPU copy to a few megabytes
+const int kDisplayCells = 64;
+
+struct Vec3d {
+    double x, y, z;
+};
+
+Vec3d toDouble(const QVector3D& p)
+{
+    return {p.x(), p.y(), p.z()};
+}
+
+Vec3d sub(const Vec3d& a, const Vec3d& b)
+{
+    return {a.x - b.x, a.y - b.y, a.z - b.z};
+}
+
+Vec3d cross(const Vec3d& a, const Vec3d& b)
+{
+    return {a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x};
+}
+
+double dot(const Vec3d& a, const Vec3d& b)
+{
+    return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+struct GridPoint {
+    qint64 x, y, z;
+};
+
+GridPoint sub(const GridPoint& a, const GridPoint& b)
+{
+    return {a.x - b.x, a.y - b.y, a.z - b.z};
+}
+
+GridPoint cross(const GridPoint& a, const GridPoint& b)
+{
+    return {a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x};
+}
+
+qint64 dot(const GridPoint& a, const GridPoint& b)
+{
+    return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+// Empty when the points are all the same
+QVector<GridPoint> snapToGrid(const QVector<QVector3D>& points)
+{
+    const qsizetype count = points.size();
+    const qsizetype chunkCount = (count + kGrain - 1) / kGrain;
+    QVector<QVector3D> chunkLow(chunkCount);
+    QVector<QVector3D> chunkHigh(chunkCount);
+    parallelFor(count, kGrain, [&](qsizetype begin, qsizetype end) {
+        QVector3D low = points[begin];
+        QVector3D high = low;
+        for (qsizetype i = begin + 1; i < end; ++i) {
+            for (int axis = 0; axis < 3; ++axis) {
+                low[axis] = qMin(low[axis], points[i][axis]);
+                high[axis] = qMax(high[axis], points[i][axis]);
+            }
+        }
+        chunkLow[begin / kGrain] = low;
+        chunkHigh[begin / kGrain] = high;
+    });
+    if (chunkCount == 0) return QVector<GridPoint>();
+    Vec3d low = toDouble(chunkLow[0]);
+    Vec3d high = toDouble(chunkHigh[0]);
+    for (qsizetype c = 1; c < chunkCount; ++c) {
+        low = {qMin(low.x, double(chunkLow[c].x())), qMin(low.y, double(chunkLow[c].y())),
+               qMin(low.z, double(chunkLow[c].z()))};
+        high = {qMax(high.x, double(chunkHigh[c].x())), qMax(high.y, double(chunkHigh[c].y())),
+                qMax(high.z, double(chunkHigh[c].z()))};
+    }
+    const double extent = qMax(high.x - low.x, qMax(high.y - low.y, high.z - low.z));
+    if (!(extent > 0.0)) return QVector<GridPoint>();
+
+    const double steps = double(qint64(1) << kGridBits);
+    const double scale = steps / extent;
+    auto snap = [&](double value, double origin) {
+        return qint64(qBound(0.0, std::floor((value - origin) * scale + 0.5), steps));
+    };
+    QVector<GridPoint> grid(count);
+    parallelFor(count, kGrain, [&](qsizetype begin, qsizetype end) {
+        for (qsizetype i = begin; i < end; ++i) {
+            grid[i] = GridPoint{snap(points[i].x(), low.x), snap(points[i].y(), low.y),
+                                snap(points[i].z(), low.z)};
+        }
+    });
+    return grid;
+}
+
+// Z-order of the grid cells. Points that are close in space then sit close
+// in memory, which roughly halves the time the hull spends on cache misses,
+// and consecutive ranges make compact chunks.
+void sortSpatially(const QVector<GridPoint>& grid, QVector<int>& indices)
+{
+    auto spread = [](qint64 value) {
+        quint64 x = quint64(value) & 0x1fffff;
+        x = (x | x << 32) & 0x1f00000000ffffULL;
+        x = (x | x << 16) & 0x1f0000ff0000ffULL;
+        x = (x | x << 8) & 0x100f00f00f00f00fULL;
+        x = (x | x << 4) & 0x10c30c30c30c30c3ULL;
+        x = (x | x << 2) & 0x1249249249249249ULL;
+        return x;
+    };
+    QVector<QPair<quint64, int>> keyed(indices.size());
+    parallelFor(indices.size(), kGrain, [&](qsizetype begin, qsizetype end) {
+        for (qsizetype i = begin; i < end; ++i) {
+            const GridPoint& p = grid[indices[i]];
+            keyed[i] = qMakePair(spread(p.x) | spread(p.y) << 1 | spread(p.z) << 2, indices[i]);
+        }
+    });
+    std::sort(keyed.begin(), keyed.end());
+    for (qsizetype i = 0; i < keyed.size(); ++i) {
+        indices[i] = keyed[i].second;
+    }
+}
+
+// Incremental quickhull over a half-edge mesh. Every point waits in the
+// conflict list of one face it is outside of; the furthest point of a face
+// is added by replacing the faces it sees with a fan from the horizon.
+// Points on a face plane count as inside, so coplanar faces stay split.
+class QuickHullBuilder
+{
+public:
+    explicit QuickHullBuilder(const QVector<GridPoint>& points)
+        : m_points(points)
+        , m_nextConflict(points.size(), -1)
+        , m_horizonStamp(points.size(), 0)
+        , m_horizonEdge(points.size(), 0)
+        , m_stamp(0)
+        , m_parallel(false)
+    {
+    }
+
+    // False when the points are coplanar
+    bool build(bool parallel);
+    bool isOutside(const GridPoint& point) const;
+    // 'coordinates' are the points before snapping, in the same order
+    ConvexHull hull(const QVector<QVector3D>& coordinates) const;
+    QVector<int> vertexIndices() const;
+
+private:
+    struct Edge {
+        int origin;
+        int next;
+        int twin;
+        int face;
+    };
+
+    struct Face {
+        GridPoint normal; // not normalized
+        GridPoint anchor; // a vertex of the face, copied to save a lookup
+        double inverseLength;
+        qint64 furthestHeight;
+        int conflicts;    // head of the conflict list, -1 when empty
+        int furthest;
+        int visited;      // +stamp when seen as visible, -stamp when not
+        bool alive;
+    };
+
+    // Distance above the face plane times the normal's length, exact
+    qint64 height(const Face& face, const GridPoint& point) const
+    {
+        return dot(face.normal, sub(point, face.anchor));
+    }
+
+    // Face f owns edges 3f .. 3f + 2, so recycling a face recycles its edges
+    int addFace(int a, int b, int c);
+    void addConflict(int face, int point, qint64 height);
+    bool addFurthest(int face, QVector<int>& pending);
+    // The face the point is furthest above, or -1 when it is above none
+    int bestFace(int point, const int* faces, int count, qint64& bestHeight) const;
+    void assignToBest(int point, const int* faces, int count);
+
+    const QVector<GridPoint>& m_points;
+    QVector<Edge> m_edges;
+    QVector<Face> m_faces;
+    QVector<int> m_freeFaces;
+    QVector<int> m_nextConflict;
+    QVector<int> m_horizonStamp;
+    QVector<int> m_horizonEdge;
+    int m_stamp;
+    bool m_parallel;
+
+    // Scratch space for addFurthest(), kept to avoid reallocating per point
+    struct HorizonEdge {
+        int from;
+        int to;
+        int twin;
+    };
+    QVector<int> m_visible;
+    QVector<int> m_horizon;
+    QVector<int> m_loop;
+    QVector<HorizonEdge> m_horizonEdges;
+    QVector<int> m_orphans;
+    QVector<int> m_orphanFaces;
+    QVector<qint64> m_orphanHeights;
+    QVector<int> m_fan;
+};
+
+int QuickHullBuilder::addFace(int a, int b, int c)
+{
+    int f;
+    if (!m_freeFaces.isEmpty()) {
+        f = m_freeFaces.takeLast();
+    } else {
+        f = int(m_faces.size());
+        m_faces.append(Face());
+        m_edges.resize(m_edges.size() + 3);
+    }
+
+    Face& face = m_faces[f];
+    face.normal = cross(sub(m_points[b], m_points[a]), sub(m_points[c], m_points[a]));
+    face.anchor = m_points[a];
+    const double length = std::sqrt(double(face.normal.x) * double(face.normal.x)
+                                     + double(face.normal.y) * double(face.normal.y)
+                                     + double(face.normal.z) * double(face.normal.z));
+    face.inverseLength = length > 0.0 ? 1.0 / length : 0.0;
+    face.furthestHeight = 0;
+    face.conflicts = -1;
+    face.furthest = -1;
+    face.visited = 0;
+    face.alive = true;
+
+    const int e = 3 * f;
+    m_edges[e] = Edge{a, e + 1, -1, f};
+    m_edges[e + 1] = Edge{b, e + 2, -1, f};
+    m_edges[e + 2] = Edge{c, e, -1, f};
+    return f;
+}
+
+void QuickHullBuilder::addConflict(int face, int point, qint64 height)
+{
+    Face& f = m_faces[face];
+    m_nextConflict[point] = f.conflicts;
+    f.conflicts = point;
+    if (f.furthest < 0 || height > f.furthestHeight) {
+        f.furthest = point;
+        f.furthestHeight = height;
+    }
+}
+
+int QuickHullBuilder::bestFace(int point, const int* faces, int count, qint64& bestHeight) const
+{
+    int best = -1;
+    bestHeight = 0;
+    double bestDistance = 0.0;
+    for (int i = 0; i < count; ++i) {
+        const Face& face = m_faces[faces[i]];
+        const qint64 h = height(face, m_points[point]);
+        if (h > 0 && double(h) * face.inverseLength > bestDistance) {
+            best = faces[i];
+            bestHeight = h;
+            bestDistance = double(h) * face.inverseLength;
+        }
+    }
+    return best;
+}
+
+void QuickHullBuilder::assignToBest(int point, const int* faces, int count)
+{
+    qint64 bestHeight = 0;
+    const int best = bestFace(point, faces, count, bestHeight);
+    // Points no face sees are inside the hull or on it
+    if (best >= 0) {
+        addConflict(best, point, bestHeight);
+    }
+}
+
+bool QuickHullBuilder::build(bool parallel)
+{
+    const int count = int(m_points.size());
+    if (count < 4) return false;
+    m_parallel = parallel;
+
+    // Initial tetrahedron: the most distant pair of axis extremes, the point
+    // furthest from their line and the point furthest from that plane
+    int extremes[6] = {0, 0, 0, 0, 0, 0};
+    auto coordinate = [&](int i, int axis) {
+        return axis == 0 ? m_points[i].x : (axis == 1 ? m_points[i].y : m_points[i].z);
+    };
+    for (int i = 1; i < count; ++i) {
+        for (int axis = 0; axis < 3; ++axis) {
+            if (coordinate(i, axis) < coordinate(extremes[2 * axis], axis)) extremes[2 * axis] = i;
+            if (coordinate(i, axis) > coordinate(extremes[2 * axis + 1], axis)) extremes[2 * axis + 1] = i;
+        }
+    }
+    int a = 0;
+    int b = 0;
+    qint64 widest = 0;
+    for (int axis = 0; axis < 3; ++axis) {
+        const GridPoint d = sub(m_points[extremes[2 * axis + 1]], m_points[extremes[2 * axis]]);
+        if (dot(d, d) > widest) {
+            widest = dot(d, d);
+            a = extremes[2 * axis];
+            b = extremes[2 * axis + 1];
+        }
+    }
+    if (widest == 0) return false;
+
+    const GridPoint ab = sub(m_points[b], m_points[a]);
+    int c = -1;
+    double furthest = 0.0;
+    for (int i = 0; i < count; ++i) {
+        const GridPoint n = cross(ab, sub(m_points[i], m_points[a]));
+        const double area = double(n.x) * double(n.x) + double(n.y) * double(n.y) + double(n.z) * double(n.z);
+        if (area > furthest) {
+            furthest = area;
+            c = i;
+        }
+    }
+    if (c < 0) return false;
+
+    const GridPoint normal = cross(ab, sub(m_points[c], m_points[a]));
+    int d = -1;
+    qint64 tallest = 0;
+    for (int i = 0; i < count; ++i) {
+        const qint64 h = qAbs(dot(normal, sub(m_points[i], m_points[a])));
+        if (h > tallest) {
+            tallest = h;
+            d = i;
+        }
+    }
+    if (d < 0) return false;
+
+    // Base wound so the apex is behind it
+    if (dot(normal, sub(m_points[d], m_points[a])) > 0) {
+        std::swap(b, c);
+    }
+    const int faces[4] = {addFace(a, b, c), addFace(b, a, d), addFace(c, b, d), addFace(a, c, d)};
+    for (int e = 0; e < 12; ++e) {
+        for (int o = 0; o < 12; ++o) {
+            if (m_edges[e].origin == m_edges[m_edges[o].next].origin
+                && m_edges[o].origin == m_edges[m_edges[e].next].origin) {
+                m_edges[e].twin = o;
+            }
+        }
+    }
+
+    // The first partition touches every point, so it is done in parallel
+    QVector<qint8> bestFace(count);
+    QVector<qint64> bestHeight(count);
+    auto classify = [&](qsizetype begin, qsizetype end) {
+        for (qsizetype i = begin; i < end; ++i) {
+            bestFace[i] = -1;
+            bestHeight[i] = 0;
+            double bestDistance = 0.0;
+            for (int f = 0; f < 4; ++f) {
+                const Face& face = m_faces[faces[f]];
+                const qint64 h = height(face, m_points[i]);
+                if (h > 0 && double(h) * face.inverseLength > bestDistance) {
+                    bestFace[i] = qint8(f);
+                    bestHeight[i] = h;
+                    bestDistance = double(h) * face.inverseLength;
+                }
+            }
+        }
+    };
+    if (parallel) {
+        parallelFor(count, kGrain, classify);
+    } else {
+        classify(0, count);
+    }
+    for (int i = 0; i < count; ++i) {
+        if (bestFace[i] >= 0) {
+            addConflict(faces[bestFace[i]], i, bestHeight[i]);
+        }
+    }
+
+    QVector<int> pending(faces, faces + 4);
+    while (!pending.isEmpty()) {
+        const int f = pending.takeLast();
+        while (m_faces[f].alive && m_faces[f].conflicts >= 0) {
+            if (addFurthest(f, pending)) break;
+        }
+    }
+    return true;
+}
+
+bool QuickHullBuilder::addFurthest(int start, QVector<int>& pending)
+{
+    // Returns true once 'start' has been replaced
+    const int eye = m_faces[start].furthest;
+    const GridPoint& eyePoint = m_points[eye];
+    ++m_stamp;
+
+    // Faces the eye sees, grown from the start face; their edges onto faces
+    // it does not see form the horizon
+    QVector<int>& visible = m_visible;
+    QVector<int>& horizon = m_horizon;
+    visible.clear();
+    horizon.clear();
+    visible.append(start);
+    m_faces[start].visited = m_stamp;
+    for (int v = 0; v < visible.size(); ++v) {
+        const int f = visible[v];
+        for (int e = 3 * f; e < 3 * f + 3; ++e) {
+            const int neighbor = m_edges[m_edges[e].twin].face;
+            Face& face = m_faces[neighbor];
+            if (face.visited == m_stamp) continue;
+            if (face.visited != -m_stamp && height(face, eyePoint) > 0) {
+                face.visited = m_stamp;
+                visible.append(neighbor);
+            } else {
+                face.visited = -m_stamp;
+                horizon.append(e);
+            }
+        }
+    }
+
+    // Chain the horizon into one loop. With exact tests the visible faces
+    // always form a disc; should that ever fail, the point is left out
+    // rather than corrupting the mesh.
+    bool closed = true;
+    for (int h = 0; h < horizon.size() && closed; ++h) {
+        const int origin = m_edges[horizon[h]].origin;
+        closed = m_horizonStamp[origin] != m_stamp;
+        m_horizonStamp[origin] = m_stamp;
+        m_horizonEdge[origin] = h;
+    }
+    QVector<int>& loop = m_loop;
+    loop.clear();
+    int h = 0;
+    while (closed && loop.size() < horizon.size()) {
+        loop.append(horizon[h]);
+        const int to = m_edges[m_edges[horizon[h]].next].origin;
+        if (m_horizonStamp[to] != m_stamp) {
+            closed = false;
+            break;
+        }
+        h = m_horizonEdge[to];
+        if (h == 0) break;
+    }
+    closed = closed && h == 0 && loop.size() == horizon.size();
+    if (!closed) {
+        Face& face = m_faces[start];
+        int* link = &face.conflicts;
+        while (*link != eye) {
+            link = &m_nextConflict[*link];
+        }
+        *link = m_nextConflict[eye];
+        face.furthest = -1;
+        face.furthestHeight = 0;
+        for (int p = face.conflicts; p >= 0; p = m_nextConflict[p]) {
+            const qint64 h = height(face, m_points[p]);
+            if (face.furthest < 0 || h > face.furthestHeight) {
+                face.furthest = p;
+                face.furthestHeight = h;
+            }
+        }
+        return false;
+    }
+
+    // Everything needed from the visible faces is read before their slots
+    // are reused
+    QVector<HorizonEdge>& edges = m_horizonEdges;
+    edges.resize(loop.size());
+    for (int h = 0; h < loop.size(); ++h) {
+        const Edge& edge = m_edges[loop[h]];
+        edges[h] = HorizonEdge{edge.origin, m_edges[edge.next].origin, edge.twin};
+    }
+    QVector<int>& orphans = m_orphans;
+    orphans.clear();
+    for (int f : std::as_const(visible)) {
+        for (int p = m_faces[f].conflicts; p >= 0; p = m_nextConflict[p]) {
+            if (p != eye) orphans.append(p);
+        }
+        m_faces[f].alive = false;
+        m_freeFaces.append(f);
+    }
+
+    QVector<int>& fan = m_fan;
+    fan.resize(edges.size());
+    for (int h = 0; h < edges.size(); ++h) {
+        fan[h] = addFace(edges[h].from, edges[h].to, eye);
+        m_edges[3 * fan[h]].twin = edges[h].twin;
+        m_edges[edges[h].twin].twin = 3 * fan[h];
+    }
+    for (int h = 0; h < fan.size(); ++h) {
+        const int next = fan[(h + 1) % fan.size()];
+        m_edges[3 * fan[h] + 1].twin = 3 * next + 2;
+        m_edges[3 * next + 2].twin = 3 * fan[h] + 1;
+    }
+
+    // The first insertions orphan most of the points. Their faces are then
+    // found in parallel and linked in order, as the serial loop would.
+    if (m_parallel && orphans.size() >= kParallelOrphans) {
+        m_orphanFaces.resize(orphans.size());
+        m_orphanHeights.resize(orphans.size());
+        parallelFor(orphans.size(), kOrphanGrain, [&](qsizetype begin, qsizetype end) {
+            for (qsizetype i = begin; i < end; ++i) {
+                m_orphanFaces[i] = bestFace(orphans[i], fan.constData(), int(fan.size()),
+                                            m_orphanHeights[i]);
+            }
+        });
+        for (qsizetype i = 0; i < orphans.size(); ++i) {
+            if (m_orphanFaces[i] >= 0) {
+                addConflict(m_orphanFaces[i], orphans[i], m_orphanHeights[i]);
+            }
+        }
+    } else {
+        for (int p : std::as_const(orphans)) {
+            assignToBest(p, fan.constData(), int(fan.size()));
+        }
+    }
+    for (int f : std::as_const(fan)) {
+        if (m_faces[f].conflicts >= 0) {
+            pending.append(f);
+        }
+    }
+    return true;
+}
+
+bool QuickHullBuilder::isOutside(const GridPoint& point) const
+{
+    for (const Face& face : m_faces) {
+        if (face.alive && height(face, point) > 0) return true;
+    }
+    return false;
+}
+
+QVector<int> QuickHullBuilder::vertexIndices() const
+{
+    QVector<int> indices;
+    QVector<bool> used(m_points.size(), false);
+    for (int f = 0; f < m_faces.size(); ++f) {
+        if (!m_faces[f].alive) continue;
+        for (int e = 3 * f; e < 3 * f + 3; ++e) {
+            const int v = m_edges[e].origin;
+            if (!used[v]) {
+                used[v] = true;
+                indices.append(v);
+            }
+        }
+    }
+    return indices;
+}
+
+ConvexHull QuickHullBuilder::hull(const QVector<QVector3D>& coordinates) const
+{
+    ConvexHull hull;
+    QVector<int> remap(m_points.size(), -1);
+    for (int f = 0; f < m_faces.size(); ++f) {
+        if (!m_faces[f].alive) continue;
+        for (int e = 3 * f; e < 3 * f + 3; ++e) {
+            const int v = m_edges[e].origin;
+            if (remap[v] < 0) {
+                remap[v] = int(hull.vertices.size());
+                hull.vertices.append(coordinates[v]);
+            }
+            hull.indices.append(quint32(remap[v]));
+        }
+    }
+    return hull;
+}
+
+template<typename T>
+QVector<T> gather(const QVector<T>& points, const QVector<int>& indices)
+{
+    QVector<T> subset(indices.size());
+    for (qsizetype i = 0; i < indices.size(); ++i) {
+        subset[i] = points[indices[i]];
+    }
+    return subset;
+}
+
+// 2D convex hull, counter-clockwise, collinear points dropped (Andrew)
+QVector<QPair<double, double>> convexPolygon(QVector<QPair<double, double>> points)
+{
+    std::sort(points.begin(), points.end());
+    points.erase(std::unique(points.begin(), points.end()), points.end());
+    if (points.size() < 3) return points;
+
+    auto turn = [](const QPair<double, double>& o, const QPair<double, double>& a,
+                   const QPair<double, double>& b) {
+        return (a.first - o.first) * (b.second - o.second) - (a.second - o.second) * (b.first - o.first);
+    };
+    QVector<QPair<double, double>> polygon(2 * points.size());
+    qsizetype k = 0;
+    for (qsizetype i = 0; i < points.size(); ++i) {
+        while (k >= 2 && turn(polygon[k - 2], polygon[k - 1], points[i]) <= 0.0) --k;
+        polygon[k++] = points[i];
+    }
+    for (qsizetype i = points.size() - 2, lower = k + 1; i >= 0; --i) {
+        while (k >= lower && turn(polygon[k - 2], polygon[k - 1], points[i]) <= 0.0) --k;
+        polygon[k++] = points[i];
+    }
+    polygon.resize(k - 1);
+    return polygon;
+}
+
+// Height of 'points' along the direction, and the rectangle around the
+// projection of 'outline', which must include the points' projected hull
+Footprint footprintOf(const QVector<QVector3D>& points, const QVector<QVector3D>& outline,
+                      const QVector3D& direction)
+{
+    Footprint result;
+    if (points.isEmpty() || direction.isNull()) return result;
+
+    const QVector3D n = direction.normalized();
+    const QVector3D helper = qAbs(n.x()) < 0.6f ? QVector3D(1.0f, 0.0f, 0.0f)
+                           : (qAbs(n.y()) < 0.6f ? QVector3D(0.0f, 1.0f, 0.0f) : QVector3D(0.0f, 0.0f, 1.0f));
+    const QVector3D u = QVector3D::crossProduct(n, helper).normalized();
+    const QVector3D v = QVector3D::crossProduct(n, u);
+
+    double low = std::numeric_limits<double>::max();
+    double high = std::numeric_limits<double>::lowest();
+    for (const QVector3D& point : points) {
+        const double h = dot(toDouble(point), toDouble(n));
+        low = qMin(low, h);
+        high = qMax(high, h);
+    }
+    result.height = float(high - low);
+
+    QVector<QPair<double, double>> projected(outline.size());
+    for (qsizetype i = 0; i < outline.size(); ++i) {
+        const Vec3d p = toDouble(outline[i]);
+        projected[i] = qMakePair(dot(p, toDouble(u)), dot(p, toDouble(v)));
+    }
+
+    const QVector<QPair<double, double>> polygon = convexPolygon(projected);
+    const int m = int(polygon.size());
+    if (m < 3) {
+        result.axis = u;
+        return result;
+    }
+
+    // Rotating calipers: one rectangle side flush with each polygon edge,
+    // the three other extreme vertices only ever move forward
+    auto along = [&](int i, double dx, double dy) {
+        return polygon[i % m].first * dx + polygon[i % m].second * dy;
+    };
+    double bestArea = std::numeric_limits<double>::max();
+    int right = 0;
+    int top = 0;
+    int left = 0;
+    bool started = false;
+    for (int i = 0; i < m; ++i) {
+        const double ex = polygon[(i + 1) % m].first - polygon[i].first;
+        const double ey = polygon[(i + 1) % m].second - polygon[i].second;
+        const double length = std::sqrt(ex * ex + ey * ey);
+        if (length == 0.0) continue;
+        const double dx = ex / length;
+        const double dy = ey / length;
+        // Inward normal of a counter-clockwise polygon
+        const double nx = -dy;
+        const double ny = dx;
+
+        if (!started) {
+            started = true;
+            right = top = left = 0;
+            for (int k = 1; k < m; ++k) {
+                if (along(k, dx, dy) > along(right, dx, dy)) right = k;
+                if (along(k, nx, ny) > along(top, nx, ny)) top = k;
+                if (along(k, dx, dy) < along(left, dx, dy)) left = k;
+            }
+        } else {
+            for (int step = 0; step < m && along(right + 1, dx, dy) > along(right, dx, dy); ++step) {
+                right = (right + 1) % m;
+            }
+            for (int step = 0; step < m && along(top + 1, nx, ny) > along(top, nx, ny); ++step) {
+                top = (top + 1) % m;
+            }
+            for (int step = 0; step < m && along(left + 1, dx, dy) < along(left, dx, dy); ++step) {
+                left = (left + 1) % m;
+            }
+        }
+
+        const double width = along(right, dx, dy) - along(left, dx, dy);
+        const double depth = along(top, nx, ny) - along(i, nx, ny);
+        if (width * depth < bestArea) {
+            bestArea = width * depth;
+            result.area = bestArea;
+            result.width = float(width);
+            result.depth = float(depth);
+            result.axis = (u * float(dx) + v * float(dy)).normalized();
+        }
+    }
+    return result;
+}
+
+// Cube-map cell of a unit direction, kDirectionCells per face side
+int directionCell(const double c[3])
+{
+    int axis = 0;
+    for (int k = 1; k < 3; ++k) {
+        if (qAbs(c[k]) > qAbs(c[axis])) axis = k;
+    }
+    const double s = c[(axis + 1) % 3] / qAbs(c[axis]);
+    const double t = c[(axis + 2) % 3] / qAbs(c[axis]);
+    const int i = qBound(0, int((s + 1.0) * 0.5 * kDirectionCells), kDirectionCells - 1);
+    const int j = qBound(0, int((t + 1.0) * 0.5 * kDirectionCells), kDirectionCells - 1);
+    return ((axis * 2 + (c[axis] < 0.0 ? 1 : 0)) * kDirectionCells + i) * kDirectionCells + j;
+}
+
+// Unit directions of the hull's edges, signed so the largest component is
+// positive, grouped by cube-map cell and longest in total first
+QVector<QVector3D> edgeDirections(const ConvexHull& hull, int maxCount)
+{
+    QVector<QPair<int, Vec3d>> edges;
+    for (qsizetype k = 0; k < hull.indices.size(); ++k) {
+        // Each edge borders two faces; take it from the one that runs it
+        // from the lower index
+        const quint32 from = hull.indices[k];
+        const quint32 to = hull.indices[k % 3 == 2 ? k - 2 : k + 1];
+        if (from > to) continue;
+        Vec3d e = sub(toDouble(hull.vertices[to]), toDouble(hull.vertices[from]));
+        const double length = std::sqrt(dot(e, e));
+        if (length == 0.0) continue;
+        const double largest = qAbs(e.x) >= qAbs(e.y) && qAbs(e.x) >= qAbs(e.z) ? e.x
+                             : (qAbs(e.y) >= qAbs(e.z) ? e.y : e.z);
+        if (largest < 0.0) e = {-e.x, -e.y, -e.z};
+        const double c[3] = {e.x / length, e.y / length, e.z / length};
+        edges.append(qMakePair(directionCell(c), e));
+    }
+    std::sort(edges.begin(), edges.end(), [](const QPair<int, Vec3d>& l, const QPair<int, Vec3d>& r) {
+        return l.first < r.first;
+    });
+
+    // Summing the edges weights each cell's direction by length
+    QVector<QPair<Vec3d, double>> cells;
+    for (qsizetype i = 0; i < edges.size(); ++i) {
+        if (i == 0 || edges[i].first != edges[i - 1].first) {
+            cells.append(qMakePair(Vec3d{0.0, 0.0, 0.0}, 0.0));
+        }
+        Vec3d& sum = cells.last().first;
+        const Vec3d& e = edges[i].second;
+        sum = {sum.x + e.x, sum.y + e.y, sum.z + e.z};
+        cells.last().second += std::sqrt(dot(e, e));
+    }
+    std::sort(cells.begin(), cells.end(), [](const QPair<Vec3d, double>& l, const QPair<Vec3d, double>& r) {
+        return l.second > r.second;
+    });
+
+    QVector<QVector3D> directions;
+    for (const auto& cell : std::as_const(cells)) {
+        if (directions.size() == maxCount) break;
+        const double length = std::sqrt(dot(cell.first, cell.first));
+        if (length == 0.0) continue;
+        directions.append(QVector3D(float(cell.first.x / length), float(cell.first.y / length),
+                                    float(cell.first.z / length)));
+    }
+    return directions;
+}
+
+// Lowest and highest projection of the points on each axis
+void extents(const QVector<QVector3D>& points, const QVector3D axes[3], QVector3D& low, QVector3D& high)
+{
+    const qsizetype count = points.size();
+    if (count == 0) {
+        low = high = QVector3D();
+        return;
+    }
+    const qsizetype chunkCount = (count + kGrain - 1) / kGrain;
+    QVector<QVector3D> chunkLow(chunkCount);
+    QVector<QVector3D> chunkHigh(chunkCount);
+    parallelFor(count, kGrain, [&](qsizetype begin, qsizetype end) {
+        QVector3D chunkMin(std::numeric_limits<float>::max(), std::numeric_limits<float>::max(),
+                           std::numeric_limits<float>::max());
+        QVector3D chunkMax = -chunkMin;
+        for (qsizetype i = begin; i < end; ++i) {
+            for (int axis = 0; axis < 3; ++axis) {
+                const float h = QVector3D::dotProduct(points[i], axes[axis]);
+                chunkMin[axis] = qMin(chunkMin[axis], h);
+                chunkMax[axis] = qMax(chunkMax[axis], h);
+            }
+        }
+        chunkLow[begin / kGrain] = chunkMin;
+        chunkHigh[begin / kGrain] = chunkMax;
+    });
+    low = chunkLow[0];
+    high = chunkHigh[0];
+    for (qsizetype c = 1; c < chunkCount; ++c) {
+        for (int axis = 0; axis < 3; ++axis) {
+            low[axis] = qMin(low[axis], chunkLow[c][axis]);
+            high[axis] = qMax(high[axis], chunkHigh[c][axis]);
+        }
+    }
+}
+
+double boxVolume(const QVector<QVector3D>& points, const QVector3D axes[3])
+{
+    QVector3D low;
+    QVector3D high;
+    extents(points, axes, low, high);
+    const QVector3D size = high - low;
+    return double(size.x()) * double(size.y()) * double(size.z());
+}
+
+// v turned by the angle about the unit axis (Rodrigues)
+QVector3D turned(const QVector3D& v, const QVector3D& axis, double radians)
+{
+    const float c = float(std::cos(radians));
+    const float s = float(std::sin(radians));
+    return v * c + QVector3D::crossProduct(axis, v) * s
+         + axis * (QVector3D::dotProduct(axis, v) * (1.0f - c));
+}
+
+// Turns the axes about each other by halving steps, from the first to the
+// last angle in degrees and no further than the largest, while the box
+// around the vertices gets smaller. This corrects the candidate directions,
+// which are cell means on a simplified hull, and reaches boxes flush with
+// edges rather than faces nearby. Vertices farther inside the box than any
+// allowed turn can bring them cannot become extreme, so only those near its
+// faces are measured.
+void refineAxes(const QVector<QVector3D>& vertices, const double turn[3], QVector3D axes[3])
+{
+    QVector3D low;
+    QVector3D high;
+    extents(vertices, axes, low, high);
+    const double maxTurn = qDegreesToRadians(turn[2]);
+    const float margin = float(2.0 * maxTurn) * (high - low).length();
+    QVector<QVector3D> near;
+    for (const QVector3D& v : vertices) {
+        for (int axis = 0; axis < 3; ++axis) {
+            const float h = QVector3D::dotProduct(v, axes[axis]);
+            if (h - low[axis] < margin || high[axis] - h < margin) {
+                near.append(v);
+                break;
+            }
+        }
+    }
+
+    const QVector3D start[3] = {axes[0], axes[1], axes[2]};
+    const float minCosine = float(std::cos(maxTurn));
+    double best = boxVolume(near, axes);
+    for (double step = turn[0]; step >= turn[1]; step *= 0.5) {
+        bool improved = true;
+        while (improved) {
+            improved = false;
+            for (int pivot = 0; pivot < 3; ++pivot) {
+                for (double sign : {-1.0, 1.0}) {
+                    QVector3D trial[3];
+                    bool inRange = true;
+                    for (int axis = 0; axis < 3; ++axis) {
+                        trial[axis] = turned(axes[axis], axes[pivot], sign * qDegreesToRadians(step));
+                        inRange = inRange && QVector3D::dotProduct(trial[axis], start[axis]) >= minCosine;
+                    }
+                    if (!inRange) continue;
+                    const double volume = boxVolume(near, trial);
+                    if (volume < best) {
+                        best = volume;
+                        std::copy(trial, trial + 3, axes);
+                        improved = true;
+                    }
+                }
+            }
+        }
+    }
+
+    // Keep the axes orthonormal after the turns
+    axes[0].normalize();
+    axes[1] = (axes[1] - axes[0] * QVector3D::dotProduct(axes[0], axes[1])).normalized();
+    axes[2] = QVector3D::crossProduct(axes[0], axes[1]);
+}
+
+} // namespace
+
+ConvexHull MeshHull::compute(const QVector<QVector3D>& points)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    const qsizetype count = points.size();
+    if (count < 4) return ConvexHull();
+    const QVector<GridPoint> grid = snapToGrid(points);
+    if (grid.isEmpty()) return ConvexHull();
+
+    // Extremes along 26 directions; points inside their hull cannot be on
+    // the final one (Akl-Toussaint)
+    QVector<GridPoint> directions;
+    for (int x = -1; x <= 1; ++x) {
+        for (int y = -1; y <= 1; ++y) {
+            for (int z = -1; z <= 1; ++z) {
+                if (x || y || z) directions.append(GridPoint{x, y, z});
+            }
+        }
+    }
+    const int directionCount = int(directions.size());
+    QVector<int> chunkExtremes(((count + kGrain - 1) / kGrain) * directionCount);
+    parallelFor(count, kGrain, [&](qsizetype begin, qsizetype end) {
+        int* extremes = chunkExtremes.data() + (begin / kGrain) * directionCount;
+        for (int d = 0; d < directionCount; ++d) {
+            int best = int(begin);
+            qint64 bestValue = dot(grid[begin], directions[d]);
+            for (qsizetype i = begin + 1; i < end; ++i) {
+                const qint64 value = dot(grid[i], directions[d]);
+                if (value > bestValue) {
+                    best = int(i);
+                    bestValue = value;
+                }
+            }
+            extremes[d] = best;
+        }
+    });
+    QVector<int> extremes;
+    for (int d = 0; d < directionCount; ++d) {
+        int best = chunkExtremes[d];
+        for (qsizetype c = directionCount + d; c < chunkExtremes.size(); c += directionCount) {
+            if (dot(grid[chunkExtremes[c]], directions[d]) > dot(grid[best], directions[d])) {
+                best = chunkExtremes[c];
+            }
+        }
+        if (!extremes.contains(best)) extremes.append(best);
+    }
+
+    QVector<int> candidates;
+    const QVector<GridPoint> extremePoints = gather(grid, extremes);
+    QuickHullBuilder filter(extremePoints);
+    if (!filter.build(false)) {
+        candidates.resize(count);
+        std::iota(candidates.begin(), candidates.end(), 0);
+    } else {
+        QVector<char> keep(count);
+        parallelFor(count, kGrain, [&](qsizetype begin, qsizetype end) {
+            for (qsizetype i = begin; i < end; ++i) {
+                keep[i] = filter.isOutside(grid[i]);
+            }
+        });
+        for (int e : std::as_const(extremes)) {
+            keep[e] = true;
+        }
+        for (qsizetype i = 0; i < count; ++i) {
+            if (keep[i]) candidates.append(int(i));
+        }
+    }
+
+    sortSpatially(grid, candidates);
+
+    // Chunks are hulled in parallel; only their vertices go into the final
+    // pass, which is the hull of the union
+    const int threads = QThreadPool::globalInstance()->maxThreadCount();
+    const bool chunked = candidates.size() <= kMaxChunkedShare * double(count);
+    const qsizetype chunks = chunked ? qMin<qsizetype>(threads, candidates.size() / kMinChunkPoints) : 1;
+    if (chunks > 1) {
+        const qsizetype chunkSize = (candidates.size() + chunks - 1) / chunks;
+        QVector<QVector<int>> chunkVertices(chunks);
+        parallelFor(chunks, 1, [&](qsizetype chunk, qsizetype) {
+            const QVector<int> indices = candidates.mid(chunk * chunkSize, chunkSize);
+            const QVector<GridPoint> subset = gather(grid, indices);
+            QuickHullBuilder builder(subset);
+            if (builder.build(false)) {
+                for (int v : builder.vertexIndices()) {
+                    chunkVertices[chunk].append(indices[v]);
+                }
+            } else {
+                chunkVertices[chunk] = indices;
+            }
+        });
+        candidates.clear();
+        for (const QVector<int>& vertices : std::as_const(chunkVertices)) {
+            candidates += vertices;
+        }
+        sortSpatially(grid, candidates);
+    }
+
+    const QVector<GridPoint> subset = gather(grid, candidates);
+    QuickHullBuilder builder(subset);
+    ConvexHull hull;
+    if (builder.build(true)) {
+        hull = builder.hull(gather(points, candidates));
+    }
+    hull.elapsedMs = timer.elapsed();
+    qInfo().noquote() << QString("Convex hull of %1 points: %2 vertices, %3 faces "
+                                 "(%4 after filtering, %5 chunks) in %6 ms")
+                             .arg(count).arg(hull.vertices.size()).arg(hull.faceCount())
+                             .arg(candidates.size()).arg(qMax<qsizetype>(chunks, 1))
+                             .arg(hull.elapsedMs);
+    return hull;
+}
+
+ConvexHull MeshHull::simplified(const ConvexHull& hull, int cells)
+{
+    if (hull.vertices.size() <= 4 || cells < 2) return hull;
+
+    QVector3D low = hull.vertices.first();
+    QVector3D high = low;
+    for (const QVector3D& v : hull.vertices) {
+        low = QVector3D(qMin(low.x(), v.x()), qMin(low.y(), v.y()), qMin(low.z(), v.z()));
+        high = QVector3D(qMax(high.x(), v.x()), qMax(high.y(), v.y()), qMax(high.z(), v.z()));
+    }
+    const QVector3D extent = high - low;
+    const float cellSize = qMax(extent.x(), qMax(extent.y(), extent.z())) / float(cells);
+    if (!(cellSize > 0.0f)) return hull;
+
+    QVector<QPair<quint64, int>> keyed(hull.vertices.size());
+    parallelFor(hull.vertices.size(), kGrain, [&](qsizetype begin, qsizetype end) {
+        for (qsizetype i = begin; i < end; ++i) {
+            const QVector3D cell = (hull.vertices[i] - low) / cellSize;
+            const quint64 key = (quint64(cell.x()) << 42) | (quint64(cell.y()) << 21) | quint64(cell.z());
+            keyed[i] = qMakePair(key, int(i));
+        }
+    });
+    std::sort(keyed.begin(), keyed.end());
+
+    QVector<QVector3D> kept;
+    for (qsizetype i = 0; i < keyed.size(); ++i) {
+        if (i == 0 || keyed[i].first != keyed[i - 1].first) {
+            kept.append(hull.vertices[keyed[i].second]);
+        }
+    }
+    const QVector<GridPoint> grid = snapToGrid(kept);
+    QuickHullBuilder builder(grid);
+    if (grid.isEmpty() || !builder.build(true)) return hull;
+    return builder.hull(kept);
+}
+
+Footprint MeshHull::footprint(const ConvexHull& hull, const QVector3D& direction)
+{
+    // The projected outline runs along edges between faces turned towards
+    // and away from the direction; only their vertices are projected
+    QVector<quint8> sides(hull.vertices.size(), 0);
+    for (int f = 0; f < hull.faceCount(); ++f) {
+        const Vec3d a = toDouble(hull.vertices[hull.indices[3 * f]]);
+        const double facing = dot(cross(sub(toDouble(hull.vertices[hull.indices[3 * f + 1]]), a),
+                                        sub(toDouble(hull.vertices[hull.indices[3 * f + 2]]), a)),
+                                  toDouble(direction));
+        const quint8 side = facing > 0.0 ? 1 : (facing < 0.0 ? 2 : 3);
+        for (int k = 0; k < 3; ++k) {
+            sides[hull.indices[3 * f + k]] |= side;
+        }
+    }
+    QVector<QVector3D> outline;
+    for (qsizetype i = 0; i < sides.size(); ++i) {
+        if (sides[i] == 3) outline.append(hull.vertices[i]);
+    }
+    return footprintOf(hull.vertices, outline, direction);
+}
+
+QVector<QPair<QVector3D, double>> MeshHull::faceDirections(const ConvexHull& hull, int maxCount)
+{
+    // Normals are grouped by cube-map cell, each group keeping its area and
+    // area-weighted mean normal
+    struct Cell {
+        int key;
+        Vec3d normal;
+        double area;
+    };
+    QVector<Cell> faces;
+    faces.reserve(hull.faceCount());
+    for (int f = 0; f < hull.faceCount(); ++f) {
+        const Vec3d a = toDouble(hull.vertices[hull.indices[3 * f]]);
+        const Vec3d n = cross(sub(toDouble(hull.vertices[hull.indices[3 * f + 1]]), a),
+                              sub(toDouble(hull.vertices[hull.indices[3 * f + 2]]), a));
+        const double length = std::sqrt(dot(n, n));
+        if (length == 0.0) continue;
+
+        const double c[3] = {n.x / length, n.y / length, n.z / length};
+        faces.append(Cell{directionCell(c), n, 0.5 * length});
+    }
+    std::sort(faces.begin(), faces.end(), [](const Cell& l, const Cell& r) { return l.key < r.key; });
+
+    QVector<Cell> cells;
+    for (const Cell& face : std::as_const(faces)) {
+        if (cells.isEmpty() || cells.last().key != face.key) {
+            cells.append(Cell{face.key, Vec3d{0.0, 0.0, 0.0}, 0.0});
+        }
+        Cell& cell = cells.last();
+        cell.normal = {cell.normal.x + face.normal.x, cell.normal.y + face.normal.y,
+                       cell.normal.z + face.normal.z};
+        cell.area += face.area;
+    }
+
+    QVector<QPair<QVector3D, double>> directions;
+    for (const Cell& cell : std::as_const(cells)) {
+        const double length = std::sqrt(dot(cell.normal, cell.normal));
+        if (length == 0.0) continue;
+        directions.append(qMakePair(QVector3D(float(cell.normal.x / length), float(cell.normal.y / length),
+                                              float(cell.normal.z / length)), cell.area));
+    }
+    std::sort(directions.begin(), directions.end(),
+              [](const QPair<QVector3D, double>& l, const QPair<QVector3D, double>& r) {
+        return l.second > r.second;
+    });
+    if (directions.size() > maxCount) {
+        directions.resize(maxCount);
+    }
+    return directions;
+}
+
+OrientedBox MeshHull::minimalBox(const ConvexHull& hull)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    OrientedBox box;
+    box.axes[0] = QVector3D(1.0f, 0.0f, 0.0f);
+    box.axes[1] = QVector3D(0.0f, 1.0f, 0.0f);
+    box.axes[2] = QVector3D(0.0f, 0.0f, 1.0f);
+    if (hull.vertices.isEmpty()) return box;
+
+    const ConvexHull coarse = hull.vertices.size() > kSearchVertices
+                            ? simplified(hull, kSearchCells) : hull;
+
+    QVector<QVector3D> directions = {box.axes[0], box.axes[1], box.axes[2]};
+    for (const auto& direction : faceDirections(coarse, kBoxDirections)) {
+        directions.append(direction.first);
+    }
+    // Boxes flush with edges rather than faces: an axis along an edge, or a
+    // face parallel to two edges, as when a box face holds each of two
+    // opposite edges
+    const QVector<QVector3D> edges = edgeDirections(coarse, kBoxEdges);
+    for (qsizetype i = 0; i < edges.size(); ++i) {
+        directions.append(edges[i]);
+        for (qsizetype j = i + 1; j < edges.size(); ++j) {
+            const QVector3D normal = QVector3D::crossProduct(edges[i], edges[j]);
+            if (normal.lengthSquared() > 1e-6f) directions.append(normal.normalized());
+        }
+    }
+
+    QVector<Footprint> footprints(directions.size());
+    parallelFor(directions.size(), 8, [&](qsizetype begin, qsizetype end) {
+        for (qsizetype i = begin; i < end; ++i) {
+            footprints[i] = footprint(coarse, directions[i]);
+        }
+    });
+    auto volume = [&footprints](qsizetype i) {
+        return footprints[i].area * footprints[i].height;
+    };
+    QVector<qsizetype> order(directions.size());
+    std::iota(order.begin(), order.end(), qsizetype(0));
+    if (coarse.vertices.size() < hull.vertices.size()) {
+        const qsizetype refined = qMin<qsizetype>(kBoxRefined, order.size());
+        std::partial_sort(order.begin(), order.begin() + refined, order.end(),
+                          [&volume](qsizetype l, qsizetype r) { return volume(l) < volume(r); });
+        order.resize(refined);
+        // The axis-aligned box is always a contender, so the result is never
+        // larger than the model's bounds
+        for (qsizetype axis = 0; axis < 3; ++axis) {
+            if (!order.contains(axis)) order.append(axis);
+        }
+        parallelFor(order.size(), 1, [&](qsizetype begin, qsizetype) {
+            footprints[order[begin]] = footprint(hull, directions[order[begin]]);
+        });
+    }
+    const qsizetype best = *std::min_element(order.begin(), order.end(),
+                                             [&volume](qsizetype l, qsizetype r) { return volume(l) < volume(r); });
+    if (!footprints[best].axis.isNull()) {
+        box.axes[0] = directions[best].normalized();
+        box.axes[1] = footprints[best].axis;
+        box.axes[2] = QVector3D::crossProduct(box.axes[0], box.axes[1]).normalized();
+    }
+
+    // Exact extents over every hull vertex. Turning on the simplified hull
+    // can lose on the full one, so the unturned box is kept in that case.
+    const OrientedBox unturned = boxAlong(hull, box.axes);
+    refineAxes(coarse.vertices, kCoarseTurn, box.axes);
+    refineAxes(hull.vertices, kFineTurn, box.axes);
+    box = boxAlong(hull, box.axes);
+    if (unturned.volume() < box.volume()) box = unturned;
+
+    // Longest side first
+    for (int i = 0; i < 2; ++i) {
+        for (int j = 0; j < 2 - i; ++j) {
+            if (box.halfExtents[j] < box.halfExtents[j + 1]) {
+                std::swap(box.axes[j], box.axes[j + 1]);
+                std::swap(box.halfExtents[j], box.halfExtents[j + 1]);
+            }
+        }
+    }
+    box.axes[2] = QVector3D::crossProduct(box.axes[0], box.axes[1]);
+
+    box.elapsedMs = timer.elapsed();
+    return box;
+}
+
+OrientedBox MeshHull::boxAlong(const ConvexHull& hull, const QVector3D axes[3])
+{
+    OrientedBox box;
+    std::copy(axes, axes + 3, box.axes);
+    if (hull.vertices.isEmpty()) return box;
+
+    QVector3D low;
+    QVector3D high;
+    extents(hull.vertices, box.axes, low, high);
+    box.halfExtents = (high - low) * 0.5f;
+    const QVector3D middle = (high + low) * 0.5f;
+    box.center = box.axes[0] * middle.x() + box.axes[1] * middle.y() + box.axes[2] * middle.z();
+    return box;
+}
+
+ShapeSurface MeshHull::surface(const ConvexHull& hull, quint16 color)
+{
+    const ConvexHull shown = hull.vertices.size() > kSearchVertices
+                           ? simplified(hull, kDisplayCells) : hull;
+    ShapeSurface surface;
+    surface.vertices.reserve(shown.indices.size());
+    surface.normals.reserve(shown.indices.size());
+    surface.faceColors.fill(color, shown.faceCount());
+    for (int f = 0; f < shown.faceCount(); ++f) {
+        const QVector3D a = shown.vertices[shown.indices[3 * f]];
+        const QVector3D b = shown.vertices[shown.indices[3 * f + 1]];
+        const QVector3D c = shown.vertices[shown.indices[3 * f + 2]];
+        const QVector3D normal = QVector3D::crossProduct(b - a, c - a).normalized();
+        surface.vertices << a << b << c;
+        surface.normals << normal << normal << normal;
+    }
+    return surface;
+}
+
+ShapeSurface MeshHull::surface(const OrientedBox& box, quint16 color)
+{
+    ShapeSurface surface;
+    surface.faceColors.fill(color, 12);
+    for (int axis = 0; axis < 3; ++axis) {
+        const QVector3D u = box.axes[(axis + 1) % 3] * box.halfExtents[(axis + 1) % 3];
+        const QVector3D v = box.axes[(axis + 2) % 3] * box.halfExtents[(axis + 2) % 3];
+        // Counter-clockwise seen from outside whichever handedness the axes have
+        const float winding = QVector3D::dotProduct(QVector3D::crossProduct(u, v), box.axes[axis]) < 0.0f
+                            ? -1.0f : 1.0f;
+        for (float side : {1.0f, -1.0f}) {
+            const QVector3D normal = box.axes[axis] * side;
+            const QVector3D middle = box.center + normal * box.halfExtents[axis];
+            const QVector3D w = v * (side * winding);
+            const QVector3D corners[4] = {middle - u - w, middle + u - w, middle + u + w, middle - u + w};
+            surface.vertices << corners[0] << corners[1] << corners[2]
+                             << corners[0] << corners[2] << corners[3];
+            for (int k = 0; k < 6; ++k) {
+                surface.normals << normal;
+            }
+        }
+    }
+    return surface;
+}
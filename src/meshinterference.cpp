@@ -0,0 +1,513 @@
+#include "meshinterference.h"
+#include "trianglebvh.h"
+#include "geometrykernels.h"
+#include "stlviewer.h"
+#include "parallelfor.h"
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QDebug>
+#include <QtMath>
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <utility>
+
+namespace {
+
+using Node = TriangleBVH::Node;
+using Primitive = TriangleBVH::Primitive;
+
+// The top of the pair traversal is expanded until there are at least this
+// many independent node pairs to hand to the thread pool
+const qsizetype kMinTasks = 1024;
+
+// Leaf pairs are queued and tested this many at a time by the triangle
+// kernel; a pair of full leaves fills 16 lanes, one AVX-512 register
+const int kBatchSize = 64;
+
+// Corners of a part farther than this fraction of the other part's size
+// from its surface decide whether the part lies inside the other
+const float kInsideTolerance = 1e-5f;
+
+// Corners tried before a part whose corners all lie on the other's surface
+// is taken to touch it from outside
+const qsizetype kInsideProbes = 16;
+
+struct NodePair {
+    quint32 a;
+    quint32 b;
+};
+
+struct IntersectingPair {
+    quint32 primitiveA;
+    quint32 primitiveB;
+};
+
+bool boxesOverlap(const Node& a, const Node& b)
+{
+    for (int axis = 0; axis < 3; ++axis) {
+        if (a.maxBounds[axis] < b.minBounds[axis] || b.maxBounds[axis] < a.minBounds[axis]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+float boxDistanceSquared(const Node& a, const Node& b)
+{
+    float d2 = 0.0f;
+    for (int axis = 0; axis < 3; ++axis) {
+        const float gap = qMax(a.minBounds[axis] - b.maxBounds[axis],
+                               b.minBounds[axis] - a.maxBounds[axis]);
+        if (gap > 0.0f) d2 += gap * gap;
+    }
+    return d2;
+}
+
+// Splits the pair by descending into the larger node
+void splitPair(const QVector<Node>& nodesA, const QVector<Node>& nodesB,
+               const NodePair& pair, NodePair children[2])
+{
+    const Node& a = nodesA[pair.a];
+    const Node& b = nodesB[pair.b];
+    const bool splitA = !a.isLeaf()
+        && (b.isLeaf() || (a.maxBounds - a.minBounds).lengthSquared()
+                          >= (b.maxBounds - b.minBounds).lengthSquared());
+    if (splitA) {
+        children[0] = {pair.a + 1, pair.b};
+        children[1] = {a.first, pair.b};
+    } else {
+        children[0] = {pair.a, pair.b + 1};
+        children[1] = {pair.a, b.first};
+    }
+}
+
+bool isLeafPair(const QVector<Node>& nodesA, const QVector<Node>& nodesB, const NodePair& pair)
+{
+    return nodesA[pair.a].isLeaf() && nodesB[pair.b].isLeaf();
+}
+
+// Expands the root pair breadth first into independent subtree pairs,
+// dropping those the predicate rejects
+template <typename Keep>
+QVector<NodePair> taskFrontier(const QVector<Node>& nodesA, const QVector<Node>& nodesB, Keep keep)
+{
+    QVector<NodePair> frontier;
+    if (keep(NodePair{0, 0})) frontier.append(NodePair{0, 0});
+
+    bool split = true;
+    while (split && !frontier.isEmpty() && frontier.size() < kMinTasks) {
+        split = false;
+        QVector<NodePair> next;
+        next.reserve(frontier.size() * 2);
+        for (const NodePair& pair : std::as_const(frontier)) {
+            if (isLeafPair(nodesA, nodesB, pair)) {
+                next.append(pair);
+                continue;
+            }
+            NodePair children[2];
+            splitPair(nodesA, nodesB, pair, children);
+            for (const NodePair& child : children) {
+                if (keep(child)) next.append(child);
+            }
+            split = true;
+        }
+        frontier = next;
+    }
+    return frontier;
+}
+
+// Closest points of segments p1q1 and p2q2 (Ericson, Real-Time Collision
+// Detection 5.1.9)
+float segmentDistanceSquared(const QVector3D& p1, const QVector3D& q1,
+                             const QVector3D& p2, const QVector3D& q2,
+                             QVector3D& c1, QVector3D& c2)
+{
+    const QVector3D d1 = q1 - p1;
+    const QVector3D d2 = q2 - p2;
+    const QVector3D r = p1 - p2;
+    const float a = QVector3D::dotProduct(d1, d1);
+    const float e = QVector3D::dotProduct(d2, d2);
+    const float f = QVector3D::dotProduct(d2, r);
+
+    float s = 0.0f;
+    float t = 0.0f;
+    if (a == 0.0f && e == 0.0f) {
+        // Both segments are points
+    } else if (a == 0.0f) {
+        t = qBound(0.0f, f / e, 1.0f);
+    } else {
+        const float c = QVector3D::dotProduct(d1, r);
+        if (e == 0.0f) {
+            s = qBound(0.0f, -c / a, 1.0f);
+        } else {
+            const float b = QVector3D::dotProduct(d1, d2);
+            const float denom = a * e - b * b;
+            s = denom != 0.0f ? qBound(0.0f, (b * f - c * e) / denom, 1.0f) : 0.0f;
+            t = (b * s + f) / e;
+            if (t < 0.0f) {
+                t = 0.0f;
+                s = qBound(0.0f, -c / a, 1.0f);
+            } else if (t > 1.0f) {
+                t = 1.0f;
+                s = qBound(0.0f, (b - c) / a, 1.0f);
+            }
+        }
+    }
+
+    c1 = p1 + d1 * s;
+    c2 = p2 + d2 * t;
+    return (c1 - c2).lengthSquared();
+}
+
+struct Closest {
+    float distanceSquared = std::numeric_limits<float>::max();
+    QVector3D pointA;
+    QVector3D pointB;
+    quint32 primitiveA = 0;
+    quint32 primitiveB = 0;
+};
+
+// Triangle pairs awaiting the kernel, in structure-of-arrays layout
+struct PairBatch {
+    float a[3][3][kBatchSize]; // corner, axis, lane
+    float b[3][3][kBatchSize];
+    IntersectingPair pairs[kBatchSize];
+    bool hits[kBatchSize];
+    int count = 0;
+
+    void add(const Primitive& p, const Primitive& q, quint32 i, quint32 j)
+    {
+        const QVector3D* cornersA[3] = {&p.a, &p.b, &p.c};
+        const QVector3D* cornersB[3] = {&q.a, &q.b, &q.c};
+        for (int k = 0; k < 3; ++k) {
+            for (int axis = 0; axis < 3; ++axis) {
+                a[k][axis][count] = (*cornersA[k])[axis];
+                b[k][axis][count] = (*cornersB[k])[axis];
+            }
+        }
+        pairs[count++] = IntersectingPair{i, j};
+    }
+
+    void flush(QVector<IntersectingPair>& out)
+    {
+        const ConstPointsSoA cornersA[3] = {{a[0][0], a[0][1], a[0][2]},
+                                            {a[1][0], a[1][1], a[1][2]},
+                                            {a[2][0], a[2][1], a[2][2]}};
+        const ConstPointsSoA cornersB[3] = {{b[0][0], b[0][1], b[0][2]},
+                                            {b[1][0], b[1][1], b[1][2]},
+                                            {b[2][0], b[2][1], b[2][2]}};
+        GeometryKernels::trianglesCross(cornersA, cornersB, count, hits);
+        for (int lane = 0; lane < count; ++lane) {
+            if (hits[lane]) out.append(pairs[lane]);
+        }
+        count = 0;
+    }
+};
+
+// Every crossing primitive pair between the two trees
+QVector<IntersectingPair> findIntersections(const TriangleBVH& a, const TriangleBVH& b)
+{
+    const QVector<Node>& nodesA = a.nodes();
+    const QVector<Node>& nodesB = b.nodes();
+    const QVector<Primitive>& primsA = a.primitives();
+    const QVector<Primitive>& primsB = b.primitives();
+
+    auto overlapping = [&](const NodePair& pair) {
+        return boxesOverlap(nodesA[pair.a], nodesB[pair.b]);
+    };
+    const QVector<NodePair> frontier = taskFrontier(nodesA, nodesB, overlapping);
+
+    QVector<QVector<IntersectingPair>> taskHits(frontier.size());
+    parallelFor(frontier.size(), 1, [&](qsizetype begin, qsizetype end) {
+        QVector<NodePair> stack;
+        PairBatch batch;
+        for (qsizetype task = begin; task < end; ++task) {
+            QVector<IntersectingPair>& hits = taskHits[task];
+            stack.append(frontier[task]);
+            while (!stack.isEmpty()) {
+                const NodePair pair = stack.takeLast();
+                const Node& nodeA = nodesA[pair.a];
+                const Node& nodeB = nodesB[pair.b];
+
+                if (!nodeA.isLeaf() || !nodeB.isLeaf()) {
+                    NodePair children[2];
+                    splitPair(nodesA, nodesB, pair, children);
+                    for (const NodePair& child : children) {
+                        if (overlapping(child)) stack.append(child);
+                    }
+                    continue;
+                }
+
+                // Leaf pairs run on across flushes, so only the last batch of
+                // a task leaves lanes over for the scalar tail
+                for (quint32 i = nodeA.first; i < nodeA.first + nodeA.count; ++i) {
+                    for (quint32 j = nodeB.first; j < nodeB.first + nodeB.count; ++j) {
+                        if (batch.count == kBatchSize) batch.flush(hits);
+                        batch.add(primsA[i], primsB[j], i, j);
+                    }
+                }
+            }
+            batch.flush(hits);
+        }
+    });
+
+    QVector<IntersectingPair> hits;
+    for (const QVector<IntersectingPair>& task : std::as_const(taskHits)) {
+        hits += task;
+    }
+    return hits;
+}
+
+// True when part a lies inside the closed surface of part b: its bounds fit
+// in b's and a corner of a clear of b's surface is inside it. Only called
+// for parts that do not cross, so one such corner decides for all of a.
+bool liesInside(const TriangleBVH& a, const TriangleBVH& b)
+{
+    const Node& rootA = a.nodes().first();
+    const Node& rootB = b.nodes().first();
+    for (int axis = 0; axis < 3; ++axis) {
+        if (rootA.minBounds[axis] < rootB.minBounds[axis]
+            || rootA.maxBounds[axis] > rootB.maxBounds[axis]) {
+            return false;
+        }
+    }
+
+    // A corner on b's surface says nothing, so try corners spread over a
+    const float tolerance = kInsideTolerance * (rootB.maxBounds - rootB.minBounds).length();
+    const QVector<Primitive>& prims = a.primitives();
+    const qsizetype step = qMax<qsizetype>(1, prims.size() / kInsideProbes);
+    for (qsizetype i = 0; i < prims.size(); i += step) {
+        const QVector3D& corner = prims[i].a;
+        if (b.nearest(corner).distanceSquared > tolerance * tolerance) {
+            return b.contains(corner);
+        }
+    }
+    return false;
+}
+
+// Branch and bound over node pairs, sharing the best distance so far
+// between the tasks
+Closest findClosest(const TriangleBVH& a, const TriangleBVH& b)
+{
+    const QVector<Node>& nodesA = a.nodes();
+    const QVector<Node>& nodesB = b.nodes();
+    const QVector<Primitive>& primsA = a.primitives();
+    const QVector<Primitive>& primsB = b.primitives();
+
+    QVector<NodePair> frontier = taskFrontier(nodesA, nodesB, [](const NodePair&) { return true; });
+
+    // Nearest pairs first, so the early tasks tighten the bound for the rest
+    std::sort(frontier.begin(), frontier.end(), [&](const NodePair& x, const NodePair& y) {
+        return boxDistanceSquared(nodesA[x.a], nodesB[x.b])
+             < boxDistanceSquared(nodesA[y.a], nodesB[y.b]);
+    });
+
+    Closest closest;
+    std::atomic<float> bound(closest.distanceSquared);
+    QMutex mutex;
+
+    parallelFor(frontier.size(), 1, [&](qsizetype begin, qsizetype end) {
+        QVector<NodePair> stack;
+        for (qsizetype task = begin; task < end; ++task) {
+            stack.append(frontier[task]);
+            while (!stack.isEmpty()) {
+                const NodePair pair = stack.takeLast();
+                const Node& nodeA = nodesA[pair.a];
+                const Node& nodeB = nodesB[pair.b];
+                if (boxDistanceSquared(nodeA, nodeB) >= bound.load(std::memory_order_relaxed)) {
+                    continue;
+                }
+
+                if (!nodeA.isLeaf() || !nodeB.isLeaf()) {
+                    // Push the farther child first so the nearer one is
+                    // searched first
+                    NodePair children[2];
+                    splitPair(nodesA, nodesB, pair, children);
+                    const float d0 = boxDistanceSquared(nodesA[children[0].a], nodesB[children[0].b]);
+                    const float d1 = boxDistanceSquared(nodesA[children[1].a], nodesB[children[1].b]);
+                    if (d0 < d1) std::swap(children[0], children[1]);
+                    stack.append(children[0]);
+                    stack.append(children[1]);
+                    continue;
+                }
+
+                for (quint32 i = nodeA.first; i < nodeA.first + nodeA.count; ++i) {
+                    const Primitive& p = primsA[i];
+                    for (quint32 j = nodeB.first; j < nodeB.first + nodeB.count; ++j) {
+                        const Primitive& q = primsB[j];
+                        QVector3D pointA;
+                        QVector3D pointB;
+                        const float d2 = MeshInterference::triangleDistanceSquared(
+                            p.a, p.b, p.c, q.a, q.b, q.c, pointA, pointB);
+                        if (d2 >= bound.load(std::memory_order_relaxed)) continue;
+
+                        QMutexLocker locker(&mutex);
+                        if (d2 < closest.distanceSquared) {
+                            closest = {d2, pointA, pointB, i, j};
+                            bound.store(d2, std::memory_order_relaxed);
+                        }
+                    }
+                }
+            }
+        }
+    });
+
+    return closest;
+}
+
+} // namespace
+
+InterferenceResult MeshInterference::compute(const QVector<QVector<Triangle>>& parts)
+{
+    InterferenceResult result;
+    result.intersectingFacets.resize(parts.size());
+
+    QElapsedTimer timer;
+    timer.start();
+
+    // One task per part; each build also splits its own upper levels, so a
+    // single large part still keeps every core busy
+    QVector<TriangleBVH> trees(parts.size());
+    parallelFor(parts.size(), 1, [&](qsizetype begin, qsizetype end) {
+        for (qsizetype i = begin; i < end; ++i) {
+            trees[i].build(parts[i]);
+        }
+    });
+    const qint64 buildMs = timer.elapsed();
+
+    QVector<QVector<bool>> crossing(parts.size());
+    for (qsizetype i = 0; i < parts.size(); ++i) {
+        crossing[i].fill(false, parts[i].size());
+    }
+
+    bool anyPair = false;
+    for (int i = 0; i < parts.size(); ++i) {
+        for (int j = i + 1; j < parts.size(); ++j) {
+            if (trees[i].isEmpty() || trees[j].isEmpty()) continue;
+
+            PartClearance pair;
+            pair.partA = i;
+            pair.partB = j;
+
+            const QVector<IntersectingPair> hits = findIntersections(trees[i], trees[j]);
+            pair.intersectingPairs = hits.size();
+            for (const IntersectingPair& hit : hits) {
+                crossing[i][trees[i].facetIndices()[hit.primitiveA]] = true;
+                crossing[j][trees[j].facetIndices()[hit.primitiveB]] = true;
+            }
+
+            // A part with no crossings may still lie wholly inside the other
+            if (!pair.intersects()) {
+                if (liesInside(trees[i], trees[j])) pair.enclosedPart = i;
+                else if (liesInside(trees[j], trees[i])) pair.enclosedPart = j;
+            }
+
+            // Crossing and nested parts have no clearance to measure
+            if (!pair.intersects()) {
+                const Closest closest = findClosest(trees[i], trees[j]);
+                pair.distance = qSqrt(closest.distanceSquared);
+                pair.pointA = closest.pointA;
+                pair.pointB = closest.pointB;
+                pair.facetA = trees[i].facetIndices()[closest.primitiveA];
+                pair.facetB = trees[j].facetIndices()[closest.primitiveB];
+            }
+
+            result.minDistance = anyPair ? qMin(result.minDistance, pair.distance) : pair.distance;
+            anyPair = true;
+            result.pairs.append(pair);
+        }
+    }
+
+    for (qsizetype i = 0; i < parts.size(); ++i) {
+        for (qsizetype f = 0; f < crossing[i].size(); ++f) {
+            if (crossing[i][f]) result.intersectingFacets[i].append(quint32(f));
+        }
+    }
+
+    result.elapsedMs = timer.elapsed();
+    for (const PartClearance& pair : std::as_const(result.pairs)) {
+        if (pair.enclosedPart >= 0) {
+            qInfo().noquote() << QString("Interference: part %1 lies inside part %2")
+                .arg(pair.enclosedPart + 1)
+                .arg((pair.enclosedPart == pair.partA ? pair.partB : pair.partA) + 1);
+            continue;
+        }
+        qInfo().noquote() << QString("Interference: parts %1 and %2: %3 crossing facet pairs, "
+                                     "clearance %4")
+            .arg(pair.partA + 1)
+            .arg(pair.partB + 1)
+            .arg(pair.intersectingPairs)
+            .arg(pair.distance);
+    }
+    qInfo().noquote() << QString("Interference: %1 parts checked in %2 ms (BVH build %3 ms)")
+        .arg(parts.size())
+        .arg(result.elapsedMs)
+        .arg(buildMs);
+
+    return result;
+}
+
+bool MeshInterference::trianglesIntersect(const QVector3D& a0, const QVector3D& a1, const QVector3D& a2,
+                                          const QVector3D& b0, const QVector3D& b1, const QVector3D& b2)
+{
+    // A batch of one for the triangle kernel
+    const QVector3D* corners[6] = {&a0, &a1, &a2, &b0, &b1, &b2};
+    float values[6][3];
+    ConstPointsSoA soa[6];
+    for (int k = 0; k < 6; ++k) {
+        for (int axis = 0; axis < 3; ++axis) {
+            values[k][axis] = (*corners[k])[axis];
+        }
+        soa[k] = {&values[k][0], &values[k][1], &values[k][2]};
+    }
+    const ConstPointsSoA cornersA[3] = {soa[0], soa[1], soa[2]};
+    const ConstPointsSoA cornersB[3] = {soa[3], soa[4], soa[5]};
+    bool hit = false;
+    GeometryKernels::trianglesCross(cornersA, cornersB, 1, &hit);
+    return hit;
+}
+
+float MeshInterference::triangleDistanceSquared(const QVector3D& a0, const QVector3D& a1, const QVector3D& a2,
+                                                const QVector3D& b0, const QVector3D& b1, const QVector3D& b2,
+                                                QVector3D& pointA, QVector3D& pointB)
+{
+    // For triangles that do not cross, the closest pair is either a corner
+    // and a face or two edges
+    const QVector3D a[3] = {a0, a1, a2};
+    const QVector3D b[3] = {b0, b1, b2};
+    float best = std::numeric_limits<float>::max();
+
+    for (int i = 0; i < 3; ++i) {
+        const QVector3D onB = TriangleBVH::closestPointOnTriangle(a[i], b0, b1, b2);
+        const float d2 = (a[i] - onB).lengthSquared();
+        if (d2 < best) {
+            best = d2;
+            pointA = a[i];
+            pointB = onB;
+        }
+
+        const QVector3D onA = TriangleBVH::closestPointOnTriangle(b[i], a0, a1, a2);
+        const float e2 = (b[i] - onA).lengthSquared();
+        if (e2 < best) {
+            best = e2;
+            pointA = onA;
+            pointB = b[i];
+        }
+    }
+
+    for (int i = 0; i < 3; ++i) {
+        for (int j = 0; j < 3; ++j) {
+            QVector3D onA;
+            QVector3D onB;
+            const float d2 = segmentDistanceSquared(a[i], a[(i + 1) % 3], b[j], b[(j + 1) % 3], onA, onB);
+            if (d2 < best) {
+                best = d2;
+                pointA = onA;
+                pointB = onB;
+            }
+        }
+    }
+
+    return best;
+}
@@ -0,0 +1,252 @@
+#include "meshorientation.h"
+#include "meshwelder.h"
+#include "meshoverhang.h"
+#include "stlviewer.h"
+#include "parallelfor.h"
+#include <QElapsedTimer>
+#include <QDebug>
+#include <QtMath>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+
+// The histogram pass keeps one histogram per chunk, so its chunks are larger
+const qsizetype kHistogramGrain = 1 << 20;
+
+// Facet normals are binned on a cube map, about 2.8 degrees per bin
+const int kHistogramCells = 32;
+const int kHistogramBins = 6 * kHistogramCells * kHistogramCells;
+
+// Hull faces offered as resting faces; larger hulls are searched on a
+// simplified copy
+const int kCandidateFaces = 256;
+const int kSearchVertices = 4096;
+const int kSearchCells = 32;
+
+// Candidates measured on the full mesh before ranking
+const int kRefined = 8;
+
+// Directions within about a degree are the same candidate
+const float kSameDirection = 0.9998f;
+
+// Hull faces within about 2.5 degrees of straight down rest on the plate,
+// as in MeshOverhang
+const double kPlateCosine = 0.999;
+
+struct NormalBin {
+    double area = 0.0;
+    double x = 0.0; // area-weighted normal sum
+    double y = 0.0;
+    double z = 0.0;
+};
+
+int histogramBin(const QVector3D& n)
+{
+    int axis = 0;
+    for (int k = 1; k < 3; ++k) {
+        if (qAbs(n[k]) > qAbs(n[axis])) axis = k;
+    }
+    const float major = qAbs(n[axis]);
+    const float s = n[(axis + 1) % 3] / major;
+    const float t = n[(axis + 2) % 3] / major;
+    const int i = qBound(0, int((s + 1.0f) * 0.5f * kHistogramCells), kHistogramCells - 1);
+    const int j = qBound(0, int((t + 1.0f) * 0.5f * kHistogramCells), kHistogramCells - 1);
+    return ((axis * 2 + (n[axis] < 0.0f ? 1 : 0)) * kHistogramCells + i) * kHistogramCells + j;
+}
+
+QVector<NormalBin> normalHistogram(const QVector<Triangle>& triangles)
+{
+    const qsizetype count = triangles.size();
+    const qsizetype chunkCount = (count + kHistogramGrain - 1) / kHistogramGrain;
+    QVector<NormalBin> chunkBins(chunkCount * kHistogramBins);
+    parallelFor(count, kHistogramGrain, [&](qsizetype begin, qsizetype end) {
+        NormalBin* bins = chunkBins.data() + (begin / kHistogramGrain) * kHistogramBins;
+        for (qsizetype i = begin; i < end; ++i) {
+            const Triangle& t = triangles[i];
+            const QVector3D cross = QVector3D::crossProduct(t.vertex2 - t.vertex1, t.vertex3 - t.vertex1);
+            const float length = cross.length();
+            if (length == 0.0f) continue;
+            NormalBin& bin = bins[histogramBin(cross / length)];
+            bin.area += 0.5 * length;
+            bin.x += 0.5 * cross.x();
+            bin.y += 0.5 * cross.y();
+            bin.z += 0.5 * cross.z();
+        }
+    });
+
+    QVector<NormalBin> histogram(kHistogramBins);
+    for (qsizetype c = 0; c < chunkCount; ++c) {
+        for (int b = 0; b < kHistogramBins; ++b) {
+            const NormalBin& bin = chunkBins[c * kHistogramBins + b];
+            histogram[b].area += bin.area;
+            histogram[b].x += bin.x;
+            histogram[b].y += bin.y;
+            histogram[b].z += bin.z;
+        }
+    }
+
+    // Only occupied bins matter, each reduced to its mean direction
+    QVector<NormalBin> occupied;
+    for (const NormalBin& bin : std::as_const(histogram)) {
+        const double length = std::sqrt(bin.x * bin.x + bin.y * bin.y + bin.z * bin.z);
+        if (bin.area > 0.0 && length > 0.0) {
+            occupied.append(NormalBin{bin.area, bin.x / length, bin.y / length, bin.z / length});
+        }
+    }
+    return occupied;
+}
+
+double score(const OrientationCandidate& candidate, const OrientationWeights& weights,
+             double maxHeight, double maxSupport, double maxFootprint)
+{
+    return weights.height * (maxHeight > 0.0 ? candidate.height / maxHeight : 0.0)
+         + weights.support * (maxSupport > 0.0 ? candidate.supportArea / maxSupport : 0.0)
+         + weights.footprint * (maxFootprint > 0.0 ? candidate.footprintArea / maxFootprint : 0.0);
+}
+
+} // namespace
+
+OrientationResult MeshOrientation::optimize(const QVector<Triangle>& triangles, float criticalAngle,
+                                            const OrientationWeights& weights)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    OrientationResult result;
+    result.hull = MeshHull::compute(MeshWelder::weld(triangles).positions);
+    result.box = MeshHull::minimalBox(result.hull);
+    if (result.hull.isEmpty()) {
+        result.elapsedMs = timer.elapsed();
+        return result;
+    }
+
+    QVector3D low = result.hull.vertices.first();
+    QVector3D high = low;
+    for (const QVector3D& v : std::as_const(result.hull.vertices)) {
+        for (int axis = 0; axis < 3; ++axis) {
+            low[axis] = qMin(low[axis], v[axis]);
+            high[axis] = qMax(high[axis], v[axis]);
+        }
+    }
+    result.boundsSize = high - low;
+
+    QElapsedTimer searchTimer;
+    searchTimer.start();
+
+    const ConvexHull coarse = result.hull.vertices.size() > kSearchVertices
+                            ? MeshHull::simplified(result.hull, kSearchCells) : result.hull;
+    const QVector<NormalBin> histogram = normalHistogram(triangles);
+
+    // Unit normals and areas of the coarse hull, for the plate contact
+    QVector<QVector3D> faceNormals(coarse.faceCount());
+    QVector<double> faceAreas(coarse.faceCount());
+    for (int f = 0; f < coarse.faceCount(); ++f) {
+        const QVector3D a = coarse.vertices[coarse.indices[3 * f]];
+        const QVector3D cross = QVector3D::crossProduct(coarse.vertices[coarse.indices[3 * f + 1]] - a,
+                                                        coarse.vertices[coarse.indices[3 * f + 2]] - a);
+        faceNormals[f] = cross.normalized();
+        faceAreas[f] = 0.5 * cross.length();
+    }
+
+    // Resting a face on the plate points up away from it
+    QVector<QVector3D> directions;
+    auto addDirection = [&directions](const QVector3D& up) {
+        for (const QVector3D& existing : std::as_const(directions)) {
+            if (QVector3D::dotProduct(existing, up) > kSameDirection) return;
+        }
+        directions.append(up);
+    };
+    for (int axis = 0; axis < 3; ++axis) {
+        addDirection(result.box.axes[axis]);
+        addDirection(-result.box.axes[axis]);
+    }
+    for (const auto& face : MeshHull::faceDirections(coarse, kCandidateFaces)) {
+        addDirection(-face.first);
+    }
+
+    // Support is estimated from the histogram: bins leaning past the critical
+    // angle, less the hull faces that will lie on the plate
+    const double threshold = qSin(qDegreesToRadians(qBound(0.0, double(criticalAngle), 89.0)));
+    QVector<OrientationCandidate> candidates(directions.size());
+    parallelFor(directions.size(), 4, [&](qsizetype begin, qsizetype end) {
+        for (qsizetype i = begin; i < end; ++i) {
+            const QVector3D& up = directions[i];
+            OrientationCandidate& candidate = candidates[i];
+            candidate.up = up;
+
+            double overhang = 0.0;
+            for (const NormalBin& bin : histogram) {
+                if (-(bin.x * up.x() + bin.y * up.y() + bin.z * up.z()) > threshold) {
+                    overhang += bin.area;
+                }
+            }
+            double contact = 0.0;
+            for (qsizetype f = 0; f < faceNormals.size(); ++f) {
+                if (-QVector3D::dotProduct(faceNormals[f], up) > kPlateCosine) {
+                    contact += faceAreas[f];
+                }
+            }
+            candidate.supportArea = qMax(0.0, overhang - contact);
+
+            const Footprint footprint = MeshHull::footprint(coarse, up);
+            candidate.height = footprint.height;
+            candidate.footprintArea = footprint.area;
+        }
+    });
+
+    double maxHeight = 0.0;
+    double maxSupport = 0.0;
+    double maxFootprint = 0.0;
+    for (const OrientationCandidate& candidate : std::as_const(candidates)) {
+        maxHeight = qMax(maxHeight, double(candidate.height));
+        maxSupport = qMax(maxSupport, candidate.supportArea);
+        maxFootprint = qMax(maxFootprint, candidate.footprintArea);
+    }
+    for (OrientationCandidate& candidate : candidates) {
+        candidate.score = score(candidate, weights, maxHeight, maxSupport, maxFootprint);
+    }
+    auto byScore = [](const OrientationCandidate& l, const OrientationCandidate& r) {
+        return l.score < r.score;
+    };
+    std::sort(candidates.begin(), candidates.end(), byScore);
+    result.evaluated = int(candidates.size());
+    candidates.resize(qMin<qsizetype>(candidates.size(), kRefined));
+
+    // The leaders are measured on the full mesh and hull. Scores keep the
+    // coarse maxima so they stay comparable.
+    MeshOverhang overhang;
+    overhang.setMesh(triangles);
+    for (OrientationCandidate& candidate : candidates) {
+        candidate.supportArea = overhang.classify(candidate.up, criticalAngle).overhangArea;
+    }
+    parallelFor(candidates.size(), 1, [&](qsizetype begin, qsizetype) {
+        OrientationCandidate& candidate = candidates[begin];
+        const Footprint footprint = MeshHull::footprint(result.hull, candidate.up);
+        candidate.height = footprint.height;
+        candidate.footprintArea = footprint.area;
+        candidate.score = score(candidate, weights, maxHeight, maxSupport, maxFootprint);
+        if (!footprint.axis.isNull()) {
+            const QVector3D axes[3] = {candidate.up, footprint.axis,
+                                       QVector3D::crossProduct(candidate.up, footprint.axis)};
+            candidate.box = MeshHull::boxAlong(result.hull, axes);
+        }
+    });
+    std::sort(candidates.begin(), candidates.end(), byScore);
+    result.candidates = candidates;
+
+    result.searchMs = searchTimer.elapsed();
+    result.elapsedMs = timer.elapsed();
+
+    const OrientationCandidate& best = result.candidates.first();
+    qInfo().noquote() << QString("Orientation search over %1 directions: best up (%2, %3, %4), "
+                                 "height %5, support %6, footprint %7 in %8 ms (search %9 ms)")
+                             .arg(result.evaluated)
+                             .arg(best.up.x(), 0, 'f', 3).arg(best.up.y(), 0, 'f', 3)
+                             .arg(best.up.z(), 0, 'f', 3)
+                             .arg(best.height, 0, 'g', 5).arg(best.supportArea, 0, 'g', 5)
+                             .arg(best.footprintArea, 0, 'g', 5)
+                             .arg(result.elapsedMs).arg(result.searchMs);
+    return result;
+}
@@ -0,0 +1,168 @@
+#include "meshoverhang.h"
+#include "stlviewer.h"
+#include "stlloader.h"
+#include "geometrykernels.h"
+#include "parallelfor.h"
+#include <QElapsedTimer>
+#include <QtMath>
+#include <limits>
+#include <utility>
+
+namespace {
+
+const qsizetype kGrain = 65536;
+
+// Facets within about 2.5 degrees of facing straight down, no higher than
+// this fraction of the model size above its lowest point, rest on the plate
+const float kPlateCosine = 0.999f;
+const float kPlateTolerance = 1e-4f;
+
+struct ChunkSums {
+    double overhangArea = 0.0;
+    double plateArea = 0.0;
+    qsizetype overhangFacets = 0;
+    float lowest = std::numeric_limits<float>::max();
+};
+
+} // namespace
+
+void MeshOverhang::setMesh(const QVector<Triangle>& triangles)
+{
+    const qsizetype count = triangles.size();
+    m_normalX.resize(count);
+    m_normalY.resize(count);
+    m_normalZ.resize(count);
+    m_areas.resize(count);
+    m_centroidX.resize(count);
+    m_centroidY.resize(count);
+    m_centroidZ.resize(count);
+
+    QVector<double> chunkAreas((count + kGrain - 1) / kGrain, 0.0);
+    parallelFor(count, kGrain, [&](qsizetype begin, qsizetype end) {
+        double area = 0.0;
+        for (qsizetype i = begin; i < end; ++i) {
+            const Triangle& t = triangles[i];
+            // Geometric normals: file normals may be stale or missing
+            const QVector3D cross = QVector3D::crossProduct(t.vertex2 - t.vertex1,
+                                                            t.vertex3 - t.vertex1);
+            const float length = cross.length();
+            const QVector3D normal = length > 0.0f ? cross / length : QVector3D();
+            const QVector3D centroid = (t.vertex1 + t.vertex2 + t.vertex3) / 3.0f;
+            m_normalX[i] = normal.x();
+            m_normalY[i] = normal.y();
+            m_normalZ[i] = normal.z();
+            m_areas[i] = 0.5f * length;
+            m_centroidX[i] = centroid.x();
+            m_centroidY[i] = centroid.y();
+            m_centroidZ[i] = centroid.z();
+            area += m_areas[i];
+        }
+        chunkAreas[begin / kGrain] = area;
+    });
+
+    m_totalArea = 0.0;
+    for (double area : std::as_const(chunkAreas)) {
+        m_totalArea += area;
+    }
+
+    float minBounds[3] = {0.0f, 0.0f, 0.0f};
+    float maxBounds[3] = {0.0f, 0.0f, 0.0f};
+    if (count > 0) {
+        minBounds[0] = maxBounds[0] = m_centroidX[0];
+        minBounds[1] = maxBounds[1] = m_centroidY[0];
+        minBounds[2] = maxBounds[2] = m_centroidZ[0];
+        GeometryKernels::extendBounds({m_centroidX.constData(), m_centroidY.constData(),
+                                       m_centroidZ.constData()}, count, minBounds, maxBounds);
+    }
+    m_size = QVector3D(maxBounds[0] - minBounds[0], maxBounds[1] - minBounds[1],
+                       maxBounds[2] - minBounds[2]).length();
+}
+
+void MeshOverhang::clear()
+{
+    m_normalX = QVector<float>();
+    m_normalY = QVector<float>();
+    m_normalZ = QVector<float>();
+    m_areas = QVector<float>();
+    m_centroidX = QVector<float>();
+    m_centroidY = QVector<float>();
+    m_centroidZ = QVector<float>();
+    m_totalArea = 0.0;
+    m_size = 0.0f;
+}
+
+OverhangResult MeshOverhang::classify(const QVector3D& buildDirection, float criticalAngle) const
+{
+    OverhangResult result;
+    const qsizetype count = m_areas.size();
+    if (count == 0 || buildDirection.isNull()) return result;
+
+    QElapsedTimer timer;
+    timer.start();
+
+    const QVector3D up = buildDirection.normalized();
+    const float down[3] = {-up.x(), -up.y(), -up.z()};
+
+    // The facet leans criticalAngle from vertical when its normal is
+    // 90 - criticalAngle from straight down
+    const float threshold = qSin(qDegreesToRadians(qBound(0.0f, criticalAngle, 89.0f)));
+
+    const ConstPointsSoA normals{m_normalX.constData(), m_normalY.constData(),
+                                 m_normalZ.constData()};
+    QVector<float> facing(count);
+    QVector<float> heights(count);
+    QVector<ChunkSums> chunks((count + kGrain - 1) / kGrain);
+
+    // Pass 1: facing cosines and the area facing down past the threshold in
+    // one vectorized reduction, plus the lowest centroid for plate contact
+    parallelFor(count, kGrain, [&](qsizetype begin, qsizetype end) {
+        ChunkSums& chunk = chunks[begin / kGrain];
+        const ConstPointsSoA n{normals.x + begin, normals.y + begin, normals.z + begin};
+        chunk.overhangArea = GeometryKernels::facingWeight(n, m_areas.constData() + begin,
+                                                           end - begin, down, threshold,
+                                                           facing.data() + begin);
+        for (qsizetype i = begin; i < end; ++i) {
+            heights[i] = m_centroidX[i] * up.x() + m_centroidY[i] * up.y() + m_centroidZ[i] * up.z();
+            chunk.lowest = qMin(chunk.lowest, heights[i]);
+        }
+    });
+
+    float lowest = std::numeric_limits<float>::max();
+    for (const ChunkSums& chunk : std::as_const(chunks)) {
+        lowest = qMin(lowest, chunk.lowest);
+    }
+    const float plateHeight = lowest + kPlateTolerance * m_size;
+
+    // Pass 2: colors, and the plate facets moved out of the overhang area
+    result.facetColors.resize(count);
+    const quint16 plateColor = STLLoader::packFacetColor(6, 14, 31);
+    parallelFor(count, kGrain, [&](qsizetype begin, qsizetype end) {
+        ChunkSums& chunk = chunks[begin / kGrain];
+        for (qsizetype i = begin; i < end; ++i) {
+            const float cosine = facing[i];
+            quint16 color = 0;
+            if (cosine > threshold) {
+                if (cosine > kPlateCosine && heights[i] <= plateHeight) {
+                    chunk.overhangArea -= m_areas[i];
+                    chunk.plateArea += m_areas[i];
+                    color = plateColor;
+                } else {
+                    // Yellow at the critical angle to red facing straight down
+                    const float severity = qBound(0.0f, (cosine - threshold) / (1.0f - threshold), 1.0f);
+                    color = STLLoader::packFacetColor(31, quint16(qRound(31.0f * (1.0f - severity))), 0);
+                    ++chunk.overhangFacets;
+                }
+            }
+            result.facetColors[i] = color;
+        }
+    });
+
+    for (const ChunkSums& chunk : std::as_const(chunks)) {
+        result.overhangArea += chunk.overhangArea;
+        result.plateArea += chunk.plateArea;
+        result.overhangFacets += chunk.overhangFacets;
+    }
+    result.totalArea = m_totalArea;
+    result.elapsedMs = timer.nsecsElapsed() / 1e6;
+    return result;
+}
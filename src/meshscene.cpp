@@ -0,0 +1,1100 @@
+#include "meshscene.h"
+#include "stlloader.h"
+#include "geometrykernels.h"
+#include "meshvoxelizer.h"
+#include "meshhull.h"
+#include <QOpenGLContext>
+#include <QOpenGLExtraFunctions>
+#include <QOffscreenSurface>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QLocale>
+#include <algorithm>
+#include <limits>
+
+namespace {
+// Facets expanded per staging pass while streaming geometry to the GPU
+constexpr qsizetype kUploadChunkFacets = 65536;
+
+// QOpenGLBuffer::allocate takes an int byte count
+constexpr qsizetype kMaxBufferBytes = std::numeric_limits<int>::max();
+
+qsizetype geometryBufferBytes(qsizetype facetCount)
+{
+    return facetCount * 3 * qsizetype(sizeof(QVector3D));
+}
+}
+
+MeshScene::MeshScene(QObject *parent)
+    : QObject(parent)
+    , m_context(nullptr)
+    , m_surface(nullptr)
+    , m_shaderProgram(nullptr)
+    , m_facetColorTexture(0)
+    , m_overlayTexture(0)
+    , m_voxelColorTexture(0)
+    , m_shapeColorTexture(0)
+    , m_attributeRevision(0)
+    , m_voxelRevision(0)
+    , m_shapeRevision(0)
+    , m_hasFacetColors(false)
+    , m_vertexCount(0)
+    , m_hasScalars(false)
+    , m_scalarRange(1.0f)
+    , m_hasOverlay(false)
+    , m_voxelVertexCount(0)
+    , m_hasVoxelColors(false)
+    , m_showVoxels(false)
+    , m_shapeVertexCount(0)
+    , m_hasShapeColors(false)
+    , m_memoryMode(MemoryMode::Compact)
+    , m_modelScale(1.0f)
+    , m_modelLoaded(false)
+    , m_lastLoadFailure(LoadFailure::None)
+{
+}
+
+MeshScene::~MeshScene()
+{
+    if (m_context && makeCurrent()) {
+        m_vertexBuffer.destroy();
+        m_normalBuffer.destroy();
+        m_scalarBuffer.destroy();
+        m_facetColorBuffer.destroy();
+        m_overlayBuffer.destroy();
+        m_indexBuffer.destroy();
+        m_voxelVertexBuffer.destroy();
+        m_voxelNormalBuffer.destroy();
+        m_voxelColorBuffer.destroy();
+        m_shapeVertexBuffer.destroy();
+        m_shapeNormalBuffer.destroy();
+        m_shapeColorBuffer.destroy();
+        if (m_facetColorTexture) {
+            m_context->functions()->glDeleteTextures(1, &m_facetColorTexture);
+        }
+        if (m_overlayTexture) {
+            m_context->functions()->glDeleteTextures(1, &m_overlayTexture);
+        }
+        if (m_voxelColorTexture) {
+            m_context->functions()->glDeleteTextures(1, &m_voxelColorTexture);
+        }
+        if (m_shapeColorTexture) {
+            m_context->functions()->glDeleteTextures(1, &m_shapeColorTexture);
+        }
+        delete m_shaderProgram;
+        doneCurrent();
+    }
+    
+    for (const ContextVao& entry : std::as_const(m_vaos)) {
+        delete entry.vao;
+        delete entry.voxelVao;
+        delete entry.shapeVao;
+    }
+}
+
+bool MeshScene::makeCurrent()
+{
+    if (m_context) {
+        return m_context->makeCurrent(m_surface);
+    }
+    
+    // Share with every QOpenGLWidget through the global share context
+    m_context = new QOpenGLContext(this);
+    m_context->setShareContext(QOpenGLContext::globalShareContext());
+    m_context->setFormat(QSurfaceFormat::defaultFormat());
+    if (!m_context->create()) {
+        qWarning() << "Could not create the scene's OpenGL context";
+        delete m_context;
+        m_context = nullptr;
+        return false;
+    }
+    
+    m_surface = new QOffscreenSurface(nullptr, this);
+    m_surface->setFormat(m_context->format());
+    m_surface->create();
+    
+    if (!m_context->makeCurrent(m_surface)) {
+        return false;
+    }
+    
+    setupShaders();
+    setupBuffers();
+    return true;
+}
+
+void MeshScene::doneCurrent()
+{
+    // Other contexts in the group only see finished uploads
+    m_context->functions()->glFinish();
+    m_context->doneCurrent();
+}
+
+void MeshScene::setupShaders()
+{
+    m_shaderProgram = new QOpenGLShaderProgram(this);
+    
+    // Vertex shader
+    const char* vertexShaderSource = R"(
+        #version 330 core
+        layout (location = 0) in vec3 aPos;
+        layout (location = 1) in vec3 aNormal;
+        layout (location = 2) in float aScalar;
+        
+        uniform mat4 model;
+        uniform mat4 view;
+        uniform mat4 projection;
+        
+        out vec3 FragPos;
+        out vec3 Normal;
+        out float Scalar;
+        flat out int FacetId;
+        
+        void main()
+        {
+            FragPos = vec3(model * vec4(aPos, 1.0));
+            Scalar = aScalar;
+            // Three vertices per facet, so this is the facet's index in the file
+            FacetId = gl_VertexID / 3;
+            Normal = mat3(transpose(inverse(model))) * aNormal;
+            
+            gl_Position = projection * view * vec4(FragPos, 1.0);
+        }
+    )";
+    
+    // Fragment shader
+    const char* fragmentShaderSource = R"(
+        #version 330 core
+        out vec4 FragColor;
+        
+        in vec3 FragPos;
+        in vec3 Normal;
+        in float Scalar;
+        flat in int FacetId;
+        
+        uniform vec3 lightPos;
+        uniform vec3 lightColor;
+        uniform vec3 objectColor;
+        uniform vec3 viewPos;
+        uniform bool useScalars;
+        uniform float scalarRange;
+        uniform bool useFacetColors;
+        uniform usamplerBuffer facetColors;
+        uniform bool useOverlay;
+        uniform usamplerBuffer overlayColors;
+        uniform float opacity;
+        
+        // Diverging map: blue below zero, green at zero, red above
+        vec3 scalarColor(float value)
+        {
+            float t = clamp(value / scalarRange, -1.0, 1.0);
+            vec3 zero = vec3(0.1, 0.8, 0.2);
+            return t < 0.0 ? mix(zero, vec3(0.1, 0.2, 1.0), -t)
+                           : mix(zero, vec3(1.0, 0.1, 0.1), t);
+        }
+        
+        void main()
+        {
+            // Ambient
+            float ambientStrength = 0.3;
+            vec3 ambient = ambientStrength * lightColor;
+            
+            // Diffuse
+            vec3 norm = normalize(Normal);
+            vec3 lightDir = normalize(lightPos - FragPos);
+            float diff = max(dot(norm, lightDir), 0.0);
+            vec3 diffuse = diff * lightColor;
+            
+            // Specular
+            float specularStrength = 0.5;
+            vec3 viewDir = normalize(viewPos - FragPos);
+            vec3 reflectDir = reflect(-lightDir, norm);
+            float spec = pow(max(dot(viewDir, reflectDir), 0.0), 32);
+            vec3 specular = specularStrength * spec * lightColor;
+            
+            vec3 baseColor = objectColor;
+            if (useFacetColors) {
+                // 5-bit RGB, bit 15 set when the facet has its own color
+                uint packed = texelFetch(facetColors, FacetId).r;
+                if ((packed & 0x8000u) != 0u) {
+                    baseColor = vec3(uvec3(packed, packed >> 5, packed >> 10) & 31u) / 31.0;
+                }
+            }
+            if (useOverlay) {
+                uint packed = texelFetch(overlayColors, FacetId).r;
+                if ((packed & 0x8000u) != 0u) {
+                    baseColor = vec3(uvec3(packed, packed >> 5, packed >> 10) & 31u) / 31.0;
+                }
+            }
+            if (useScalars) {
+                baseColor = scalarColor(Scalar);
+            }
+            vec3 result = (ambient + diffuse + specular) * baseColor;
+            FragColor = vec4(result, opacity);
+        }
+    )";
+    
+    // Cacheable sources let Qt reuse the linked program binary from its disk
+    // cache on later runs instead of compiling again
+    m_shaderProgram->addCacheableShaderFromSourceCode(QOpenGLShader::Vertex, vertexShaderSource);
+    m_shaderProgram->addCacheableShaderFromSourceCode(QOpenGLShader::Fragment, fragmentShaderSource);
+    
+    if (!m_shaderProgram->link()) {
+        qDebug() << "Shader program linking failed:" << m_shaderProgram->log();
+    }
+}
+
+void MeshScene::setupBuffers()
+{
+    m_vertexBuffer.create();
+    m_vertexBuffer.setUsagePattern(QOpenGLBuffer::StaticDraw);
+    
+    m_normalBuffer.create();
+    m_normalBuffer.setUsagePattern(QOpenGLBuffer::StaticDraw);
+    
+    m_scalarBuffer.create();
+    m_scalarBuffer.setUsagePattern(QOpenGLBuffer::StaticDraw);
+    
+    // Per-facet colors are fetched by facet index from a buffer texture, so
+    // they cost two bytes per facet rather than a copy per vertex
+    m_facetColorBuffer.create();
+    m_facetColorBuffer.setUsagePattern(QOpenGLBuffer::StaticDraw);
+    m_context->functions()->glGenTextures(1, &m_facetColorTexture);
+    
+    // Analysis colors get their own buffer texture, so they can be swapped
+    // without losing the file's colors
+    m_overlayBuffer.create();
+    m_overlayBuffer.setUsagePattern(QOpenGLBuffer::DynamicDraw);
+    m_context->functions()->glGenTextures(1, &m_overlayTexture);
+    
+    // Written through the array buffer target, since the scene's context
+    // has no vertex array object to hold an element array binding
+    m_indexBuffer.create();
+    m_indexBuffer.setUsagePattern(QOpenGLBuffer::StaticDraw);
+    
+    m_voxelVertexBuffer.create();
+    m_voxelVertexBuffer.setUsagePattern(QOpenGLBuffer::StaticDraw);
+    m_voxelNormalBuffer.create();
+    m_voxelNormalBuffer.setUsagePattern(QOpenGLBuffer::StaticDraw);
+    m_voxelColorBuffer.create();
+    m_voxelColorBuffer.setUsagePattern(QOpenGLBuffer::StaticDraw);
+    m_context->functions()->glGenTextures(1, &m_voxelColorTexture);
+    
+    m_shapeVertexBuffer.create();
+    m_shapeVertexBuffer.setUsagePattern(QOpenGLBuffer::DynamicDraw);
+    m_shapeNormalBuffer.create();
+    m_shapeNormalBuffer.setUsagePattern(QOpenGLBuffer::DynamicDraw);
+    m_shapeColorBuffer.create();
+    m_shapeColorBuffer.setUsagePattern(QOpenGLBuffer::DynamicDraw);
+    m_context->functions()->glGenTextures(1, &m_shapeColorTexture);
+}
+
+bool MeshScene::loadSTL(const QString& filename)
+{
+    return loadParsed(parse(filename));
+}
+
+ParsedMesh MeshScene::parse(const QString& filename)
+{
+    QElapsedTimer timer;
+    timer.start();
+    
+    ParsedMesh mesh;
+    mesh.filename = filename;
+    mesh.triangles = STLLoader::loadSTL(filename, mesh.error, &mesh.facetColors);
+    if (mesh.error.isEmpty() && mesh.triangles.isEmpty()) {
+        mesh.error = "No triangles found in STL file";
+    }
+    mesh.parseMs = timer.elapsed();
+    return mesh;
+}
+
+bool MeshScene::initialize()
+{
+    if (!makeCurrent()) {
+        return false;
+    }
+    m_context->doneCurrent();
+    return true;
+}
+
+bool MeshScene::loadParsed(ParsedMesh mesh)
+{
+    if (!mesh.error.isEmpty()) {
+        m_lastLoadFailure = LoadFailure::File;
+        emit loadError(mesh.error);
+        return false;
+    }
+    
+    // Checked before any state is replaced, so the current model survives
+    if (geometryBufferBytes(mesh.triangles.size()) > kMaxBufferBytes) {
+        m_lastLoadFailure = LoadFailure::TooLarge;
+        emit loadError(QString("%1 has %2 facets; at most %3 fit in one OpenGL buffer")
+                           .arg(mesh.filename)
+                           .arg(QLocale().toString(qlonglong(mesh.triangles.size())))
+                           .arg(QLocale().toString(qlonglong(kMaxBufferBytes / geometryBufferBytes(1)))));
+        return false;
+    }
+    
+    if (!makeCurrent()) {
+        m_lastLoadFailure = LoadFailure::NoContext;
+        emit loadError("OpenGL context is not available");
+        return false;
+    }
+    
+    QElapsedTimer timer;
+    timer.start();
+    
+    const QString filename = mesh.filename;
+    m_triangles = std::move(mesh.triangles);
+    m_facetColors = std::move(mesh.facetColors);
+    
+    // Bounds first so centering can be folded into the single upload pass
+    calculateBoundingBox();
+    
+    uploadGeometry();
+    uploadFacetColors();
+    
+    // Per-corner values, overlays and components belong to the previous
+    // geometry
+    m_scalarBuffer.bind();
+    m_scalarBuffer.allocate(0);
+    m_scalarBuffer.release();
+    m_hasScalars = false;
+    m_overlayBuffer.bind();
+    m_overlayBuffer.allocate(0);
+    m_overlayBuffer.release();
+    m_hasOverlay = false;
+    m_indexBuffer.bind();
+    m_indexBuffer.allocate(0);
+    m_indexBuffer.release();
+    m_segmentation = Segmentation();
+    m_componentVisible.clear();
+    m_drawRanges.clear();
+    m_voxelVertexBuffer.bind();
+    m_voxelVertexBuffer.allocate(0);
+    m_voxelNormalBuffer.bind();
+    m_voxelNormalBuffer.allocate(0);
+    m_voxelNormalBuffer.release();
+    uploadPackedColors(m_voxelColorBuffer, m_voxelColorTexture, QVector<quint16>());
+    m_voxelVertexCount = 0;
+    m_hasVoxelColors = false;
+    ++m_voxelRevision;
+    m_shapeVertexBuffer.bind();
+    m_shapeVertexBuffer.allocate(0);
+    m_shapeNormalBuffer.bind();
+    m_shapeNormalBuffer.allocate(0);
+    m_shapeNormalBuffer.release();
+    uploadPackedColors(m_shapeColorBuffer, m_shapeColorTexture, QVector<quint16>());
+    m_shapeVertexCount = 0;
+    m_hasShapeColors = false;
+    ++m_shapeRevision;
+    
+    doneCurrent();
+    
+    const int triangleCount = m_vertexCount / 3;
+    releaseCpuCopies();
+    
+    m_modelLoaded = true;
+    m_currentFile = filename;
+    
+    qInfo().noquote() << QString("Loaded %1: parsed in %2 ms, uploaded in %3 ms")
+                             .arg(filename).arg(mesh.parseMs).arg(timer.elapsed());
+    logMemoryUsage();
+    emit memoryUsageChanged();
+    m_lastLoadFailure = LoadFailure::None;
+    emit modelLoaded(filename, triangleCount);
+    emit changed();
+    return true;
+}
+
+void MeshScene::calculateBoundingBox()
+{
+    if (m_triangles.isEmpty()) return;
+    
+    float minBounds[3];
+    float maxBounds[3];
+    std::fill(minBounds, minBounds + 3, std::numeric_limits<float>::max());
+    std::fill(maxBounds, maxBounds + 3, std::numeric_limits<float>::lowest());
+    
+    // Corners are gathered into structure-of-arrays blocks for the kernel
+    PointBlock block;
+    qsizetype filled = 0;
+    for (const Triangle& triangle : m_triangles) {
+        if (filled + 3 > PointBlock::kSize) {
+            GeometryKernels::extendBounds(block.constPoints(), filled, minBounds, maxBounds);
+            filled = 0;
+        }
+        block.set(filled++, triangle.vertex1.x(), triangle.vertex1.y(), triangle.vertex1.z());
+        block.set(filled++, triangle.vertex2.x(), triangle.vertex2.y(), triangle.vertex2.z());
+        block.set(filled++, triangle.vertex3.x(), triangle.vertex3.y(), triangle.vertex3.z());
+    }
+    GeometryKernels::extendBounds(block.constPoints(), filled, minBounds, maxBounds);
+    
+    m_minBounds = QVector3D(minBounds[0], minBounds[1], minBounds[2]);
+    m_maxBounds = QVector3D(maxBounds[0], maxBounds[1], maxBounds[2]);
+    
+    m_center = (m_minBounds + m_maxBounds) * 0.5f;
+    
+    QVector3D size = m_maxBounds - m_minBounds;
+    float maxSize = qMax(qMax(size.x(), size.y()), size.z());
+    m_modelScale = maxSize > 0 ? 2.0f / maxSize : 1.0f;
+}
+
+void MeshScene::uploadGeometry()
+{
+    // Expects a current context. Vertices are centered as they are expanded,
+    // so the buffers are written exactly once per load.
+    const qsizetype facetCount = m_triangles.size();
+    const bool keepExpanded = m_memoryMode == MemoryMode::FullCopies;
+    const qsizetype bufferBytes = geometryBufferBytes(facetCount);
+    Q_ASSERT(bufferBytes <= kMaxBufferBytes);
+    
+    m_vertexCount = int(facetCount * 3);
+    m_vertices.clear();
+    m_normals.clear();
+    if (keepExpanded) {
+        m_vertices.reserve(m_vertexCount);
+        m_normals.reserve(m_vertexCount);
+    }
+    
+    m_vertexBuffer.bind();
+    m_vertexBuffer.allocate(int(bufferBytes));
+    m_normalBuffer.bind();
+    m_normalBuffer.allocate(int(bufferBytes));
+    
+    // Stream through a bounded staging area instead of building the full
+    // expanded arrays when they are not going to be kept
+    QVector<QVector3D> vertexChunk;
+    QVector<QVector3D> normalChunk;
+    vertexChunk.reserve(qMin(facetCount, kUploadChunkFacets) * 3);
+    normalChunk.reserve(qMin(facetCount, kUploadChunkFacets) * 3);
+    
+    const float centerOffset[3] = {-m_center.x(), -m_center.y(), -m_center.z()};
+    const qsizetype blockCorners = PointBlock::kSize - PointBlock::kSize % 3;
+    PointBlock block;
+    
+    for (qsizetype begin = 0; begin < facetCount; begin += kUploadChunkFacets) {
+        const qsizetype end = qMin(begin + kUploadChunkFacets, facetCount);
+        vertexChunk.resize((end - begin) * 3);
+        normalChunk.clear();
+        
+        for (qsizetype i = begin; i < end; ++i) {
+            const Triangle& triangle = m_triangles[i];
+            normalChunk.append(triangle.normal);
+            normalChunk.append(triangle.normal);
+            normalChunk.append(triangle.normal);
+        }
+        
+        // Center whole facets a block at a time with the translate kernel
+        for (qsizetype corner = 0; corner < vertexChunk.size(); corner += blockCorners) {
+            const qsizetype count = qMin(blockCorners, vertexChunk.size() - corner);
+            for (qsizetype k = 0; k < count; k += 3) {
+                const Triangle& triangle = m_triangles[begin + (corner + k) / 3];
+                block.set(k, triangle.vertex1.x(), triangle.vertex1.y(), triangle.vertex1.z());
+                block.set(k + 1, triangle.vertex2.x(), triangle.vertex2.y(), triangle.vertex2.z());
+                block.set(k + 2, triangle.vertex3.x(), triangle.vertex3.y(), triangle.vertex3.z());
+            }
+            GeometryKernels::translateScale(block.points(), count, centerOffset, 1.0f);
+            for (qsizetype k = 0; k < count; ++k) {
+                vertexChunk[corner + k] = QVector3D(block.x[k], block.y[k], block.z[k]);
+            }
+        }
+        
+        const int offset = int(begin * 3 * sizeof(QVector3D));
+        const int bytes = int(vertexChunk.size() * sizeof(QVector3D));
+        m_vertexBuffer.bind();
+        m_vertexBuffer.write(offset, vertexChunk.constData(), bytes);
+        m_normalBuffer.bind();
+        m_normalBuffer.write(offset, normalChunk.constData(), bytes);
+        
+        if (keepExpanded) {
+            m_vertices.append(vertexChunk);
+            m_normals.append(normalChunk);
+        }
+    }
+    
+    m_normalBuffer.release();
+    ++m_attributeRevision;
+}
+
+void MeshScene::uploadFacetColors()
+{
+    // Expects a current context
+    m_hasFacetColors = uploadPackedColors(m_facetColorBuffer, m_facetColorTexture, m_facetColors);
+}
+
+bool MeshScene::uploadPackedColors(QOpenGLBuffer& buffer, GLuint texture,
+                                   const QVector<quint16>& colors)
+{
+    // Expects a current context; returns whether the colors can be drawn
+    QOpenGLExtraFunctions* f = m_context->extraFunctions();
+    bool usable = false;
+    
+    GLint maxTexels = 0;
+    f->glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTexels);
+    if (colors.size() > maxTexels) {
+        qWarning() << "Facet colors exceed the buffer texture limit of" << maxTexels
+                   << "texels; using the object color";
+    } else if (!colors.isEmpty()) {
+        usable = true;
+    }
+    
+    buffer.bind();
+    if (usable) {
+        buffer.allocate(colors.constData(), int(colors.size() * sizeof(quint16)));
+    } else {
+        buffer.allocate(0);
+    }
+    buffer.release();
+    
+    f->glBindTexture(GL_TEXTURE_BUFFER, texture);
+    f->glTexBuffer(GL_TEXTURE_BUFFER, GL_R16UI, buffer.bufferId());
+    f->glBindTexture(GL_TEXTURE_BUFFER, 0);
+    return usable;
+}
+
+void MeshScene::releaseCpuCopies()
+{
+    if (m_memoryMode != MemoryMode::FullCopies) {
+        m_vertices = QVector<QVector3D>();
+        m_normals = QVector<QVector3D>();
+    }
+    if (m_memoryMode == MemoryMode::GpuResident) {
+        m_triangles = QVector<Triangle>();
+        m_facetColors = QVector<quint16>();
+    }
+}
+
+void MeshScene::setMemoryMode(MemoryMode mode)
+{
+    if (m_memoryMode == mode) return;
+    m_memoryMode = mode;
+    
+    // Dropping copies takes effect immediately; copies that were already
+    // released only come back with the next load.
+    releaseCpuCopies();
+    
+    if (m_modelLoaded) {
+        logMemoryUsage();
+    }
+    emit memoryUsageChanged();
+}
+
+MemoryUsage MeshScene::memoryUsage() const
+{
+    MemoryUsage usage;
+    usage.triangles = qint64(m_triangles.capacity()) * qint64(sizeof(Triangle));
+    usage.vertices = qint64(m_vertices.capacity()) * qint64(sizeof(QVector3D));
+    usage.normals = qint64(m_normals.capacity()) * qint64(sizeof(QVector3D));
+    usage.facetColors = qint64(m_facetColors.capacity()) * qint64(sizeof(quint16));
+    usage.components = (qint64(m_segmentation.facetComponent.capacity())
+                        + qint64(m_segmentation.facetOrder.capacity())) * qint64(sizeof(quint32))
+                       + qint64(m_segmentation.components.capacity()) * qint64(sizeof(MeshComponent));
+    
+    if (m_modelLoaded) {
+        usage.gpuVertices = qint64(m_vertexCount) * qint64(sizeof(QVector3D));
+        usage.gpuNormals = qint64(m_vertexCount) * qint64(sizeof(QVector3D));
+    }
+    if (m_hasFacetColors) {
+        usage.gpuFacetColors = qint64(m_vertexCount / 3) * qint64(sizeof(quint16));
+    }
+    if (m_hasScalars) {
+        usage.gpuScalars = qint64(m_vertexCount) * qint64(sizeof(float));
+    }
+    if (m_hasOverlay) {
+        usage.gpuOverlay = qint64(m_vertexCount / 3) * qint64(sizeof(quint16));
+    }
+    if (!m_segmentation.components.isEmpty()) {
+        usage.gpuIndices = qint64(m_vertexCount) * qint64(sizeof(quint32));
+    }
+    usage.gpuVoxels = qint64(m_voxelVertexCount) * qint64(2 * sizeof(QVector3D));
+    if (m_hasVoxelColors) {
+        usage.gpuVoxels += qint64(m_voxelVertexCount / 3) * qint64(sizeof(quint16));
+    }
+    usage.gpuShapes = qint64(m_shapeVertexCount) * qint64(2 * sizeof(QVector3D));
+    if (m_hasShapeColors) {
+        usage.gpuShapes += qint64(m_shapeVertexCount / 3) * qint64(sizeof(quint16));
+    }
+    return usage;
+}
+
+void MeshScene::setVertexScalars(const QVector<float>& cornerValues, float range)
+{
+    if (!m_modelLoaded || cornerValues.size() != m_vertexCount) {
+        qWarning() << "Ignoring vertex scalars that do not match the loaded model";
+        return;
+    }
+    
+    if (!makeCurrent()) return;
+    m_scalarBuffer.bind();
+    m_scalarBuffer.allocate(cornerValues.constData(), int(cornerValues.size() * sizeof(float)));
+    m_scalarBuffer.release();
+    doneCurrent();
+    
+    m_hasScalars = true;
+    m_scalarRange = range > 0.0f ? range : 1.0f;
+    ++m_attributeRevision;
+    
+    emit memoryUsageChanged();
+    emit changed();
+}
+
+void MeshScene::clearVertexScalars()
+{
+    if (!m_hasScalars) return;
+    
+    if (!makeCurrent()) return;
+    m_scalarBuffer.bind();
+    m_scalarBuffer.allocate(0);
+    m_scalarBuffer.release();
+    doneCurrent();
+    
+    m_hasScalars = false;
+    ++m_attributeRevision;
+    
+    emit memoryUsageChanged();
+    emit changed();
+}
+
+void MeshScene::setFacetOverlay(const QVector<quint16>& colors)
+{
+    if (!m_modelLoaded || colors.size() != m_vertexCount / 3) {
+        qWarning() << "Ignoring a facet overlay that does not match the loaded model";
+        return;
+    }
+    
+    if (!makeCurrent()) return;
+    const int bytes = int(colors.size() * sizeof(quint16));
+    if (m_hasOverlay && m_overlayBuffer.size() == bytes) {
+        // Interactive analyses replace the overlay on every change; rewrite
+        // the storage in place and keep the texture attachment
+        m_overlayBuffer.bind();
+        m_overlayBuffer.write(0, colors.constData(), bytes);
+        m_overlayBuffer.release();
+    } else {
+        m_hasOverlay = uploadPackedColors(m_overlayBuffer, m_overlayTexture, colors);
+    }
+    doneCurrent();
+    
+    emit memoryUsageChanged();
+    emit changed();
+}
+
+void MeshScene::clearFacetOverlay()
+{
+    if (!m_hasOverlay) return;
+    
+    if (!makeCurrent()) return;
+    m_overlayBuffer.bind();
+    m_overlayBuffer.allocate(0);
+    m_overlayBuffer.release();
+    doneCurrent();
+    
+    m_hasOverlay = false;
+    
+    emit memoryUsageChanged();
+    emit changed();
+}
+
+void MeshScene::setComponents(const Segmentation& segmentation)
+{
+    if (!m_modelLoaded || segmentation.facetOrder.size() != m_vertexCount / 3) {
+        qWarning() << "Ignoring components that do not match the loaded model";
+        return;
+    }
+    
+    if (!makeCurrent()) return;
+    
+    // Three vertex indices per facet, streamed like the geometry
+    const qsizetype facetCount = segmentation.facetOrder.size();
+    m_indexBuffer.bind();
+    m_indexBuffer.allocate(int(facetCount * 3 * sizeof(quint32)));
+    
+    QVector<quint32> chunk;
+    chunk.reserve(qMin(facetCount, kUploadChunkFacets) * 3);
+    for (qsizetype begin = 0; begin < facetCount; begin += kUploadChunkFacets) {
+        const qsizetype end = qMin(begin + kUploadChunkFacets, facetCount);
+        chunk.clear();
+        for (qsizetype i = begin; i < end; ++i) {
+            const quint32 facet = segmentation.facetOrder[i];
+            chunk.append(facet * 3);
+            chunk.append(facet * 3 + 1);
+            chunk.append(facet * 3 + 2);
+        }
+        m_indexBuffer.write(int(begin * 3 * sizeof(quint32)), chunk.constData(),
+                            int(chunk.size() * sizeof(quint32)));
+    }
+    m_indexBuffer.release();
+    doneCurrent();
+    
+    m_segmentation = segmentation;
+    m_componentVisible.fill(true, segmentation.components.size());
+    updateDrawRanges();
+    ++m_attributeRevision;
+    
+    emit memoryUsageChanged();
+    emit changed();
+}
+
+void MeshScene::clearComponents()
+{
+    if (m_segmentation.components.isEmpty()) return;
+    
+    if (!makeCurrent()) return;
+    m_indexBuffer.bind();
+    m_indexBuffer.allocate(0);
+    m_indexBuffer.release();
+    doneCurrent();
+    
+    m_segmentation = Segmentation();
+    m_componentVisible.clear();
+    m_drawRanges.clear();
+    ++m_attributeRevision;
+    
+    emit memoryUsageChanged();
+    emit changed();
+}
+
+void MeshScene::setComponentVisible(int component, bool visible)
+{
+    if (component < 0 || component >= m_componentVisible.size()) return;
+    if (m_componentVisible[component] == visible) return;
+    
+    m_componentVisible[component] = visible;
+    updateDrawRanges();
+    emit changed();
+}
+
+void MeshScene::setComponentsVisible(const QVector<bool>& visible)
+{
+    if (visible.size() != m_componentVisible.size()) return;
+    
+    m_componentVisible = visible;
+    updateDrawRanges();
+    emit changed();
+}
+
+void MeshScene::setVoxelSurface(const VoxelSurface& surface)
+{
+    if (!m_modelLoaded) return;
+    
+    if (!makeCurrent()) return;
+    
+    // Centered like the model so both draw with the same matrices
+    QVector<QVector3D> vertices(surface.vertices.size());
+    for (qsizetype i = 0; i < vertices.size(); ++i) {
+        vertices[i] = surface.vertices[i] - m_center;
+    }
+    const int bytes = int(vertices.size() * sizeof(QVector3D));
+    m_voxelVertexBuffer.bind();
+    m_voxelVertexBuffer.allocate(vertices.constData(), bytes);
+    m_voxelNormalBuffer.bind();
+    m_voxelNormalBuffer.allocate(surface.normals.constData(), bytes);
+    m_voxelNormalBuffer.release();
+    m_hasVoxelColors = uploadPackedColors(m_voxelColorBuffer, m_voxelColorTexture, surface.faceColors);
+    doneCurrent();
+    
+    m_voxelVertexCount = int(vertices.size());
+    ++m_voxelRevision;
+    
+    emit memoryUsageChanged();
+    emit changed();
+}
+
+void MeshScene::clearVoxelSurface()
+{
+    if (m_voxelVertexCount == 0) return;
+    
+    if (!makeCurrent()) return;
+    m_voxelVertexBuffer.bind();
+    m_voxelVertexBuffer.allocate(0);
+    m_voxelNormalBuffer.bind();
+    m_voxelNormalBuffer.allocate(0);
+    m_voxelNormalBuffer.release();
+    uploadPackedColors(m_voxelColorBuffer, m_voxelColorTexture, QVector<quint16>());
+    doneCurrent();
+    
+    m_voxelVertexCount = 0;
+    m_hasVoxelColors = false;
+    ++m_voxelRevision;
+    
+    emit memoryUsageChanged();
+    emit changed();
+}
+
+void MeshScene::setVoxelsShown(bool shown)
+{
+    if (m_showVoxels == shown) return;
+    m_showVoxels = shown;
+    emit changed();
+}
+
+void MeshScene::setShapeSurface(const ShapeSurface& surface)
+{
+    if (!m_modelLoaded) return;
+    
+    if (!makeCurrent()) return;
+    
+    QVector<QVector3D> vertices(surface.vertices.size());
+    for (qsizetype i = 0; i < vertices.size(); ++i) {
+        vertices[i] = surface.vertices[i] - m_center;
+    }
+    const int bytes = int(vertices.size() * sizeof(QVector3D));
+    m_shapeVertexBuffer.bind();
+    m_shapeVertexBuffer.allocate(vertices.constData(), bytes);
+    m_shapeNormalBuffer.bind();
+    m_shapeNormalBuffer.allocate(surface.normals.constData(), bytes);
+    m_shapeNormalBuffer.release();
+    m_hasShapeColors = uploadPackedColors(m_shapeColorBuffer, m_shapeColorTexture, surface.faceColors);
+    doneCurrent();
+    
+    m_shapeVertexCount = int(vertices.size());
+    ++m_shapeRevision;
+    
+    emit memoryUsageChanged();
+    emit changed();
+}
+
+void MeshScene::clearShapeSurface()
+{
+    if (m_shapeVertexCount == 0) return;
+    
+    if (!makeCurrent()) return;
+    m_shapeVertexBuffer.bind();
+    m_shapeVertexBuffer.allocate(0);
+    m_shapeNormalBuffer.bind();
+    m_shapeNormalBuffer.allocate(0);
+    m_shapeNormalBuffer.release();
+    uploadPackedColors(m_shapeColorBuffer, m_shapeColorTexture, QVector<quint16>());
+    doneCurrent();
+    
+    m_shapeVertexCount = 0;
+    m_hasShapeColors = false;
+    ++m_shapeRevision;
+    
+    emit memoryUsageChanged();
+    emit changed();
+}
+
+void MeshScene::updateDrawRanges()
+{
+    // Visible neighbours in facetOrder merge into one draw call
+    m_drawRanges.clear();
+    for (qsizetype c = 0; c < m_segmentation.components.size(); ++c) {
+        if (!m_componentVisible[c]) continue;
+        
+        const MeshComponent& component = m_segmentation.components[c];
+        if (!m_drawRanges.isEmpty()
+            && m_drawRanges.last().first + m_drawRanges.last().second == component.firstFacet) {
+            m_drawRanges.last().second += component.facetCount;
+        } else {
+            m_drawRanges.append(qMakePair(component.firstFacet, component.facetCount));
+        }
+    }
+}
+
+void MeshScene::bindAttributes(QOpenGLVertexArrayObject* vao)
+{
+    QOpenGLExtraFunctions* f = QOpenGLContext::currentContext()->extraFunctions();
+    
+    vao->bind();
+    
+    m_vertexBuffer.bind();
+    f->glEnableVertexAttribArray(0);
+    f->glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
+    
+    m_normalBuffer.bind();
+    f->glEnableVertexAttribArray(1);
+    f->glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
+    
+    if (m_hasScalars) {
+        m_scalarBuffer.bind();
+        f->glEnableVertexAttribArray(2);
+        f->glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, 0, nullptr);
+    } else {
+        f->glDisableVertexAttribArray(2);
+    }
+    
+    f->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER,
+                    m_segmentation.components.isEmpty() ? 0 : m_indexBuffer.bufferId());
+    
+    vao->release();
+    m_scalarBuffer.release();
+}
+
+void MeshScene::bindSurfaceAttributes(QOpenGLVertexArrayObject* vao, QOpenGLBuffer& vertexBuffer,
+                                      QOpenGLBuffer& normalBuffer)
+{
+    QOpenGLExtraFunctions* f = QOpenGLContext::currentContext()->extraFunctions();
+    
+    vao->bind();
+    
+    vertexBuffer.bind();
+    f->glEnableVertexAttribArray(0);
+    f->glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
+    
+    normalBuffer.bind();
+    f->glEnableVertexAttribArray(1);
+    f->glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
+    
+    f->glDisableVertexAttribArray(2);
+    
+    vao->release();
+    normalBuffer.release();
+}
+
+void MeshScene::draw(const QMatrix4x4& model, const QMatrix4x4& view,
+                     const QMatrix4x4& projection, const QVector3D& viewPos)
+{
+    if (!m_modelLoaded || m_vertexCount == 0 || !m_shaderProgram) {
+        return;
+    }
+    
+    QOpenGLContext* context = QOpenGLContext::currentContext();
+    QOpenGLExtraFunctions* f = context->extraFunctions();
+    
+    auto it = m_vaos.find(context);
+    if (it == m_vaos.end()) {
+        ContextVao entry{new QOpenGLVertexArrayObject, -1, new QOpenGLVertexArrayObject, -1,
+                         new QOpenGLVertexArrayObject, -1};
+        entry.vao->create();
+        entry.voxelVao->create();
+        entry.shapeVao->create();
+        it = m_vaos.insert(context, entry);
+        connect(context, &QOpenGLContext::aboutToBeDestroyed, this, [this, context]() {
+            const ContextVao entry = m_vaos.take(context);
+            delete entry.vao;
+            delete entry.voxelVao;
+            delete entry.shapeVao;
+        });
+    }
+    
+    const bool drawVoxels = m_showVoxels && m_voxelVertexCount > 0;
+    QOpenGLVertexArrayObject* vao = it->vao;
+    if (drawVoxels) {
+        if (it->voxelRevision != m_voxelRevision) {
+            bindSurfaceAttributes(it->voxelVao, m_voxelVertexBuffer, m_voxelNormalBuffer);
+            it->voxelRevision = m_voxelRevision;
+        }
+        vao = it->voxelVao;
+    } else if (it->revision != m_attributeRevision) {
+        bindAttributes(it->vao);
+        it->revision = m_attributeRevision;
+    }
+    
+    m_shaderProgram->bind();
+    vao->bind();
+    
+    // Set uniforms
+    m_shaderProgram->setUniformValue("model", model);
+    m_shaderProgram->setUniformValue("view", view);
+    m_shaderProgram->setUniformValue("projection", projection);
+    
+    // Lighting uniforms
+    m_shaderProgram->setUniformValue("lightPos", QVector3D(2.0f, 2.0f, 2.0f));
+    m_shaderProgram->setUniformValue("lightColor", QVector3D(1.0f, 1.0f, 1.0f));
+    m_shaderProgram->setUniformValue("objectColor", QVector3D(0.3f, 0.6f, 0.9f));
+    m_shaderProgram->setUniformValue("viewPos", viewPos);
+    m_shaderProgram->setUniformValue("useScalars", m_hasScalars && !drawVoxels);
+    m_shaderProgram->setUniformValue("scalarRange", m_scalarRange);
+    m_shaderProgram->setUniformValue("useFacetColors", m_hasFacetColors && !drawVoxels);
+    m_shaderProgram->setUniformValue("facetColors", 0);
+    m_shaderProgram->setUniformValue("overlayColors", 1);
+    m_shaderProgram->setUniformValue("opacity", 1.0f);
+    
+    // Voxel face colors take the overlay's place; its facet index is the
+    // voxel triangle's
+    if (drawVoxels) {
+        m_shaderProgram->setUniformValue("useOverlay", m_hasVoxelColors);
+        f->glActiveTexture(GL_TEXTURE1);
+        f->glBindTexture(GL_TEXTURE_BUFFER, m_voxelColorTexture);
+    } else {
+        m_shaderProgram->setUniformValue("useOverlay", m_hasOverlay);
+        f->glActiveTexture(GL_TEXTURE1);
+        f->glBindTexture(GL_TEXTURE_BUFFER, m_overlayTexture);
+    }
+    f->glActiveTexture(GL_TEXTURE0);
+    f->glBindTexture(GL_TEXTURE_BUFFER, m_facetColorTexture);
+    
+    // Draw the model
+    if (drawVoxels) {
+        f->glDrawArrays(GL_TRIANGLES, 0, m_voxelVertexCount);
+    } else if (m_segmentation.components.isEmpty()) {
+        f->glDrawArrays(GL_TRIANGLES, 0, m_vertexCount);
+    } else {
+        // Hidden components are never submitted
+        for (const auto& range : std::as_const(m_drawRanges)) {
+            const qintptr offset = qintptr(range.first) * 3 * qintptr(sizeof(quint32));
+            f->glDrawElements(GL_TRIANGLES, GLsizei(range.second * 3), GL_UNSIGNED_INT,
+                              reinterpret_cast<const void*>(offset));
+        }
+    }
+    
+    vao->release();
+    
+    if (m_shapeVertexCount > 0) {
+        if (it->shapeRevision != m_shapeRevision) {
+            bindSurfaceAttributes(it->shapeVao, m_shapeVertexBuffer, m_shapeNormalBuffer);
+            it->shapeRevision = m_shapeRevision;
+        }
+        drawShapes(f, it->shapeVao);
+    }
+    
+    f->glActiveTexture(GL_TEXTURE1);
+    f->glBindTexture(GL_TEXTURE_BUFFER, 0);
+    f->glActiveTexture(GL_TEXTURE0);
+    f->glBindTexture(GL_TEXTURE_BUFFER, 0);
+    m_shaderProgram->release();
+}
+
+void MeshScene::drawShapes(QOpenGLExtraFunctions* f, QOpenGLVertexArrayObject* vao)
+{
+    // Blended over the model after it has been drawn: depth tested against
+    // it but not written, so nested shapes such as a hull inside its box
+    // both show. Destination alpha is left alone so exported images stay
+    // opaque.
+    const GLboolean blend = f->glIsEnabled(GL_BLEND);
+    const GLboolean polygonOffset = f->glIsEnabled(GL_POLYGON_OFFSET_FILL);
+    GLboolean depthMask = GL_TRUE;
+    f->glGetBooleanv(GL_DEPTH_WRITEMASK, &depthMask);
+    f->glEnable(GL_BLEND);
+    f->glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ZERO, GL_ONE);
+    f->glDepthMask(GL_FALSE);
+    f->glDisable(GL_POLYGON_OFFSET_FILL);
+    
+    m_shaderProgram->setUniformValue("useScalars", false);
+    m_shaderProgram->setUniformValue("useFacetColors", false);
+    m_shaderProgram->setUniformValue("useOverlay", m_hasShapeColors);
+    m_shaderProgram->setUniformValue("opacity", 0.35f);
+    f->glActiveTexture(GL_TEXTURE1);
+    f->glBindTexture(GL_TEXTURE_BUFFER, m_shapeColorTexture);
+    
+    vao->bind();
+    f->glDrawArrays(GL_TRIANGLES, 0, m_shapeVertexCount);
+    vao->release();
+    
+    f->glDepthMask(depthMask);
+    if (polygonOffset) {
+        f->glEnable(GL_POLYGON_OFFSET_FILL);
+    }
+    if (!blend) {
+        f->glDisable(GL_BLEND);
+    }
+}
+
+void MeshScene::logMemoryUsage() const
+{
+    const MemoryUsage usage = memoryUsage();
+    const QLocale locale;
+    
+    auto size = [&locale](qint64 bytes) { return locale.formattedDataSize(bytes); };
+    
+    qInfo().noquote() << QString("Geometry memory for %1:").arg(m_currentFile)
+        << QString("CPU %1 (triangles %2, vertices %3, normals %4, facet colors %5, components %6),")
+               .arg(size(usage.cpuTotal()), size(usage.triangles), size(usage.vertices),
+                    size(usage.normals), size(usage.facetColors), size(usage.components))
+        << QString("GPU %1 (vertices %2, normals %3, scalars %4, facet colors %5, overlay %6, indices %7, voxels %8, shapes %9)")
+               .arg(size(usage.gpuTotal()), size(usage.gpuVertices), size(usage.gpuNormals),
+                    size(usage.gpuScalars), size(usage.gpuFacetColors), size(usage.gpuOverlay),
+                    size(usage.gpuIndices), size(usage.gpuVoxels), size(usage.gpuShapes));
+}
@@ -0,0 +1,210 @@
+#include "meshsegmentation.h"
+#include "meshwelder.h"
+#include "stlviewer.h"
+#include "parallelfor.h"
+#include <QElapsedTimer>
+#include <QDebug>
+#include <atomic>
+#include <limits>
+#include <memory>
+#include <utility>
+
+namespace {
+
+constexpr qsizetype kGrain = 65536;
+
+// Union-find over vertex indices that many threads can update at once.
+// Links always hang the larger root under the smaller one, so parents only
+// ever decrease, no cycles can form, and each set ends up rooted at its
+// lowest index however the threads interleave.
+class DisjointSets
+{
+public:
+    explicit DisjointSets(qsizetype count)
+        : m_parent(new std::atomic<quint32>[count])
+    {
+        parallelFor(count, kGrain, [this](qsizetype begin, qsizetype end) {
+            for (qsizetype i = begin; i < end; ++i) {
+                m_parent[i].store(quint32(i), std::memory_order_relaxed);
+            }
+        });
+    }
+    
+    quint32 find(quint32 x) const
+    {
+        for (;;) {
+            quint32 parent = m_parent[x].load(std::memory_order_relaxed);
+            if (parent == x) return x;
+            const quint32 grandparent = m_parent[parent].load(std::memory_order_relaxed);
+            if (grandparent != parent) {
+                // Path halving; losing the race only costs some compression
+                m_parent[x].compare_exchange_weak(parent, grandparent,
+                                                  std::memory_order_relaxed);
+            }
+            x = grandparent;
+        }
+    }
+    
+    void unite(quint32 a, quint32 b)
+    {
+        for (;;) {
+            a = find(a);
+            b = find(b);
+            if (a == b) return;
+            if (a > b) std::swap(a, b);
+            
+            // Only succeeds while b is still a root; otherwise retry from
+            // wherever b has been linked in the meantime
+            quint32 expected = b;
+            if (m_parent[b].compare_exchange_strong(expected, a, std::memory_order_relaxed)) {
+                return;
+            }
+        }
+    }
+    
+    bool isRoot(quint32 x) const
+    {
+        return m_parent[x].load(std::memory_order_relaxed) == x;
+    }
+    
+private:
+    std::unique_ptr<std::atomic<quint32>[]> m_parent;
+};
+
+// Statistics for one run of equal components inside a chunk of facetOrder
+struct ComponentRun {
+    quint32 component;
+    QVector3D minBounds;
+    QVector3D maxBounds;
+    double volume;
+};
+
+void mergeBounds(MeshComponent& component, const QVector3D& minBounds, const QVector3D& maxBounds)
+{
+    component.minBounds = QVector3D(qMin(component.minBounds.x(), minBounds.x()),
+                                    qMin(component.minBounds.y(), minBounds.y()),
+                                    qMin(component.minBounds.z(), minBounds.z()));
+    component.maxBounds = QVector3D(qMax(component.maxBounds.x(), maxBounds.x()),
+                                    qMax(component.maxBounds.y(), maxBounds.y()),
+                                    qMax(component.maxBounds.z(), maxBounds.z()));
+}
+
+} // namespace
+
+Segmentation MeshSegmentation::compute(const QVector<Triangle>& triangles)
+{
+    Segmentation result;
+    const qsizetype facetCount = triangles.size();
+    if (facetCount == 0) return result;
+    
+    QElapsedTimer timer;
+    timer.start();
+    
+    // Components are connected through shared corners, so corners that
+    // coincide exactly have to become one vertex first
+    const WeldedMesh welded = MeshWelder::weld(triangles);
+    const qint64 weldMs = timer.elapsed();
+    const quint32* indices = welded.indices.constData();
+    const qsizetype vertexCount = welded.positions.size();
+    
+    DisjointSets sets(vertexCount);
+    parallelFor(facetCount, kGrain, [&](qsizetype begin, qsizetype end) {
+        for (qsizetype f = begin; f < end; ++f) {
+            sets.unite(indices[3 * f], indices[3 * f + 1]);
+            sets.unite(indices[3 * f], indices[3 * f + 2]);
+        }
+    });
+    
+    // Number the roots in vertex order; every welded vertex belongs to a facet
+    QVector<quint32> rootComponent(vertexCount);
+    quint32 componentCount = 0;
+    for (qsizetype v = 0; v < vertexCount; ++v) {
+        if (sets.isRoot(quint32(v))) {
+            rootComponent[v] = componentCount++;
+        }
+    }
+    
+    result.facetComponent.resize(facetCount);
+    quint32* facetComponent = result.facetComponent.data();
+    parallelFor(facetCount, kGrain, [&](qsizetype begin, qsizetype end) {
+        for (qsizetype f = begin; f < end; ++f) {
+            facetComponent[f] = rootComponent[sets.find(indices[3 * f])];
+        }
+    });
+    
+    // Counting sort groups each component's facets into one contiguous range
+    result.components.resize(componentCount);
+    for (qsizetype f = 0; f < facetCount; ++f) {
+        ++result.components[facetComponent[f]].facetCount;
+    }
+    qsizetype offset = 0;
+    for (MeshComponent& component : result.components) {
+        component.firstFacet = offset;
+        offset += component.facetCount;
+    }
+    
+    result.facetOrder.resize(facetCount);
+    {
+        QVector<qsizetype> cursor(componentCount);
+        for (quint32 c = 0; c < componentCount; ++c) {
+            cursor[c] = result.components[c].firstFacet;
+        }
+        for (qsizetype f = 0; f < facetCount; ++f) {
+            result.facetOrder[cursor[facetComponent[f]]++] = quint32(f);
+        }
+    }
+    
+    // Bounds and volume per chunk of the sorted order, one partial result
+    // per run of facets from the same component, merged afterwards
+    const qsizetype chunkCount = (facetCount + kGrain - 1) / kGrain;
+    QVector<QVector<ComponentRun>> chunkRuns(chunkCount);
+    const quint32* facetOrder = result.facetOrder.constData();
+    
+    parallelFor(facetCount, kGrain, [&](qsizetype begin, qsizetype end) {
+        QVector<ComponentRun>& runs = chunkRuns[begin / kGrain];
+        for (qsizetype i = begin; i < end; ++i) {
+            const quint32 facet = facetOrder[i];
+            const Triangle& triangle = triangles[facet];
+            const quint32 component = facetComponent[facet];
+            
+            if (runs.isEmpty() || runs.last().component != component) {
+                runs.append({component, triangle.vertex1, triangle.vertex1, 0.0});
+            }
+            ComponentRun& run = runs.last();
+            for (const QVector3D& p : {triangle.vertex1, triangle.vertex2, triangle.vertex3}) {
+                run.minBounds = QVector3D(qMin(run.minBounds.x(), p.x()),
+                                          qMin(run.minBounds.y(), p.y()),
+                                          qMin(run.minBounds.z(), p.z()));
+                run.maxBounds = QVector3D(qMax(run.maxBounds.x(), p.x()),
+                                          qMax(run.maxBounds.y(), p.y()),
+                                          qMax(run.maxBounds.z(), p.z()));
+            }
+            
+            // Divergence theorem: signed tetrahedron volumes against the origin
+            const double ax = triangle.vertex1.x(), ay = triangle.vertex1.y(), az = triangle.vertex1.z();
+            const double bx = triangle.vertex2.x(), by = triangle.vertex2.y(), bz = triangle.vertex2.z();
+            const double cx = triangle.vertex3.x(), cy = triangle.vertex3.y(), cz = triangle.vertex3.z();
+            run.volume += (ax * (by * cz - bz * cy) + ay * (bz * cx - bx * cz)
+                           + az * (bx * cy - by * cx)) / 6.0;
+        }
+    });
+    
+    const float inf = std::numeric_limits<float>::max();
+    for (MeshComponent& component : result.components) {
+        component.minBounds = QVector3D(inf, inf, inf);
+        component.maxBounds = QVector3D(-inf, -inf, -inf);
+    }
+    for (const QVector<ComponentRun>& runs : std::as_const(chunkRuns)) {
+        for (const ComponentRun& run : runs) {
+            MeshComponent& component = result.components[run.component];
+            mergeBounds(component, run.minBounds, run.maxBounds);
+            component.volume += run.volume;
+        }
+    }
+    
+    result.elapsedMs = timer.elapsed();
+    qInfo().noquote() << QString("Segmented %1 facets into %2 components in %3 ms (weld %4 ms)")
+                             .arg(facetCount).arg(componentCount)
+                             .arg(result.elapsedMs).arg(weldMs);
+    return result;
+}
@@ -0,0 +1,712 @@
+#include "meshvoxelizer.h"
+#include "stlviewer.h"
+#include "stlloader.h"
+#include "parallelfor.h"
+#include <QElapsedTimer>
+#include <QDebug>
+#include <QtAlgorithms>
+#include <QtMath>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+
+namespace {
+
+const qsizetype kGrain = 65536;
+
+// Layers per slab. Slabs are the unit of parallel work and every write of
+// a slab's task stays inside its own layers.
+const int kSlabDepth = 4;
+
+// Boxes are grown by this much (in voxels) so rounding never drops a voxel
+// the triangle touches
+const float kBoxMargin = 1e-4f;
+
+struct Crossing {
+    qint32 row; // (z - slab begin) * sizeY + y
+    float x;
+};
+
+void setBits(quint64* row, int begin, int end)
+{
+    if (begin >= end) return;
+    const int first = begin >> 6;
+    const int last = (end - 1) >> 6;
+    const quint64 head = ~quint64(0) << (begin & 63);
+    const quint64 tail = ~quint64(0) >> (63 - ((end - 1) & 63));
+    if (first == last) {
+        row[first] |= head & tail;
+        return;
+    }
+    row[first] |= head;
+    for (int w = first + 1; w < last; ++w) {
+        row[w] = ~quint64(0);
+    }
+    row[last] |= tail;
+}
+
+bool anyBits(const quint64* row, int begin, int end)
+{
+    if (begin >= end) return false;
+    const int first = begin >> 6;
+    const int last = (end - 1) >> 6;
+    const quint64 head = ~quint64(0) << (begin & 63);
+    const quint64 tail = ~quint64(0) >> (63 - ((end - 1) & 63));
+    if (first == last) {
+        return (row[first] & head & tail) != 0;
+    }
+    if (row[first] & head) return true;
+    for (int w = first + 1; w < last; ++w) {
+        if (row[w]) return true;
+    }
+    return (row[last] & tail) != 0;
+}
+
+int voxelIndex(float coordinate, int size)
+{
+    return qBound(0, int(std::floor(coordinate)), size - 1);
+}
+
+// Separating axis test of a triangle against the voxel box centered at
+// 'center' (Akenine-Moller). The box axes are covered by the caller, which
+// only visits voxels inside the triangle's bounds.
+bool triangleOverlapsBox(const QVector3D& center, const QVector3D& a, const QVector3D& b,
+                         const QVector3D& c)
+{
+    const float half = 0.5f + kBoxMargin;
+    const QVector3D v0 = a - center;
+    const QVector3D v1 = b - center;
+    const QVector3D v2 = c - center;
+    const QVector3D edges[3] = {v1 - v0, v2 - v1, v0 - v2};
+
+    for (const QVector3D& e : edges) {
+        const QVector3D axes[3] = {QVector3D(0.0f, -e.z(), e.y()),
+                                   QVector3D(e.z(), 0.0f, -e.x()),
+                                   QVector3D(-e.y(), e.x(), 0.0f)};
+        for (const QVector3D& axis : axes) {
+            const float p0 = QVector3D::dotProduct(v0, axis);
+            const float p1 = QVector3D::dotProduct(v1, axis);
+            const float p2 = QVector3D::dotProduct(v2, axis);
+            const float radius = half * (qAbs(axis.x()) + qAbs(axis.y()) + qAbs(axis.z()));
+            if (qMin(p0, qMin(p1, p2)) > radius || qMax(p0, qMax(p1, p2)) < -radius) {
+                return false;
+            }
+        }
+    }
+
+    const QVector3D normal = QVector3D::crossProduct(edges[0], edges[1]);
+    const float radius = half * (qAbs(normal.x()) + qAbs(normal.y()) + qAbs(normal.z()));
+    return qAbs(QVector3D::dotProduct(normal, v0)) <= radius;
+}
+
+// Points exactly on an edge belong to one of the two triangles sharing it,
+// so a scanline through a shared edge or vertex crosses the surface once
+bool ownsEdge(double du, double dv)
+{
+    return dv > 0.0 || (dv == 0.0 && du < 0.0);
+}
+
+bool insideEdge(double au, double av, double bu, double bv, double pu, double pv)
+{
+    const double du = bu - au;
+    const double dv = bv - av;
+    const double e = du * (pv - av) - dv * (pu - au);
+    return e > 0.0 || (e == 0.0 && ownsEdge(du, dv));
+}
+
+// result[j] = op(a[j .. j + window - 1]) for j <= length - window in O(1) per
+// item for any window (van Herk / Gil-Werman): every window spans the tail
+// of one block and the head of the next
+template <typename Op>
+void slidingWindow(const quint64* a, int length, int window, Op op,
+                   quint64* prefix, quint64* suffix, quint64* result)
+{
+    for (int i = 0; i < length; ++i) {
+        prefix[i] = i % window == 0 ? a[i] : op(prefix[i - 1], a[i]);
+    }
+    for (int i = length - 1; i >= 0; --i) {
+        suffix[i] = (i % window == window - 1 || i == length - 1) ? a[i] : op(a[i], suffix[i + 1]);
+    }
+    for (int j = 0; j + window <= length; ++j) {
+        result[j] = op(suffix[j], prefix[j + window - 1]);
+    }
+}
+
+// One axis of a box erosion or dilation over a sequence of words, 64 grid
+// columns per word. Erosion anchors each window at its first item and
+// dilation at its last, so eroding and then dilating opens the sequence.
+struct BoxFilter {
+    explicit BoxFilter(int length, int window)
+        : length(length)
+        , window(window)
+        , items(length)
+        , padded(length + window)
+        , prefix(length + window)
+        , suffix(length + window)
+        , result(length + window)
+    {
+    }
+
+    // result[j] = AND of items[j .. j + window), zero where that runs past
+    // the end
+    void erode()
+    {
+        std::fill(result.begin(), result.end(), 0);
+        if (length < window) return;
+        auto both = [](quint64 a, quint64 b) { return a & b; };
+        slidingWindow(items.constData(), length, window, both, prefix.data(), suffix.data(),
+                      result.data());
+        std::fill(result.begin() + (length - window + 1), result.end(), 0);
+    }
+
+    // result[j] = OR of items[j - window + 1 .. j]
+    void dilate()
+    {
+        auto either = [](quint64 a, quint64 b) { return a | b; };
+        std::fill(padded.begin(), padded.end(), 0);
+        std::copy(items.constBegin(), items.constEnd(), padded.begin() + (window - 1));
+        slidingWindow(padded.constData(), length + window - 1, window, either, prefix.data(),
+                      suffix.data(), result.data());
+    }
+
+    int length;
+    int window;
+    QVector<quint64> items;
+    QVector<quint64> padded;
+    QVector<quint64> prefix;
+    QVector<quint64> suffix;
+    QVector<quint64> result;
+};
+
+// out bit x = in bit x + shift, or x - shift when 'up'; bits shifted in are
+// zero
+void shiftBits(const quint64* in, quint64* out, int words, int shift, bool up)
+{
+    const int wordShift = shift >> 6;
+    const int bitShift = shift & 63;
+    auto word = [&](int w) { return w >= 0 && w < words ? in[w] : quint64(0); };
+    for (int w = 0; w < words; ++w) {
+        if (up) {
+            const quint64 near = word(w - wordShift);
+            out[w] = bitShift ? (near << bitShift) | (word(w - wordShift - 1) >> (64 - bitShift)) : near;
+        } else {
+            const quint64 near = word(w + wordShift);
+            out[w] = bitShift ? (near >> bitShift) | (word(w + wordShift + 1) << (64 - bitShift)) : near;
+        }
+    }
+}
+
+// The X axis of the box filter inside one row of bits: the window grows by
+// doubling shifts, so each row takes log2(window) passes
+void filterBits(quint64* row, quint64* shifted, int words, int window, bool erode)
+{
+    int span = 1;
+    while (span < window) {
+        const int step = qMin(span, window - span);
+        shiftBits(row, shifted, words, step, !erode);
+        for (int w = 0; w < words; ++w) {
+            row[w] = erode ? row[w] & shifted[w] : row[w] | shifted[w];
+        }
+        span += step;
+    }
+}
+
+} // namespace
+
+VoxelGrid::VoxelGrid(int sizeX, int sizeY, int sizeZ)
+    : m_sizeX(sizeX)
+    , m_sizeY(sizeY)
+    , m_sizeZ(sizeZ)
+    , m_wordsPerRow((sizeX + 63) / 64)
+    , m_words(qsizetype(m_wordsPerRow) * sizeY * sizeZ, 0)
+{
+}
+
+void VoxelGrid::setRange(int y, int z, int begin, int end)
+{
+    setBits(row(y, z), qMax(begin, 0), qMin(end, m_sizeX));
+}
+
+qint64 VoxelGrid::count() const
+{
+    const qsizetype words = m_words.size();
+    QVector<qint64> chunkCounts((words + kGrain - 1) / kGrain, 0);
+    parallelFor(words, kGrain, [&](qsizetype begin, qsizetype end) {
+        qint64 count = 0;
+        for (qsizetype i = begin; i < end; ++i) {
+            count += qPopulationCount(m_words[i]);
+        }
+        chunkCounts[begin / kGrain] = count;
+    });
+
+    qint64 total = 0;
+    for (qint64 count : std::as_const(chunkCounts)) {
+        total += count;
+    }
+    return total;
+}
+
+VoxelizationResult MeshVoxelizer::voxelize(const QVector<Triangle>& triangles, int resolution,
+                                           float minWallThickness)
+{
+    VoxelizationResult result;
+    const qsizetype count = triangles.size();
+    if (count == 0 || resolution < 1) return result;
+
+    QElapsedTimer timer;
+    timer.start();
+
+    // Bounds
+    const qsizetype chunkCount = (count + kGrain - 1) / kGrain;
+    QVector<QVector3D> chunkMin(chunkCount);
+    QVector<QVector3D> chunkMax(chunkCount);
+    parallelFor(count, kGrain, [&](qsizetype begin, qsizetype end) {
+        QVector3D low = triangles[begin].vertex1;
+        QVector3D high = low;
+        for (qsizetype i = begin; i < end; ++i) {
+            const Triangle& t = triangles[i];
+            for (const QVector3D& v : {t.vertex1, t.vertex2, t.vertex3}) {
+                low = QVector3D(qMin(low.x(), v.x()), qMin(low.y(), v.y()), qMin(low.z(), v.z()));
+                high = QVector3D(qMax(high.x(), v.x()), qMax(high.y(), v.y()), qMax(high.z(), v.z()));
+            }
+        }
+        chunkMin[begin / kGrain] = low;
+        chunkMax[begin / kGrain] = high;
+    });
+    QVector3D low = chunkMin[0];
+    QVector3D high = chunkMax[0];
+    for (qsizetype c = 1; c < chunkCount; ++c) {
+        low = QVector3D(qMin(low.x(), chunkMin[c].x()), qMin(low.y(), chunkMin[c].y()),
+                        qMin(low.z(), chunkMin[c].z()));
+        high = QVector3D(qMax(high.x(), chunkMax[c].x()), qMax(high.y(), chunkMax[c].y()),
+                         qMax(high.z(), chunkMax[c].z()));
+    }
+
+    const QVector3D extent = high - low;
+    const float longest = qMax(extent.x(), qMax(extent.y(), extent.z()));
+    if (!(longest > 0.0f)) return result;
+
+    // One empty voxel of padding on every side
+    const float voxelSize = longest / float(resolution);
+    int size[3];
+    for (int axis = 0; axis < 3; ++axis) {
+        size[axis] = qMax(1, int(std::ceil(extent[axis] / voxelSize))) + 2;
+    }
+    const int sizeX = size[0];
+    const int sizeY = size[1];
+    const int sizeZ = size[2];
+    const QVector3D origin = low - QVector3D(voxelSize, voxelSize, voxelSize);
+    const float scale = 1.0f / voxelSize;
+
+    result.origin = origin;
+    result.voxelSize = voxelSize;
+    result.solid = VoxelGrid(sizeX, sizeY, sizeZ);
+    VoxelGrid& solid = result.solid;
+
+    auto toVoxels = [&](const QVector3D& v) { return (v - origin) * scale; };
+
+    // Bin triangles into the slabs their bounds overlap, counting per chunk
+    // first so the lists come out in file order without locking
+    const int slabCount = (sizeZ + kSlabDepth - 1) / kSlabDepth;
+    auto slabRange = [&](const Triangle& t, int& first, int& last) {
+        const float z1 = toVoxels(t.vertex1).z();
+        const float z2 = toVoxels(t.vertex2).z();
+        const float z3 = toVoxels(t.vertex3).z();
+        first = voxelIndex(qMin(z1, qMin(z2, z3)) - kBoxMargin, sizeZ) / kSlabDepth;
+        last = voxelIndex(qMax(z1, qMax(z2, z3)) + kBoxMargin, sizeZ) / kSlabDepth;
+    };
+
+    QVector<qsizetype> cursors(chunkCount * slabCount, 0);
+    parallelFor(count, kGrain, [&](qsizetype begin, qsizetype end) {
+        qsizetype* counts = cursors.data() + (begin / kGrain) * slabCount;
+        for (qsizetype i = begin; i < end; ++i) {
+            int first, last;
+            slabRange(triangles[i], first, last);
+            for (int s = first; s <= last; ++s) {
+                ++counts[s];
+            }
+        }
+    });
+
+    QVector<qsizetype> slabStarts(slabCount + 1, 0);
+    qsizetype offset = 0;
+    for (int s = 0; s < slabCount; ++s) {
+        slabStarts[s] = offset;
+        for (qsizetype c = 0; c < chunkCount; ++c) {
+            const qsizetype n = cursors[c * slabCount + s];
+            cursors[c * slabCount + s] = offset;
+            offset += n;
+        }
+    }
+    slabStarts[slabCount] = offset;
+
+    QVector<quint32> slabTriangles(offset);
+    parallelFor(count, kGrain, [&](qsizetype begin, qsizetype end) {
+        qsizetype* cursor = cursors.data() + (begin / kGrain) * slabCount;
+        for (qsizetype i = begin; i < end; ++i) {
+            int first, last;
+            slabRange(triangles[i], first, last);
+            for (int s = first; s <= last; ++s) {
+                slabTriangles[cursor[s]++] = quint32(i);
+            }
+        }
+    });
+    cursors = QVector<qsizetype>();
+
+    // Surface: every voxel a triangle touches
+    parallelFor(slabCount, 1, [&](qsizetype slab, qsizetype) {
+        const int zBegin = int(slab) * kSlabDepth;
+        const int zEnd = qMin(zBegin + kSlabDepth, sizeZ) - 1;
+        for (qsizetype k = slabStarts[slab]; k < slabStarts[slab + 1]; ++k) {
+            const Triangle& t = triangles[slabTriangles[k]];
+            const QVector3D a = toVoxels(t.vertex1);
+            const QVector3D b = toVoxels(t.vertex2);
+            const QVector3D c = toVoxels(t.vertex3);
+
+            const int x0 = voxelIndex(qMin(a.x(), qMin(b.x(), c.x())) - kBoxMargin, sizeX);
+            const int x1 = voxelIndex(qMax(a.x(), qMax(b.x(), c.x())) + kBoxMargin, sizeX);
+            const int y0 = voxelIndex(qMin(a.y(), qMin(b.y(), c.y())) - kBoxMargin, sizeY);
+            const int y1 = voxelIndex(qMax(a.y(), qMax(b.y(), c.y())) + kBoxMargin, sizeY);
+            const int z0 = qMax(zBegin, voxelIndex(qMin(a.z(), qMin(b.z(), c.z())) - kBoxMargin, sizeZ));
+            const int z1 = qMin(zEnd, voxelIndex(qMax(a.z(), qMax(b.z(), c.z())) + kBoxMargin, sizeZ));
+
+            // Most facets of a dense mesh fall inside a single voxel
+            if (x0 == x1 && y0 == y1 && z0 == z1) {
+                solid.set(x0, y0, z0);
+                continue;
+            }
+            for (int z = z0; z <= z1; ++z) {
+                for (int y = y0; y <= y1; ++y) {
+                    for (int x = x0; x <= x1; ++x) {
+                        const QVector3D center(x + 0.5f, y + 0.5f, z + 0.5f);
+                        if (triangleOverlapsBox(center, a, b, c)) {
+                            solid.set(x, y, z);
+                        }
+                    }
+                }
+            }
+        }
+    });
+    result.surfaceVoxels = solid.count();
+
+    // Interior: cast a ray along X through every voxel row center and fill
+    // between alternate crossings
+    QVector<qint64> openRows(slabCount, 0);
+    QVector<qint64> insideVoxels(slabCount, 0);
+    parallelFor(slabCount, 1, [&](qsizetype slab, qsizetype) {
+        const int zBegin = int(slab) * kSlabDepth;
+        const int zEnd = qMin(zBegin + kSlabDepth, sizeZ) - 1;
+        QVector<Crossing> crossings;
+        for (qsizetype k = slabStarts[slab]; k < slabStarts[slab + 1]; ++k) {
+            const Triangle& t = triangles[slabTriangles[k]];
+            const QVector3D a = toVoxels(t.vertex1);
+            QVector3D b = toVoxels(t.vertex2);
+            QVector3D c = toVoxels(t.vertex3);
+
+            // Facets parallel to the ray never cross it
+            double area = (double(b.y()) - a.y()) * (double(c.z()) - a.z())
+                        - (double(b.z()) - a.z()) * (double(c.y()) - a.y());
+            if (area == 0.0) continue;
+            if (area < 0.0) {
+                std::swap(b, c);
+                area = -area;
+            }
+
+            const int y0 = qMax(0, int(std::ceil(qMin(a.y(), qMin(b.y(), c.y())) - 0.5f)));
+            const int y1 = qMin(sizeY - 1, int(std::floor(qMax(a.y(), qMax(b.y(), c.y())) - 0.5f)));
+            const int z0 = qMax(zBegin, int(std::ceil(qMin(a.z(), qMin(b.z(), c.z())) - 0.5f)));
+            const int z1 = qMin(zEnd, int(std::floor(qMax(a.z(), qMax(b.z(), c.z())) - 0.5f)));
+            if (y0 > y1 || z0 > z1) continue;
+
+            // x along the facet's plane; the X component of the normal is the
+            // projected area
+            const double ny = (double(b.z()) - a.z()) * (double(c.x()) - a.x())
+                            - (double(b.x()) - a.x()) * (double(c.z()) - a.z());
+            const double nz = (double(b.x()) - a.x()) * (double(c.y()) - a.y())
+                            - (double(b.y()) - a.y()) * (double(c.x()) - a.x());
+            for (int z = z0; z <= z1; ++z) {
+                const double pz = z + 0.5;
+                for (int y = y0; y <= y1; ++y) {
+                    const double py = y + 0.5;
+                    if (!insideEdge(a.y(), a.z(), b.y(), b.z(), py, pz)
+                        || !insideEdge(b.y(), b.z(), c.y(), c.z(), py, pz)
+                        || !insideEdge(c.y(), c.z(), a.y(), a.z(), py, pz)) {
+                        continue;
+                    }
+                    const double x = a.x() - (ny * (py - a.y()) + nz * (pz - a.z())) / area;
+                    crossings.append(Crossing{qint32((z - zBegin) * sizeY + y), float(x)});
+                }
+            }
+        }
+
+        std::sort(crossings.begin(), crossings.end(), [](const Crossing& l, const Crossing& r) {
+            return l.row != r.row ? l.row < r.row : l.x < r.x;
+        });
+
+        // Voxels whose centers lie in [entry, exit)
+        qsizetype i = 0;
+        while (i < crossings.size()) {
+            const qint32 row = crossings[i].row;
+            qsizetype j = i;
+            while (j < crossings.size() && crossings[j].row == row) {
+                ++j;
+            }
+            // An odd count means a hole along the row; pairing its crossings
+            // would fill the wrong spans, so it only gets its surface voxels
+            if ((j - i) % 2 != 0) {
+                ++openRows[slab];
+                i = j;
+                continue;
+            }
+            const int y = row % sizeY;
+            const int z = zBegin + row / sizeY;
+            for (qsizetype k = i; k + 1 < j; k += 2) {
+                const int begin = qMax(0, int(std::ceil(crossings[k].x - 0.5f)));
+                const int end = qMin(sizeX, int(std::ceil(crossings[k + 1].x - 0.5f)));
+                if (begin < end) {
+                    solid.setRange(y, z, begin, end);
+                    insideVoxels[slab] += end - begin;
+                }
+            }
+            i = j;
+        }
+    });
+    slabTriangles = QVector<quint32>();
+
+    qint64 totalOpenRows = 0;
+    for (qint64 rows : std::as_const(openRows)) {
+        totalOpenRows += rows;
+    }
+    if (totalOpenRows > 0) {
+        qWarning() << "Voxelization:" << totalOpenRows
+                   << "scanlines crossed the surface an odd number of times and were"
+                   << "left unfilled; the mesh is not closed and its interior is incomplete";
+    }
+
+    // The surface voxels overestimate by about half a voxel layer; voxels
+    // whose centers are inside sample the volume without that bias
+    for (qint64 voxels : std::as_const(insideVoxels)) {
+        result.insideVoxels += voxels;
+    }
+    result.solidVoxels = solid.count();
+    result.volume = double(result.insideVoxels) * voxelSize * voxelSize * voxelSize;
+
+    // Thin walls: solid voxels that no solid cube minRun voxels on a side
+    // covers, i.e. those a box opening removes. The opening is separable:
+    // erode along Z, Y and X, then dilate along the three axes.
+    const int minRun = int(std::ceil(minWallThickness / voxelSize));
+    if (minRun > 1) {
+        result.thinWalls = VoxelGrid(sizeX, sizeY, sizeZ);
+        VoxelGrid& opened = result.thinWalls;
+        const int words = solid.wordsPerRow();
+
+        // Along Z, 64 columns per word, from 'source' into the opened grid
+        auto filterZ = [&](const VoxelGrid& source, bool erode) {
+            parallelFor(sizeY, 1, [&](qsizetype y, qsizetype) {
+                BoxFilter filter(sizeZ, minRun);
+                for (int w = 0; w < words; ++w) {
+                    for (int z = 0; z < sizeZ; ++z) {
+                        filter.items[z] = source.row(int(y), z)[w];
+                    }
+                    if (erode) filter.erode();
+                    else filter.dilate();
+                    for (int z = 0; z < sizeZ; ++z) {
+                        opened.row(int(y), z)[w] = filter.result[z];
+                    }
+                }
+            });
+        };
+
+        filterZ(solid, true);
+
+        // Along Y, then X within each row, eroding and dilating per slice
+        parallelFor(sizeZ, 1, [&](qsizetype zIndex, qsizetype) {
+            const int z = int(zIndex);
+            BoxFilter filter(sizeY, minRun);
+            auto filterY = [&](bool erode) {
+                for (int w = 0; w < words; ++w) {
+                    for (int y = 0; y < sizeY; ++y) {
+                        filter.items[y] = opened.row(y, z)[w];
+                    }
+                    if (erode) filter.erode();
+                    else filter.dilate();
+                    for (int y = 0; y < sizeY; ++y) {
+                        opened.row(y, z)[w] = filter.result[y];
+                    }
+                }
+            };
+
+            filterY(true);
+            QVector<quint64> shifted(words);
+            for (int y = 0; y < sizeY; ++y) {
+                filterBits(opened.row(y, z), shifted.data(), words, minRun, true);
+                filterBits(opened.row(y, z), shifted.data(), words, minRun, false);
+            }
+            filterY(false);
+        });
+
+        filterZ(opened, false);
+
+        // What the opening removed
+        parallelFor(sizeZ, 1, [&](qsizetype z, qsizetype) {
+            for (int y = 0; y < sizeY; ++y) {
+                const quint64* solidRow = solid.row(y, int(z));
+                quint64* thinRow = opened.row(y, int(z));
+                for (int w = 0; w < words; ++w) {
+                    thinRow[w] = solidRow[w] & ~thinRow[w];
+                }
+            }
+        });
+        result.thinVoxels = result.thinWalls.count();
+    }
+
+    result.elapsedMs = timer.elapsed();
+    qInfo().noquote() << QString("Voxelized %1 facets into %2 x %3 x %4 voxels of %5 in %6 ms: "
+                                 "%7 surface, %8 solid, %9 inside (volume %10), %11 thin")
+                             .arg(count).arg(sizeX).arg(sizeY).arg(sizeZ)
+                             .arg(double(voxelSize), 0, 'g', 4).arg(result.elapsedMs)
+                             .arg(result.surfaceVoxels).arg(result.solidVoxels)
+                             .arg(result.insideVoxels).arg(result.volume, 0, 'g', 6).arg(result.thinVoxels);
+    return result;
+}
+
+QVector<quint16> MeshVoxelizer::thinWallFacetColors(const QVector<Triangle>& triangles,
+                                                    const VoxelizationResult& result)
+{
+    const qsizetype count = triangles.size();
+    QVector<quint16> colors(count, 0);
+    const VoxelGrid& thin = result.thinWalls;
+    if (thin.isEmpty() || result.voxelSize <= 0.0f) return colors;
+
+    const quint16 thinColor = STLLoader::packFacetColor(31, 0, 0);
+    const float scale = 1.0f / result.voxelSize;
+    parallelFor(count, kGrain, [&](qsizetype begin, qsizetype end) {
+        for (qsizetype i = begin; i < end; ++i) {
+            const Triangle& t = triangles[i];
+            const QVector3D p = ((t.vertex1 + t.vertex2 + t.vertex3) / 3.0f - result.origin) * scale;
+            if (thin.test(voxelIndex(p.x(), thin.sizeX()), voxelIndex(p.y(), thin.sizeY()),
+                          voxelIndex(p.z(), thin.sizeZ()))) {
+                colors[i] = thinColor;
+            }
+        }
+    });
+    return colors;
+}
+
+VoxelSurface MeshVoxelizer::surface(const VoxelizationResult& result, int maxResolution)
+{
+    VoxelSurface surface;
+    const VoxelGrid& solid = result.solid;
+    if (solid.isEmpty() || maxResolution < 1) return surface;
+
+    // Blocks of factor^3 voxels, set when any voxel in them is
+    const int longest = qMax(solid.sizeX(), qMax(solid.sizeY(), solid.sizeZ()));
+    const int factor = qMax(1, (longest + maxResolution - 1) / maxResolution);
+    const int sizeX = (solid.sizeX() + factor - 1) / factor;
+    const int sizeY = (solid.sizeY() + factor - 1) / factor;
+    const int sizeZ = (solid.sizeZ() + factor - 1) / factor;
+    VoxelGrid blocks(sizeX, sizeY, sizeZ);
+    VoxelGrid thinBlocks(sizeX, sizeY, sizeZ);
+    const bool hasThin = !result.thinWalls.isEmpty();
+
+    parallelFor(sizeZ, 1, [&](qsizetype zBlock, qsizetype) {
+        const int words = solid.wordsPerRow();
+        QVector<quint64> solidRow(words);
+        QVector<quint64> thinRow(words);
+        for (int y = 0; y < sizeY; ++y) {
+            // OR the block's rows together, then test each block's span
+            std::fill(solidRow.begin(), solidRow.end(), 0);
+            std::fill(thinRow.begin(), thinRow.end(), 0);
+            for (int z = zBlock * factor; z < qMin(int(zBlock + 1) * factor, solid.sizeZ()); ++z) {
+                for (int fy = y * factor; fy < qMin((y + 1) * factor, solid.sizeY()); ++fy) {
+                    const quint64* row = solid.row(fy, z);
+                    for (int w = 0; w < words; ++w) {
+                        solidRow[w] |= row[w];
+                    }
+                    if (hasThin) {
+                        const quint64* thin = result.thinWalls.row(fy, z);
+                        for (int w = 0; w < words; ++w) {
+                            thinRow[w] |= thin[w];
+                        }
+                    }
+                }
+            }
+            for (int x = 0; x < sizeX; ++x) {
+                const int begin = x * factor;
+                const int end = qMin(begin + factor, solid.sizeX());
+                if (anyBits(solidRow.constData(), begin, end)) {
+                    blocks.set(x, y, int(zBlock));
+                    if (anyBits(thinRow.constData(), begin, end)) {
+                        thinBlocks.set(x, y, int(zBlock));
+                    }
+                }
+            }
+        }
+    });
+
+    // Outward faces of the unit cube, counter-clockwise from outside
+    static const int kFaceCorners[6][4][3] = {
+        {{0, 0, 0}, {0, 0, 1}, {0, 1, 1}, {0, 1, 0}},
+        {{1, 0, 0}, {1, 1, 0}, {1, 1, 1}, {1, 0, 1}},
+        {{0, 0, 0}, {1, 0, 0}, {1, 0, 1}, {0, 0, 1}},
+        {{0, 1, 0}, {0, 1, 1}, {1, 1, 1}, {1, 1, 0}},
+        {{0, 0, 0}, {0, 1, 0}, {1, 1, 0}, {1, 0, 0}},
+        {{0, 0, 1}, {1, 0, 1}, {1, 1, 1}, {0, 1, 1}},
+    };
+    static const int kFaceNormals[6][3] = {
+        {-1, 0, 0}, {1, 0, 0}, {0, -1, 0}, {0, 1, 0}, {0, 0, -1}, {0, 0, 1},
+    };
+
+    const float blockSize = result.voxelSize * factor;
+    const quint16 thinColor = STLLoader::packFacetColor(31, 0, 0);
+    QVector<VoxelSurface> layers(sizeZ);
+    parallelFor(sizeZ, 1, [&](qsizetype zIndex, qsizetype) {
+        const int z = int(zIndex);
+        VoxelSurface& layer = layers[z];
+        for (int y = 0; y < sizeY; ++y) {
+            for (int x = 0; x < sizeX; ++x) {
+                if (!blocks.test(x, y, z)) continue;
+                const quint16 color = thinBlocks.test(x, y, z) ? thinColor : quint16(0);
+                for (int face = 0; face < 6; ++face) {
+                    const int nx = x + kFaceNormals[face][0];
+                    const int ny = y + kFaceNormals[face][1];
+                    const int nz = z + kFaceNormals[face][2];
+                    if (nx >= 0 && ny >= 0 && nz >= 0 && nx < sizeX && ny < sizeY && nz < sizeZ
+                        && blocks.test(nx, ny, nz)) {
+                        continue;
+                    }
+                    QVector3D corners[4];
+                    for (int k = 0; k < 4; ++k) {
+                        corners[k] = result.origin
+                                   + QVector3D(x + kFaceCorners[face][k][0],
+                                               y + kFaceCorners[face][k][1],
+                                               z + kFaceCorners[face][k][2]) * blockSize;
+                    }
+                    const QVector3D normal(kFaceNormals[face][0], kFaceNormals[face][1],
+                                           kFaceNormals[face][2]);
+                    for (int k : {0, 1, 2, 0, 2, 3}) {
+                        layer.vertices.append(corners[k]);
+                        layer.normals.append(normal);
+                    }
+                    layer.faceColors.append(color);
+                    layer.faceColors.append(color);
+                }
+            }
+        }
+    });
+
+    qsizetype triangleCount = 0;
+    for (const VoxelSurface& layer : std::as_const(layers)) {
+        triangleCount += layer.faceColors.size();
+    }
+    surface.vertices.reserve(triangleCount * 3);
+    surface.normals.reserve(triangleCount * 3);
+    surface.faceColors.reserve(triangleCount);
+    for (const VoxelSurface& layer : std::as_const(layers)) {
+        surface.vertices.append(layer.vertices);
+        surface.normals.append(layer.normals);
+        surface.faceColors.append(layer.faceColors);
+    }
+    return surface;
+}
@@ -0,0 +1,148 @@
+#include "meshwelder.h"
+#include "stlviewer.h"
+#include "parallelfor.h"
+#include <atomic>
+#include <cstring>
+#include <memory>
+
+namespace {
+
+const quint64 kEmptySlot = ~quint64(0);
+constexpr qsizetype kGrain = 65536;
+constexpr quint64 kHashMask = 0xFFFFFFFF00000000ull;
+
+quint32 floatBits(float value)
+{
+    // Treat -0.0 and +0.0 as the same position
+    if (value == 0.0f) value = 0.0f;
+    quint32 bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+quint64 positionHash(const QVector3D& p)
+{
+    quint64 h = floatBits(p.x());
+    h = h * 0x9E3779B97F4A7C15ull ^ floatBits(p.y());
+    h = h * 0x9E3779B97F4A7C15ull ^ floatBits(p.z());
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDull;
+    h ^= h >> 33;
+    return h;
+}
+
+bool samePosition(const QVector3D& a, const QVector3D& b)
+{
+    return a.x() == b.x() && a.y() == b.y() && a.z() == b.z();
+}
+
+const QVector3D& corner(const QVector<Triangle>& triangles, qsizetype index)
+{
+    const Triangle& triangle = triangles[index / 3];
+    switch (index % 3) {
+    case 0: return triangle.vertex1;
+    case 1: return triangle.vertex2;
+    default: return triangle.vertex3;
+    }
+}
+
+} // namespace
+
+WeldedMesh MeshWelder::weld(const QVector<Triangle>& triangles)
+{
+    WeldedMesh mesh;
+    const qsizetype cornerCount = triangles.size() * 3;
+    if (cornerCount == 0) return mesh;
+    
+    // Closed meshes have roughly half as many unique vertices as facets;
+    // the table is rebuilt larger if that guess turns out too small
+    qsizetype capacity = 1024;
+    while (capacity < triangles.size()) capacity *= 2;
+    
+    // Slots hold the position hash in the high half next to the corner
+    // index, so most probes are rejected without touching the corner
+    std::unique_ptr<std::atomic<quint64>[]> slots;
+    qsizetype mask = 0;
+    
+    // Pass 1 leaves the slot of each corner here for pass 2 to read back
+    mesh.indices.resize(cornerCount);
+    quint32* indices = mesh.indices.data();
+    
+    // Pass 1: every slot ends up holding the lowest corner index with its
+    // position, whatever order the threads insert in
+    for (;;) {
+        slots.reset(new std::atomic<quint64>[capacity]);
+        mask = capacity - 1;
+        parallelFor(capacity, kGrain, [&](qsizetype begin, qsizetype end) {
+            for (qsizetype i = begin; i < end; ++i) {
+                slots[i].store(kEmptySlot, std::memory_order_relaxed);
+            }
+        });
+        
+        std::atomic<qsizetype> used(0);
+        std::atomic<bool> overflow(false);
+        const qsizetype limit = capacity / 2;
+        
+        parallelFor(cornerCount, kGrain, [&](qsizetype begin, qsizetype end) {
+            for (qsizetype i = begin; i < end && !overflow.load(std::memory_order_relaxed); ++i) {
+                const QVector3D& p = corner(triangles, i);
+                const quint64 hash = positionHash(p);
+                const quint64 entry = (hash & kHashMask) | quint64(i);
+                qsizetype slot = qsizetype(hash) & mask;
+                for (;;) {
+                    quint64 stored = slots[slot].load(std::memory_order_relaxed);
+                    if (stored == kEmptySlot) {
+                        if (slots[slot].compare_exchange_strong(stored, entry,
+                                                                std::memory_order_relaxed)) {
+                            if (used.fetch_add(1, std::memory_order_relaxed) + 1 > limit) {
+                                overflow.store(true, std::memory_order_relaxed);
+                            }
+                            indices[i] = quint32(slot);
+                            break;
+                        }
+                        // Lost the race; 'stored' now holds the winner
+                    }
+                    if ((stored & kHashMask) == (hash & kHashMask)
+                        && samePosition(corner(triangles, qsizetype(quint32(stored))), p)) {
+                        // Same hash half, so comparing entries compares corners
+                        while (entry < stored
+                               && !slots[slot].compare_exchange_weak(stored, entry,
+                                                                     std::memory_order_relaxed)) {
+                        }
+                        indices[i] = quint32(slot);
+                        break;
+                    }
+                    slot = (slot + 1) & mask;
+                }
+            }
+        });
+        
+        if (!overflow.load()) break;
+        capacity *= 4;
+    }
+    
+    // Pass 2: each corner reads the first corner sharing its position
+    parallelFor(cornerCount, kGrain, [&](qsizetype begin, qsizetype end) {
+        for (qsizetype i = begin; i < end; ++i) {
+            indices[i] = quint32(slots[indices[i]].load(std::memory_order_relaxed));
+        }
+    });
+    slots.reset();
+    
+    mesh.positions.reserve(triangles.size() / 2 + 3);
+    
+    // Number vertices by first appearance. A corner's first occurrence is at
+    // or before it, so its vertex number has already been assigned.
+    for (qsizetype i = 0; i < cornerCount; ++i) {
+        const quint32 first = indices[i];
+        if (first == quint32(i)) {
+            indices[i] = quint32(mesh.positions.size());
+            mesh.positions.append(corner(triangles, i));
+        } else {
+            indices[i] = indices[first];
+        }
+    }
+    
+    mesh.positions.squeeze();
+    return mesh;
+}
@@ -0,0 +1,89 @@
+#include "orientationpanel.h"
+#include <QTableWidget>
+#include <QHeaderView>
+#include <QVBoxLayout>
+#include <QSignalBlocker>
+
+OrientationPanel::OrientationPanel(QWidget *parent)
+    : QWidget(parent)
+    , m_summaryLabel(nullptr)
+    , m_table(nullptr)
+{
+    QVBoxLayout* layout = new QVBoxLayout(this);
+
+    m_summaryLabel = new QLabel(this);
+    m_summaryLabel->setWordWrap(true);
+    m_summaryLabel->setTextInteractionFlags(Qt::TextSelectableByMouse);
+    layout->addWidget(m_summaryLabel);
+
+    m_table = new QTableWidget(0, ColumnCount, this);
+    m_table->setHorizontalHeaderLabels({"Up", "Height", "Support", "Footprint", "Score"});
+    m_table->verticalHeader()->setDefaultSectionSize(fontMetrics().height() + 6);
+    m_table->horizontalHeader()->setSectionResizeMode(QHeaderView::ResizeToContents);
+    m_table->horizontalHeader()->setStretchLastSection(true);
+    m_table->setSelectionBehavior(QAbstractItemView::SelectRows);
+    m_table->setSelectionMode(QAbstractItemView::SingleSelection);
+    m_table->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    layout->addWidget(m_table);
+
+    QLabel* legend = new QLabel("The hull and the minimal box are drawn over the model. Select a row to "
+                                "show its supports in the Overhangs view and its upright box.", this);
+    legend->setWordWrap(true);
+    layout->addWidget(legend);
+
+    connect(m_table, &QTableWidget::itemSelectionChanged, this, &OrientationPanel::onSelectionChanged);
+}
+
+void OrientationPanel::setResult(const OrientationResult& result)
+{
+    const QVector3D boxSize = result.box.size();
+    const double boundsVolume = double(result.boundsSize.x()) * result.boundsSize.y() * result.boundsSize.z();
+    m_summaryLabel->setText(QString("Hull: %1 vertices, %2 faces (%3 ms)\n"
+                                    "Minimal box: %4 x %5 x %6, volume %7 (%8 ms)\n"
+                                    "Axis-aligned box volume: %9\n"
+                                    "%10 directions searched in %11 ms")
+                           .arg(result.hull.vertices.size())
+                           .arg(result.hull.faceCount())
+                           .arg(result.hull.elapsedMs)
+                           .arg(boxSize.x(), 0, 'g', 5)
+                           .arg(boxSize.y(), 0, 'g', 5)
+                           .arg(boxSize.z(), 0, 'g', 5)
+                           .arg(result.box.volume(), 0, 'g', 5)
+                           .arg(result.box.elapsedMs)
+                           .arg(boundsVolume, 0, 'g', 5)
+                           .arg(result.evaluated)
+                           .arg(result.searchMs));
+
+    QSignalBlocker blocker(m_table);
+    m_table->clearContents();
+    m_table->setRowCount(int(result.candidates.size()));
+    m_candidates = result.candidates;
+
+    for (int row = 0; row < result.candidates.size(); ++row) {
+        const OrientationCandidate& candidate = result.candidates[row];
+        m_table->setItem(row, UpColumn, new QTableWidgetItem(QString("%1, %2, %3")
+                                                             .arg(candidate.up.x(), 0, 'f', 3)
+                                                             .arg(candidate.up.y(), 0, 'f', 3)
+                                                             .arg(candidate.up.z(), 0, 'f', 3)));
+        m_table->setItem(row, HeightColumn, new QTableWidgetItem(QString::number(candidate.height, 'g', 5)));
+        m_table->setItem(row, SupportColumn, new QTableWidgetItem(QString::number(candidate.supportArea, 'g', 5)));
+        m_table->setItem(row, FootprintColumn, new QTableWidgetItem(QString::number(candidate.footprintArea, 'g', 5)));
+        m_table->setItem(row, ScoreColumn, new QTableWidgetItem(QString::number(candidate.score, 'f', 3)));
+    }
+}
+
+void OrientationPanel::clear()
+{
+    QSignalBlocker blocker(m_table);
+    m_table->setRowCount(0);
+    m_candidates.clear();
+    m_summaryLabel->clear();
+}
+
+void OrientationPanel::onSelectionChanged()
+{
+    const QModelIndexList selected = m_table->selectionModel()->selectedRows();
+    if (!selected.isEmpty()) {
+        emit candidateSelected(m_candidates[selected.first().row()]);
+    }
+}
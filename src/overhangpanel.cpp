@@ -0,0 +1,122 @@
+#include "overhangpanel.h"
+#include <QSlider>
+#include <QFormLayout>
+#include <QVBoxLayout>
+#include <QMatrix4x4>
+#include <QHBoxLayout>
+#include <QtMath>
+#include <cmath>
+
+namespace {
+// Self-supporting angle from vertical for most FDM materials
+const int kDefaultCriticalAngle = 45;
+}
+
+OverhangPanel::OverhangPanel(QWidget *parent)
+    : QWidget(parent)
+    , m_tiltXSlider(nullptr)
+    , m_tiltYSlider(nullptr)
+    , m_criticalSlider(nullptr)
+    , m_statsLabel(nullptr)
+    , m_updating(false)
+{
+    QVBoxLayout* layout = new QVBoxLayout(this);
+    QFormLayout* form = new QFormLayout();
+    layout->addLayout(form);
+
+    m_tiltXSlider = addSlider(form, "Tilt X", -180, 180, 0);
+    m_tiltYSlider = addSlider(form, "Tilt Y", -180, 180, 0);
+    m_criticalSlider = addSlider(form, "Critical angle", 0, 89, kDefaultCriticalAngle);
+
+    m_statsLabel = new QLabel(this);
+    m_statsLabel->setTextInteractionFlags(Qt::TextSelectableByMouse);
+    layout->addWidget(m_statsLabel);
+
+    QLabel* legend = new QLabel("Yellow to red: overhang needing support\n"
+                                "Blue: resting on the build plate", this);
+    legend->setWordWrap(true);
+    layout->addWidget(legend);
+
+    layout->addStretch();
+}
+
+QSlider* OverhangPanel::addSlider(QFormLayout* form, const QString& label,
+                                  int minimum, int maximum, int value)
+{
+    QSlider* slider = new QSlider(Qt::Horizontal, this);
+    slider->setRange(minimum, maximum);
+    slider->setValue(value);
+
+    QLabel* valueLabel = new QLabel(QString("%1°").arg(value), this);
+    valueLabel->setMinimumWidth(fontMetrics().horizontalAdvance("-180°"));
+
+    QHBoxLayout* row = new QHBoxLayout();
+    row->addWidget(slider);
+    row->addWidget(valueLabel);
+    form->addRow(label, row);
+
+    // Dragging reclassifies on every step; the pass is cheap enough
+    connect(slider, &QSlider::valueChanged, this, [this, valueLabel](int degrees) {
+        valueLabel->setText(QString("%1°").arg(degrees));
+        if (!m_updating) {
+            emit parametersChanged();
+        }
+    });
+    return slider;
+}
+
+QVector3D OverhangPanel::buildDirection() const
+{
+    // The part is tilted about the printer's X then Y axis; the printer's Z
+    // seen from the part is the inverse rotation applied to Z
+    QMatrix4x4 tilt;
+    tilt.rotate(float(m_tiltYSlider->value()), 0.0f, 1.0f, 0.0f);
+    tilt.rotate(float(m_tiltXSlider->value()), 1.0f, 0.0f, 0.0f);
+    return tilt.transposed().mapVector(QVector3D(0.0f, 0.0f, 1.0f));
+}
+
+void OverhangPanel::setBuildDirection(const QVector3D& up)
+{
+    // Inverse of buildDirection(), which maps Z to
+    // (-sin tiltY, sin tiltX cos tiltY, cos tiltX cos tiltY)
+    const QVector3D n = up.normalized();
+    const float tiltX = qRadiansToDegrees(std::atan2(n.y(), n.z()));
+    const float tiltY = qRadiansToDegrees(std::atan2(-n.x(), std::hypot(n.y(), n.z())));
+
+    m_updating = true;
+    m_tiltXSlider->setValue(qRound(tiltX));
+    m_tiltYSlider->setValue(qRound(tiltY));
+    m_updating = false;
+    emit parametersChanged();
+}
+
+float OverhangPanel::criticalAngle() const
+{
+    return float(m_criticalSlider->value());
+}
+
+void OverhangPanel::setResult(const OverhangResult& result)
+{
+    const double percent = result.totalArea > 0.0 ? 100.0 * result.overhangArea / result.totalArea : 0.0;
+    m_statsLabel->setText(QString("Overhang area: %1 (%2% of surface)\n"
+                                  "Overhang facets: %3\n"
+                                  "On build plate: %4\n"
+                                  "Total area: %5\n"
+                                  "Time: %6 ms")
+                         .arg(result.overhangArea, 0, 'g', 6)
+                         .arg(percent, 0, 'f', 1)
+                         .arg(result.overhangFacets)
+                         .arg(result.plateArea, 0, 'g', 6)
+                         .arg(result.totalArea, 0, 'g', 6)
+                         .arg(result.elapsedMs, 0, 'f', 1));
+}
+
+void OverhangPanel::reset()
+{
+    m_updating = true;
+    m_tiltXSlider->setValue(0);
+    m_tiltYSlider->setValue(0);
+    m_criticalSlider->setValue(kDefaultCriticalAngle);
+    m_updating = false;
+    m_statsLabel->clear();
+}
@@ -1,10 +1,19 @@
 #include "stlloader.h"
 #include "stlviewer.h"
+#include "geometrykernels.h"
 #include <QTextStream>
 #include <QDebug>
 #include <QRegularExpression>
+#include <QtEndian>
+#include <cstring>
 
-QVector<Triangle> STLLoader::loadSTL(const QString& filename, QString& error)
+namespace {
+// Normal, three vertices and the attribute word
+const qint64 kBinaryFacetSize = 50;
+}
+
+QVector<Triangle> STLLoader::loadSTL(const QString& filename, QString& error,
+                                     QVector<quint16>* facetColors)
 {
     QFile file(filename);
     if (!file.open(QIODevice::ReadOnly)) {
@@ -14,8 +23,12 @@ QVector<Triangle> STLLoader::loadSTL(const QString& filename, QString& error)
     
     QVector<Triangle> triangles;
     
+    if (facetColors) {
+        facetColors->clear();
+    }
+    
     if (isBinarySTL(file)) {
-        triangles = loadBinarySTL(file, error);
+        triangles = loadBinarySTL(file, error, facetColors);
     } else {
         triangles = loadAsciiSTL(file, error);
     }
@@ -60,14 +73,16 @@ bool STLLoader::isBinarySTL(QFile& file)
     return (file.size() == expectedSize);
 }
 
-QVector<Triangle> STLLoader::loadBinarySTL(QFile& file, QString& error)
+QVector<Triangle> STLLoader::loadBinarySTL(QFile& file, QString& error,
+                                            QVector<quint16>* facetColors)
 {
     QVector<Triangle> triangles;
     
-    file.seek(80); // Skip 80-byte header
+    file.seek(0);
+    const QByteArray header = file.read(80);
+    
     QDataStream stream(&file);
     stream.setByteOrder(QDataStream::LittleEndian);
-    stream.setFloatingPointPrecision(QDataStream::SinglePrecision);
     
     quint32 triangleCount;
     stream >> triangleCount;
@@ -82,51 +97,153 @@ QVector<Triangle> STLLoader::loadBinarySTL(QFile& file, QString& error)
         return triangles;
     }
     
-    triangles.reserve(triangleCount);
+    // Read all facet records in one go and decode them from memory; mapping
+    // the file avoids a copy when the platform supports it
+    const qint64 payloadSize = qint64(triangleCount) * kBinaryFacetSize;
+    QByteArray buffer;
+    const uchar* data = file.map(84, payloadSize);
+    if (!data) {
+        buffer = file.read(payloadSize);
+        if (buffer.size() != payloadSize) {
+            error = QString("Error reading binary STL file at triangle %1")
+                        .arg(buffer.size() / kBinaryFacetSize);
+            return triangles;
+        }
+        data = reinterpret_cast<const uchar*>(buffer.constData());
+    }
+    
+    const FacetColorFormat colorFormat = facetColorFormat(header);
+    const quint16 defaultColor = materialiseDefaultColor(header);
+    QVector<quint16> colors(facetColors ? qsizetype(triangleCount) : 0);
+    bool anyColor = false;
+    QVector<quint32> missingNormals;
+    
+    triangles.resize(triangleCount);
     
     for (quint32 i = 0; i < triangleCount; ++i) {
-        Triangle triangle;
+        const uchar* record = data + qint64(i) * kBinaryFacetSize;
+        Triangle& triangle = triangles[i];
         
-        // Read normal vector
-        float nx, ny, nz;
-        stream >> nx >> ny >> nz;
-        triangle.normal = QVector3D(nx, ny, nz);
+        triangle.normal = readVector(record);
+        triangle.vertex1 = readVector(record + 12);
+        triangle.vertex2 = readVector(record + 24);
+        triangle.vertex3 = readVector(record + 36);
         
-        // Read vertices
-        float x1, y1, z1, x2, y2, z2, x3, y3, z3;
-        stream >> x1 >> y1 >> z1;
-        stream >> x2 >> y2 >> z2;
-        stream >> x3 >> y3 >> z3;
-        
-        triangle.vertex1 = QVector3D(x1, y1, z1);
-        triangle.vertex2 = QVector3D(x2, y2, z2);
-        triangle.vertex3 = QVector3D(x3, y3, z3);
-        
-        // Skip attribute byte count (2 bytes)
-        quint16 attributeByteCount;
-        stream >> attributeByteCount;
+        // Attribute word: facet color in exporters that use it
+        if (facetColors) {
+            const quint16 attribute = qFromLittleEndian<quint16>(record + 48);
+            colors[i] = decodeFacetColor(attribute, colorFormat, defaultColor);
+            anyColor |= (colors[i] & kFacetColorValid) != 0;
+        }
         
         // If normal is zero, calculate it from vertices
         if (triangle.normal.lengthSquared() == 0) {
-            QVector3D v1 = triangle.vertex2 - triangle.vertex1;
-            QVector3D v2 = triangle.vertex3 - triangle.vertex1;
-            triangle.normal = QVector3D::crossProduct(v1, v2).normalized();
+            missingNormals.append(i);
+        }
+    }
+    
+    if (buffer.isEmpty()) {
+        file.unmap(const_cast<uchar*>(data));
+    }
+    
+    computeMissingNormals(triangles, missingNormals);
+    
+    if (facetColors) {
+        // Uncolored files keep the single object color path
+        *facetColors = anyColor ? colors : QVector<quint16>();
+    }
+    
+    return triangles;
+}
+
+STLLoader::FacetColorFormat STLLoader::facetColorFormat(const QByteArray& header)
+{
+    // Materialise Magics writes "COLOR=" (and "MATERIAL=") into the header;
+    // anything else is read with the VisCAM/SolidView convention
+    return header.contains("COLOR=") ? FacetColorFormat::Materialise
+                                     : FacetColorFormat::VisCAM;
+}
+
+quint16 STLLoader::materialiseDefaultColor(const QByteArray& header)
+{
+    // "COLOR=" is followed by the object color as R, G, B, A bytes
+    const qsizetype index = header.indexOf("COLOR=");
+    if (index < 0 || index + 6 + 3 > header.size()) {
+        return 0;
+    }
+    const uchar r = uchar(header[index + 6]);
+    const uchar g = uchar(header[index + 7]);
+    const uchar b = uchar(header[index + 8]);
+    return packFacetColor(r >> 3, g >> 3, b >> 3);
+}
+
+quint16 STLLoader::decodeFacetColor(quint16 attribute, FacetColorFormat format,
+                                    quint16 defaultColor)
+{
+    const quint16 low = attribute & 0x1F;
+    const quint16 mid = (attribute >> 5) & 0x1F;
+    const quint16 high = (attribute >> 10) & 0x1F;
+    const bool flag = (attribute & 0x8000) != 0;
+    
+    switch (format) {
+    case FacetColorFormat::VisCAM:
+        // Bit 15 set marks a valid color, stored as BGR (blue in the low bits)
+        return flag ? packFacetColor(high, mid, low) : 0;
+    case FacetColorFormat::Materialise:
+        // Bit 15 clear marks a per-facet color, stored as RGB (red in the low
+        // bits); set means "use the object color from the header"
+        return flag ? defaultColor : packFacetColor(low, mid, high);
+    }
+    return 0;
+}
+
+quint16 STLLoader::packFacetColor(quint16 r5, quint16 g5, quint16 b5)
+{
+    return quint16(kFacetColorValid | (b5 << 10) | (g5 << 5) | r5);
+}
+
+void STLLoader::computeMissingNormals(QVector<Triangle>& triangles,
+                                      const QVector<quint32>& facets)
+{
+    // Gather the facets into structure-of-arrays blocks for the vector kernel
+    PointBlock a, b, c, n;
+    
+    for (qsizetype begin = 0; begin < facets.size(); begin += PointBlock::kSize) {
+        const qsizetype count = qMin(PointBlock::kSize, facets.size() - begin);
+        
+        for (qsizetype i = 0; i < count; ++i) {
+            const Triangle& triangle = triangles[facets[begin + i]];
+            a.set(i, triangle.vertex1.x(), triangle.vertex1.y(), triangle.vertex1.z());
+            b.set(i, triangle.vertex2.x(), triangle.vertex2.y(), triangle.vertex2.z());
+            c.set(i, triangle.vertex3.x(), triangle.vertex3.y(), triangle.vertex3.z());
         }
         
-        triangles.append(triangle);
+        GeometryKernels::facetNormals(a.constPoints(), b.constPoints(), c.constPoints(),
+                                      n.points(), count);
         
-        if (stream.status() != QDataStream::Ok) {
-            error = QString("Error reading binary STL file at triangle %1").arg(i);
-            return QVector<Triangle>();
+        for (qsizetype i = 0; i < count; ++i) {
+            triangles[facets[begin + i]].normal = QVector3D(n.x[i], n.y[i], n.z[i]);
         }
     }
-    
-    return triangles;
+}
+
+QVector3D STLLoader::readVector(const uchar* data)
+{
+    return QVector3D(readFloat(data), readFloat(data + 4), readFloat(data + 8));
+}
+
+float STLLoader::readFloat(const uchar* data)
+{
+    const quint32 bits = qFromLittleEndian<quint32>(data);
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
 }
 
 QVector<Triangle> STLLoader::loadAsciiSTL(QFile& file, QString& error)
 {
     QVector<Triangle> triangles;
+    QVector<quint32> missingNormals;
     
     file.seek(0);
     QTextStream stream(&file);
@@ -217,9 +334,7 @@ QVector<Triangle> STLLoader::loadAsciiSTL(QFile& file, QString& error)
             
             // If normal is zero, calculate it from vertices
             if (currentTriangle.normal.lengthSquared() == 0) {
-                QVector3D v1 = currentTriangle.vertex2 - currentTriangle.vertex1;
-                QVector3D v2 = currentTriangle.vertex3 - currentTriangle.vertex1;
-                currentTriangle.normal = QVector3D::crossProduct(v1, v2).normalized();
+                missingNormals.append(quint32(triangles.size()));
             }
             
             triangles.append(currentTriangle);
@@ -231,5 +346,6 @@ QVector<Triangle> STLLoader::loadAsciiSTL(QFile& file, QString& error)
         error = "No triangles found in ASCII STL file";
     }
     
+    computeMissingNormals(triangles, missingNormals);
     return triangles;
 }
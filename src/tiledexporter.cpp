@@ -0,0 +1,181 @@
+#include "tiledexporter.h"
+#include "meshscene.h"
+#include "imagestreamwriter.h"
+#include <QOpenGLContext>
+#include <QOpenGLExtraFunctions>
+#include <QOpenGLFramebufferObject>
+#include <QOffscreenSurface>
+#include <QElapsedTimer>
+#include <QDebug>
+#include <memory>
+
+namespace {
+// Upper bound on the tile edge; the band buffer is image width x this
+constexpr int kMaxTileSize = 1024;
+}
+
+bool TiledExporter::exportImage(MeshScene* scene, const ExportView& view, const QSize& size,
+                                const QString& filename, QString& error, ExportStats* stats)
+{
+    if (!scene->isLoaded()) {
+        error = "No model is loaded";
+        return false;
+    }
+    if (size.isEmpty()) {
+        error = "Image size must be positive";
+        return false;
+    }
+    
+    std::unique_ptr<ImageStreamWriter> writer = ImageStreamWriter::create(filename);
+    if (!writer) {
+        error = "Unsupported image format; use .png, .tif or .tiff";
+        return false;
+    }
+    
+    QElapsedTimer timer;
+    timer.start();
+    
+    // A context of its own in the scene's share group, so this works the
+    // same with or without any window on screen
+    QOpenGLContext context;
+    context.setShareContext(QOpenGLContext::globalShareContext());
+    context.setFormat(QSurfaceFormat::defaultFormat());
+    if (!context.create()) {
+        error = "Cannot create an OpenGL context for export";
+        return false;
+    }
+    
+    QOffscreenSurface surface;
+    surface.setFormat(context.format());
+    surface.create();
+    if (!context.makeCurrent(&surface)) {
+        error = "Cannot make the export context current";
+        return false;
+    }
+    
+    QOpenGLExtraFunctions* f = context.extraFunctions();
+    
+    GLint maxRenderbuffer = 0;
+    GLint maxViewport[2] = {0, 0};
+    f->glGetIntegerv(GL_MAX_RENDERBUFFER_SIZE, &maxRenderbuffer);
+    f->glGetIntegerv(GL_MAX_VIEWPORT_DIMS, maxViewport);
+    const int tileSize = qMin(qMin(kMaxTileSize, int(maxRenderbuffer)),
+                              qMin(int(maxViewport[0]), int(maxViewport[1])));
+    const int tileWidth = qMin(tileSize, size.width());
+    const int tileHeight = qMin(tileSize, size.height());
+    
+    // Tiles are drawn multisampled like the viewports, then resolved into a
+    // plain framebuffer to be read back
+    QOpenGLFramebufferObjectFormat format;
+    format.setAttachment(QOpenGLFramebufferObject::Depth);
+    format.setSamples(qMax(0, QSurfaceFormat::defaultFormat().samples()));
+    std::unique_ptr<QOpenGLFramebufferObject> target(
+        new QOpenGLFramebufferObject(tileWidth, tileHeight, format));
+    std::unique_ptr<QOpenGLFramebufferObject> resolved(
+        new QOpenGLFramebufferObject(tileWidth, tileHeight));
+    if (!target->isValid() || !resolved->isValid()) {
+        error = "Cannot create the export framebuffers";
+        context.doneCurrent();
+        return false;
+    }
+    
+    // Same state the viewports set up in initializeGL()
+    f->glClearColor(0.9f, 0.9f, 0.9f, 1.0f);
+    f->glEnable(GL_DEPTH_TEST);
+    f->glEnable(GL_CULL_FACE);
+    f->glCullFace(GL_BACK);
+    f->glEnable(GL_POLYGON_OFFSET_FILL);
+    f->glPolygonOffset(1.0f, 1.0f);
+    f->glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    
+    if (!writer->begin(filename, size.width(), size.height(), error)) {
+        context.doneCurrent();
+        return false;
+    }
+    
+    const qsizetype bandRowBytes = qsizetype(size.width()) * 3;
+    QByteArray band(bandRowBytes * tileHeight, Qt::Uninitialized);
+    QByteArray tilePixels(qsizetype(tileWidth) * tileHeight * 4, Qt::Uninitialized);
+    int tiles = 0;
+    bool ok = true;
+    
+    for (int y = 0; y < size.height() && ok; y += tileHeight) {
+        const int rows = qMin(tileHeight, size.height() - y);
+        
+        for (int x = 0; x < size.width(); x += tileWidth) {
+            const int columns = qMin(tileWidth, size.width() - x);
+            const QRect tile(x, y, columns, rows);
+            const QRect region(0, 0, columns, rows);
+            
+            target->bind();
+            f->glViewport(0, 0, columns, rows);
+            f->glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            scene->draw(view.model, view.view, tileProjection(view.projection, size, tile),
+                        view.viewPos);
+            
+            QOpenGLFramebufferObject::blitFramebuffer(resolved.get(), region, target.get(), region);
+            resolved->bind();
+            f->glReadPixels(0, 0, columns, rows, GL_RGBA, GL_UNSIGNED_BYTE, tilePixels.data());
+            
+            // Framebuffer rows run bottom-up, image rows top-down
+            const uchar* source = reinterpret_cast<const uchar*>(tilePixels.constData());
+            uchar* destination = reinterpret_cast<uchar*>(band.data());
+            for (int r = 0; r < rows; ++r) {
+                const uchar* in = source + qsizetype(rows - 1 - r) * columns * 4;
+                uchar* out = destination + qsizetype(r) * bandRowBytes + qsizetype(x) * 3;
+                for (int c = 0; c < columns; ++c) {
+                    out[3 * c] = in[4 * c];
+                    out[3 * c + 1] = in[4 * c + 1];
+                    out[3 * c + 2] = in[4 * c + 2];
+                }
+            }
+            ++tiles;
+        }
+        
+        ok = writer->writeRows(reinterpret_cast<const uchar*>(band.constData()), rows, error);
+    }
+    
+    resolved->release();
+    target.reset();
+    resolved.reset();
+    context.doneCurrent();
+    
+    if (!ok || !writer->finish(error)) {
+        return false;
+    }
+    
+    const qint64 pixels = qint64(size.width()) * size.height();
+    const qint64 elapsedMs = timer.elapsed();
+    const double pixelsPerSecond = pixels * 1000.0 / qMax<qint64>(elapsedMs, 1);
+    
+    qInfo().noquote() << QString("Exported %1 (%2 x %3, %4 tiles) in %5 ms: %6 Mpixel/s")
+                             .arg(filename).arg(size.width()).arg(size.height()).arg(tiles)
+                             .arg(elapsedMs).arg(pixelsPerSecond / 1e6, 0, 'f', 1);
+    
+    if (stats) {
+        stats->pixels = pixels;
+        stats->tiles = tiles;
+        stats->elapsedMs = elapsedMs;
+        stats->pixelsPerSecond = pixelsPerSecond;
+    }
+    return true;
+}
+
+QMatrix4x4 TiledExporter::tileProjection(const QMatrix4x4& projection, const QSize& imageSize,
+                                         const QRect& tile)
+{
+    // Normalized device extent of the tile; image y grows downwards
+    const float left = -1.0f + 2.0f * tile.left() / imageSize.width();
+    const float right = -1.0f + 2.0f * (tile.left() + tile.width()) / imageSize.width();
+    const float top = 1.0f - 2.0f * tile.top() / imageSize.height();
+    const float bottom = 1.0f - 2.0f * (tile.top() + tile.height()) / imageSize.height();
+    
+    // Scale and shift x and y in clip space, leaving depth alone. Applied
+    // after the projection, this is the same sub-frustum for perspective
+    // and orthographic views.
+    const QMatrix4x4 crop(2.0f / (right - left), 0.0f, 0.0f, -(right + left) / (right - left),
+                          0.0f, 2.0f / (top - bottom), 0.0f, -(top + bottom) / (top - bottom),
+                          0.0f, 0.0f, 1.0f, 0.0f,
+                          0.0f, 0.0f, 0.0f, 1.0f);
+    return crop * projection;
+}
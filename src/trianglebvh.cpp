@@ -0,0 +1,463 @@
+#include "trianglebvh.h"
+#include "stlviewer.h"
+#include "parallelfor.h"
+#include <QHash>
+#include <algorithm>
+#include <limits>
+
+namespace {
+
+using Node = TriangleBVH::Node;
+
+const quint32 kLeafSize = 4;
+
+// Subtrees below this depth are built as independent parallel tasks
+const int kParallelDepth = 6;
+
+void extendBounds(QVector3D& minBounds, QVector3D& maxBounds, const QVector3D& p)
+{
+    minBounds.setX(qMin(minBounds.x(), p.x()));
+    minBounds.setY(qMin(minBounds.y(), p.y()));
+    minBounds.setZ(qMin(minBounds.z(), p.z()));
+    maxBounds.setX(qMax(maxBounds.x(), p.x()));
+    maxBounds.setY(qMax(maxBounds.y(), p.y()));
+    maxBounds.setZ(qMax(maxBounds.z(), p.z()));
+}
+
+void mergeChildren(QVector<Node>& nodes, quint32 index)
+{
+    Node& node = nodes[index];
+    const Node& left = nodes[index + 1];
+    const Node& right = nodes[node.first];
+    node.minBounds = left.minBounds;
+    node.maxBounds = left.maxBounds;
+    extendBounds(node.minBounds, node.maxBounds, right.minBounds);
+    extendBounds(node.minBounds, node.maxBounds, right.maxBounds);
+}
+
+float boxDistanceSquared(const Node& node, const QVector3D& p)
+{
+    float d2 = 0.0f;
+    for (int axis = 0; axis < 3; ++axis) {
+        const float below = node.minBounds[axis] - p[axis];
+        const float above = p[axis] - node.maxBounds[axis];
+        const float d = qMax(qMax(below, above), 0.0f);
+        d2 += d * d;
+    }
+    return d2;
+}
+
+// Where the ray origin + t * direction, t >= 0, enters the box, or a
+// negative value when it misses; inverse holds 1 / direction per axis
+float rayEntersBox(const Node& node, const QVector3D& origin, const QVector3D& inverse)
+{
+    float enter = 0.0f;
+    float leave = std::numeric_limits<float>::max();
+    for (int axis = 0; axis < 3; ++axis) {
+        const float t1 = (node.minBounds[axis] - origin[axis]) * inverse[axis];
+        const float t2 = (node.maxBounds[axis] - origin[axis]) * inverse[axis];
+        enter = qMax(enter, qMin(t1, t2));
+        leave = qMin(leave, qMax(t1, t2));
+    }
+    return enter <= leave ? enter : -1.0f;
+}
+
+bool rayHitsBox(const Node& node, const QVector3D& origin, const QVector3D& inverse)
+{
+    return rayEntersBox(node, origin, inverse) >= 0.0f;
+}
+
+// Ray parameter where the ray meets the triangle, or a non-positive value
+// when it misses or the triangle lies behind its origin (Möller-Trumbore)
+float rayTriangleDistance(const QVector3D& origin, const QVector3D& direction,
+                          const TriangleBVH::Primitive& prim)
+{
+    const QVector3D e1 = prim.b - prim.a;
+    const QVector3D e2 = prim.c - prim.a;
+    const QVector3D p = QVector3D::crossProduct(direction, e2);
+    const float det = QVector3D::dotProduct(e1, p);
+    if (det == 0.0f) return -1.0f;
+    
+    const float inverse = 1.0f / det;
+    const QVector3D s = origin - prim.a;
+    const float u = QVector3D::dotProduct(s, p) * inverse;
+    if (u < 0.0f || u > 1.0f) return -1.0f;
+    const QVector3D q = QVector3D::crossProduct(s, e1);
+    const float v = QVector3D::dotProduct(direction, q) * inverse;
+    if (v < 0.0f || u + v > 1.0f) return -1.0f;
+    return QVector3D::dotProduct(e2, q) * inverse;
+}
+
+// Whether the ray meets the triangle ahead of its origin
+bool rayHitsTriangle(const QVector3D& origin, const QVector3D& direction,
+                     const TriangleBVH::Primitive& prim)
+{
+    return rayTriangleDistance(origin, direction, prim) > 0.0f;
+}
+
+// Node count of the subtree over n primitives with median splits
+quint32 countNodes(quint32 n, QHash<quint32, quint32>& memo)
+{
+    if (n <= kLeafSize) return 1;
+    const quint32 cached = memo.value(n);
+    if (cached != 0) return cached;
+    const quint32 count = 1 + countNodes(n / 2, memo) + countNodes(n - n / 2, memo);
+    memo.insert(n, count);
+    return count;
+}
+
+// Facet centroid carried through the splits with its facet, so partitioning
+// moves contiguous records instead of chasing indices
+struct Centroid {
+    QVector3D position;
+    quint32 facet;
+};
+
+struct BuildContext {
+    const QVector<Triangle>& triangles;
+    const QHash<quint32, quint32>& nodeCounts;
+    QVector<Node>& nodes;
+    QVector<Centroid>& centroids;
+    
+    quint32 nodeCount(quint32 n) const
+    {
+        return n <= kLeafSize ? 1 : nodeCounts.value(n);
+    }
+    
+    // Median split of [begin, end) along the longest centroid axis
+    quint32 split(quint32 begin, quint32 end) const
+    {
+        QVector3D minBounds = centroids[begin].position;
+        QVector3D maxBounds = minBounds;
+        for (quint32 i = begin + 1; i < end; ++i) {
+            extendBounds(minBounds, maxBounds, centroids[i].position);
+        }
+        
+        const QVector3D extent = maxBounds - minBounds;
+        int axis = 0;
+        if (extent.y() > extent[axis]) axis = 1;
+        if (extent.z() > extent[axis]) axis = 2;
+        
+        const quint32 mid = begin + (end - begin) / 2;
+        Centroid* data = centroids.data();
+        std::nth_element(data + begin, data + mid, data + end,
+                         [axis](const Centroid& a, const Centroid& b) {
+                             return a.position[axis] < b.position[axis];
+                         });
+        return mid;
+    }
+    
+    void buildRange(quint32 index, quint32 begin, quint32 end) const
+    {
+        if (end - begin <= kLeafSize) {
+            Node& leaf = nodes[index];
+            leaf.first = begin;
+            leaf.count = end - begin;
+            const Triangle& t = triangles[centroids[begin].facet];
+            leaf.minBounds = t.vertex1;
+            leaf.maxBounds = t.vertex1;
+            for (quint32 i = begin; i < end; ++i) {
+                const Triangle& u = triangles[centroids[i].facet];
+                extendBounds(leaf.minBounds, leaf.maxBounds, u.vertex1);
+                extendBounds(leaf.minBounds, leaf.maxBounds, u.vertex2);
+                extendBounds(leaf.minBounds, leaf.maxBounds, u.vertex3);
+            }
+            return;
+        }
+        
+        const quint32 mid = split(begin, end);
+        const quint32 left = index + 1;
+        const quint32 right = left + nodeCount(mid - begin);
+        nodes[index].first = right;
+        nodes[index].count = 0;
+        
+        buildRange(left, begin, mid);
+        buildRange(right, mid, end);
+        mergeChildren(nodes, index);
+    }
+};
+
+struct BuildTask {
+    quint32 node;
+    quint32 begin;
+    quint32 end;
+};
+
+} // namespace
+
+TriangleBVH::TriangleBVH(const QVector<Triangle>& triangles)
+{
+    build(triangles);
+}
+
+void TriangleBVH::build(const QVector<Triangle>& triangles)
+{
+    m_nodes.clear();
+    m_primitives.clear();
+    m_facets.clear();
+    
+    const quint32 count = quint32(triangles.size());
+    if (count == 0) return;
+    
+    QVector<Centroid> centroids(count);
+    parallelFor(count, 65536, [&](qsizetype begin, qsizetype end) {
+        for (qsizetype i = begin; i < end; ++i) {
+            const Triangle& t = triangles[i];
+            centroids[i] = {(t.vertex1 + t.vertex2 + t.vertex3) / 3.0f, quint32(i)};
+        }
+    });
+    
+    // Median splits make the layout deterministic, so every subtree's slot
+    // range is known up front and subtrees can be built concurrently
+    QHash<quint32, quint32> nodeCounts;
+    m_nodes.resize(countNodes(count, nodeCounts));
+    const BuildContext context{triangles, nodeCounts, m_nodes, centroids};
+    
+    QVector<BuildTask> tasks;
+    QVector<quint32> interior;
+    QVector<BuildTask> pending{{0, 0, count}};
+    for (int depth = 0; !pending.isEmpty(); ++depth) {
+        // The ranges of one level are disjoint, so their splits run side by
+        // side
+        const bool lastLevel = depth == kParallelDepth;
+        QVector<quint32> mids(pending.size());
+        parallelFor(pending.size(), 1, [&](qsizetype begin, qsizetype end) {
+            for (qsizetype i = begin; i < end; ++i) {
+                const BuildTask& task = pending[i];
+                if (!lastLevel && task.end - task.begin > kLeafSize) {
+                    mids[i] = context.split(task.begin, task.end);
+                }
+            }
+        });
+        
+        QVector<BuildTask> next;
+        for (qsizetype i = 0; i < pending.size(); ++i) {
+            const BuildTask& task = pending[i];
+            if (lastLevel || task.end - task.begin <= kLeafSize) {
+                tasks.append(task);
+                continue;
+            }
+            const quint32 mid = mids[i];
+            const quint32 left = task.node + 1;
+            const quint32 right = left + context.nodeCount(mid - task.begin);
+            m_nodes[task.node].first = right;
+            m_nodes[task.node].count = 0;
+            interior.append(task.node);
+            next.append({left, task.begin, mid});
+            next.append({right, mid, task.end});
+        }
+        pending = next;
+    }
+    
+    parallelFor(tasks.size(), 1, [&](qsizetype begin, qsizetype end) {
+        for (qsizetype i = begin; i < end; ++i) {
+            context.buildRange(tasks[i].node, tasks[i].begin, tasks[i].end);
+        }
+    });
+    
+    // The top levels were split before their children existed; refit them
+    // deepest first
+    for (auto it = interior.crbegin(); it != interior.crend(); ++it) {
+        mergeChildren(m_nodes, *it);
+    }
+    
+    m_primitives.resize(count);
+    m_facets.resize(count);
+    parallelFor(count, 65536, [&](qsizetype begin, qsizetype end) {
+        for (qsizetype i = begin; i < end; ++i) {
+            const quint32 facet = centroids[i].facet;
+            const Triangle& t = triangles[facet];
+            m_primitives[i] = {t.vertex1, t.vertex2, t.vertex3};
+            m_facets[i] = facet;
+        }
+    });
+}
+
+TriangleBVH::NearestHit TriangleBVH::nearest(const QVector3D& point) const
+{
+    NearestHit hit;
+    if (m_nodes.isEmpty()) return hit;
+    
+    float best = std::numeric_limits<float>::max();
+    quint32 stack[64];
+    int top = 0;
+    stack[top++] = 0;
+    
+    while (top > 0) {
+        const Node& node = m_nodes[stack[--top]];
+        if (boxDistanceSquared(node, point) >= best) continue;
+        
+        if (node.isLeaf()) {
+            for (quint32 i = node.first; i < node.first + node.count; ++i) {
+                const Primitive& prim = m_primitives[i];
+                const ClosestPoint q = closestFeatureOnTriangle(point, prim.a, prim.b, prim.c);
+                const float d2 = (point - q.point).lengthSquared();
+                if (d2 < best) {
+                    best = d2;
+                    hit.distanceSquared = d2;
+                    hit.point = q.point;
+                    hit.facet = m_facets[i];
+                    hit.feature = q.feature;
+                    hit.featureIndex = q.featureIndex;
+                }
+            }
+            continue;
+        }
+        
+        // Visit the nearer child first so the far one is usually pruned
+        const quint32 left = quint32(&node - m_nodes.constData()) + 1;
+        const quint32 right = node.first;
+        const float leftDistance = boxDistanceSquared(m_nodes[left], point);
+        const float rightDistance = boxDistanceSquared(m_nodes[right], point);
+        if (leftDistance < rightDistance) {
+            if (rightDistance < best) stack[top++] = right;
+            if (leftDistance < best) stack[top++] = left;
+        } else {
+            if (leftDistance < best) stack[top++] = left;
+            if (rightDistance < best) stack[top++] = right;
+        }
+    }
+    
+    return hit;
+}
+
+TriangleBVH::RayHit TriangleBVH::raycast(const QVector3D& origin, const QVector3D& direction,
+                                         const std::function<bool(quint32)>& accept) const
+{
+    RayHit hit;
+    if (m_nodes.isEmpty()) return hit;
+    
+    // A zero component would make 0 * infinity in the slab test; the
+    // smallest normal float stands in for it
+    QVector3D inverse;
+    for (int axis = 0; axis < 3; ++axis) {
+        const float d = direction[axis];
+        const float nonZero = d != 0.0f ? d : std::numeric_limits<float>::min();
+        inverse[axis] = 1.0f / nonZero;
+    }
+    
+    float best = std::numeric_limits<float>::max();
+    quint32 stack[64];
+    int top = 0;
+    stack[top++] = 0;
+    
+    while (top > 0) {
+        const Node& node = m_nodes[stack[--top]];
+        const float enter = rayEntersBox(node, origin, inverse);
+        if (enter < 0.0f || enter >= best) continue;
+        
+        if (node.isLeaf()) {
+            for (quint32 i = node.first; i < node.first + node.count; ++i) {
+                const float t = rayTriangleDistance(origin, direction, m_primitives[i]);
+                if (t <= 0.0f || t >= best) continue;
+                if (accept && !accept(m_facets[i])) continue;
+                best = t;
+                hit.distance = t;
+                hit.facet = m_facets[i];
+            }
+            continue;
+        }
+        
+        // Visit the child the ray enters first so the other is usually pruned
+        const quint32 left = quint32(&node - m_nodes.constData()) + 1;
+        const quint32 right = node.first;
+        const float leftEnter = rayEntersBox(m_nodes[left], origin, inverse);
+        const float rightEnter = rayEntersBox(m_nodes[right], origin, inverse);
+        if (leftEnter >= 0.0f && rightEnter >= 0.0f && leftEnter < rightEnter) {
+            stack[top++] = right;
+            stack[top++] = left;
+        } else {
+            if (leftEnter >= 0.0f) stack[top++] = left;
+            if (rightEnter >= 0.0f) stack[top++] = right;
+        }
+    }
+    
+    return hit;
+}
+
+bool TriangleBVH::contains(const QVector3D& point) const
+{
+    // Crossing parity along three rays; a ray that grazes an edge or a
+    // vertex, and so counts a crossing twice or not at all, is outvoted.
+    // No direction has a zero component, so the inverses are finite.
+    static const QVector3D directions[3] = {
+        QVector3D(3.0f, 1.0f, 2.0f).normalized(),
+        QVector3D(-1.0f, 3.0f, 1.0f).normalized(),
+        QVector3D(2.0f, -1.0f, -3.0f).normalized()
+    };
+    if (m_nodes.isEmpty()) return false;
+    
+    int inside = 0;
+    for (const QVector3D& direction : directions) {
+        const QVector3D inverse(1.0f / direction.x(), 1.0f / direction.y(), 1.0f / direction.z());
+        int crossings = 0;
+        quint32 stack[64];
+        int top = 0;
+        stack[top++] = 0;
+        while (top > 0) {
+            const quint32 index = stack[--top];
+            const Node& node = m_nodes[index];
+            if (!rayHitsBox(node, point, inverse)) continue;
+            
+            if (node.isLeaf()) {
+                for (quint32 i = node.first; i < node.first + node.count; ++i) {
+                    if (rayHitsTriangle(point, direction, m_primitives[i])) ++crossings;
+                }
+                continue;
+            }
+            stack[top++] = index + 1;
+            stack[top++] = node.first;
+        }
+        if (crossings % 2 != 0) ++inside;
+    }
+    return inside >= 2;
+}
+
+QVector3D TriangleBVH::closestPointOnTriangle(const QVector3D& p, const QVector3D& a,
+                                              const QVector3D& b, const QVector3D& c)
+{
+    return closestFeatureOnTriangle(p, a, b, c).point;
+}
+
+TriangleBVH::ClosestPoint TriangleBVH::closestFeatureOnTriangle(const QVector3D& p, const QVector3D& a,
+                                                                const QVector3D& b, const QVector3D& c)
+{
+    // Voronoi region classification (Ericson, Real-Time Collision Detection 5.1.5)
+    const QVector3D ab = b - a;
+    const QVector3D ac = c - a;
+    const QVector3D ap = p - a;
+    const float d1 = QVector3D::dotProduct(ab, ap);
+    const float d2 = QVector3D::dotProduct(ac, ap);
+    if (d1 <= 0.0f && d2 <= 0.0f) return {a, Feature::Vertex, 0};
+    
+    const QVector3D bp = p - b;
+    const float d3 = QVector3D::dotProduct(ab, bp);
+    const float d4 = QVector3D::dotProduct(ac, bp);
+    if (d3 >= 0.0f && d4 <= d3) return {b, Feature::Vertex, 1};
+    
+    const float vc = d1 * d4 - d3 * d2;
+    if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) {
+        return {a + ab * (d1 / (d1 - d3)), Feature::Edge, 0};
+    }
+    
+    const QVector3D cp = p - c;
+    const float d5 = QVector3D::dotProduct(ab, cp);
+    const float d6 = QVector3D::dotProduct(ac, cp);
+    if (d6 >= 0.0f && d5 <= d6) return {c, Feature::Vertex, 2};
+    
+    const float vb = d5 * d2 - d1 * d6;
+    if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) {
+        return {a + ac * (d2 / (d2 - d6)), Feature::Edge, 2};
+    }
+    
+    const float va = d3 * d6 - d5 * d4;
+    if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f) {
+        return {b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6))), Feature::Edge, 1};
+    }
+    
+    const float denom = va + vb + vc;
+    if (denom == 0.0f) return {a, Feature::Vertex, 0}; // degenerate facet
+    const float v = vb / denom;
+    const float w = vc / denom;
+    return {a + ab * v + ac * w, Feature::Face, 0};
+}
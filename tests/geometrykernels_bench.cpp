@@ -0,0 +1,135 @@
+// Microbenchmarks for the geometry kernels: throughput of each kernel under
+// each instruction set the CPU supports, on one core. Optional arguments are
+// the point count and the number of timed repetitions.
+
+#include "geometrykernels.h"
+#include <QElapsedTimer>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <random>
+#include <vector>
+
+namespace {
+
+using Isa = GeometryKernels::Isa;
+
+struct Points {
+    std::vector<float> x;
+    std::vector<float> y;
+    std::vector<float> z;
+    
+    explicit Points(qsizetype count) : x(count), y(count), z(count) {}
+    
+    PointsSoA soa() { return {x.data(), y.data(), z.data()}; }
+    ConstPointsSoA constSoa() const { return {x.data(), y.data(), z.data()}; }
+};
+
+Points randomPoints(qsizetype count, std::mt19937& random)
+{
+    std::uniform_real_distribution<float> coordinate(-100.0f, 100.0f);
+    Points p(count);
+    for (qsizetype i = 0; i < count; ++i) {
+        p.x[i] = coordinate(random);
+        p.y[i] = coordinate(random);
+        p.z[i] = coordinate(random);
+    }
+    return p;
+}
+
+// Best of the repetitions, in nanoseconds per point
+double bestTime(const std::function<void()>& kernel, qsizetype count, int repetitions)
+{
+    kernel(); // warm the caches and the page tables
+    qint64 best = std::numeric_limits<qint64>::max();
+    for (int r = 0; r < repetitions; ++r) {
+        QElapsedTimer timer;
+        timer.start();
+        kernel();
+        best = std::min(best, timer.nsecsElapsed());
+    }
+    return double(best) / double(count);
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    const qsizetype count = argc > 1 ? std::atoll(argv[1]) : 1 << 20;
+    const int repetitions = argc > 2 ? std::atoi(argv[2]) : 20;
+    if (count <= 0 || repetitions <= 0) {
+        std::fprintf(stderr, "usage: %s [points] [repetitions]\n", argv[0]);
+        return 1;
+    }
+    
+    std::mt19937 random(7);
+    const Points a = randomPoints(count, random);
+    const Points b = randomPoints(count, random);
+    const Points c = randomPoints(count, random);
+    Points out = randomPoints(count, random);
+    std::vector<float> weights(count, 1.0f);
+    std::vector<float> dots(count);
+    const float translation[3] = {1.0f, -2.0f, 3.0f};
+    const float matrix[16] = {0.8f, 0.6f, 0.0f, 0.0f, -0.6f, 0.8f, 0.0f, 0.0f,
+                              0.0f, 0.0f, 1.0f, 0.0f, 5.0f, -5.0f, 2.0f, 1.0f};
+    const float direction[3] = {0.0f, 0.0f, 1.0f};
+    const ConstPointsSoA first[3] = {a.constSoa(), b.constSoa(), c.constSoa()};
+    const ConstPointsSoA second[3] = {c.constSoa(), a.constSoa(), out.constSoa()};
+    std::unique_ptr<bool[]> hits(new bool[count]);
+    
+    // translateScale and transform work in place; alternating the scale and
+    // using a rotation keeps the values bounded over the repetitions
+    float scale = 1.0f;
+    const std::pair<const char*, std::function<void()>> kernels[] = {
+        {"facetNormals", [&] {
+            GeometryKernels::facetNormals(a.constSoa(), b.constSoa(), c.constSoa(), out.soa(), count);
+        }},
+        {"extendBounds", [&] {
+            float minBounds[3] = {1e30f, 1e30f, 1e30f};
+            float maxBounds[3] = {-1e30f, -1e30f, -1e30f};
+            GeometryKernels::extendBounds(a.constSoa(), count, minBounds, maxBounds);
+        }},
+        {"translateScale", [&] {
+            scale = 1.0f / scale * 0.5f;
+            GeometryKernels::translateScale(out.soa(), count, translation, scale);
+        }},
+        {"transform", [&] {
+            GeometryKernels::transform(out.soa(), count, matrix);
+        }},
+        {"facingWeight", [&] {
+            GeometryKernels::facingWeight(a.constSoa(), weights.data(), count, direction, 0.5f,
+                                          dots.data());
+        }},
+        {"trianglesCross", [&] {
+            GeometryKernels::trianglesCross(first, second, count, hits.get());
+        }},
+    };
+    
+    // Picks the initial level and logs it before the table starts
+    GeometryKernels::activeIsa();
+    std::printf("%lld points, best of %d runs, ns per point (Mpoints/s)\n",
+                static_cast<long long>(count), repetitions);
+    std::printf("%-16s", "kernel");
+    const Isa isas[] = {Isa::Scalar, Isa::SSE, Isa::AVX2, Isa::AVX512};
+    for (Isa isa : isas) {
+        std::printf("%20s", GeometryKernels::isaName(isa));
+    }
+    std::printf("\n");
+    
+    for (const auto& kernel : kernels) {
+        std::printf("%-16s", kernel.first);
+        for (Isa isa : isas) {
+            if (!GeometryKernels::setActiveIsa(isa)) {
+                std::printf("%20s", "unsupported");
+                continue;
+            }
+            const double ns = bestTime(kernel.second, count, repetitions);
+            std::printf("%11.3f (%6.0f)", ns, 1e3 / ns);
+        }
+        std::printf("\n");
+    }
+    return 0;
+}
@@ -0,0 +1,452 @@
+// Runs every geometry kernel under each instruction set the CPU supports and
+// checks that the results agree bit for bit with the scalar path, then
+// checks the triangle tests and the BVH point query against known answers.
+
+#include "geometrykernels.h"
+#include "meshinterference.h"
+#include "trianglebvh.h"
+#include "stlviewer.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <random>
+#include <vector>
+
+namespace {
+
+using Isa = GeometryKernels::Isa;
+
+const Isa kIsas[] = {Isa::Scalar, Isa::SSE, Isa::AVX2, Isa::AVX512};
+
+// Lengths around every vector width and partial-sum stride, so each tail
+// path runs
+const qsizetype kCounts[] = {0, 1, 3, 4, 7, 8, 15, 16, 17, 31, 33, 100, 1023, 4099};
+
+int g_failures = 0;
+
+struct Points {
+    std::vector<float> x;
+    std::vector<float> y;
+    std::vector<float> z;
+    
+    explicit Points(qsizetype count = 0) : x(count), y(count), z(count) {}
+    
+    PointsSoA soa() { return {x.data(), y.data(), z.data()}; }
+    ConstPointsSoA constSoa() const { return {x.data(), y.data(), z.data()}; }
+};
+
+// Values that stress rounding and special cases: signed zeros, denormals,
+// huge magnitudes whose products overflow, infinities and NaN
+float edgeValue(std::mt19937& random)
+{
+    static const float values[] = {
+        0.0f, -0.0f, 1.0f, -1.0f, 0.5f, 1e-3f, -1e-3f,
+        std::numeric_limits<float>::denorm_min(), -std::numeric_limits<float>::denorm_min(),
+        std::numeric_limits<float>::min(), 1e-30f, 1e20f, -1e20f, 3e38f, -3e38f,
+        std::numeric_limits<float>::infinity(), -std::numeric_limits<float>::infinity(),
+        std::numeric_limits<float>::quiet_NaN()
+    };
+    return values[random() % (sizeof(values) / sizeof(values[0]))];
+}
+
+Points randomPoints(qsizetype count, std::mt19937& random, bool edgeCases)
+{
+    std::uniform_real_distribution<float> coordinate(-1000.0f, 1000.0f);
+    std::uniform_int_distribution<int> exponent(-20, 20);
+    Points p(count);
+    for (qsizetype i = 0; i < count; ++i) {
+        float* coordinates[3] = {&p.x[i], &p.y[i], &p.z[i]};
+        for (float* slot : coordinates) {
+            *slot = edgeCases && random() % 3 == 0
+                  ? edgeValue(random) : std::ldexp(coordinate(random), exponent(random));
+        }
+    }
+    return p;
+}
+
+bool sameBits(const float* a, const float* b, qsizetype count)
+{
+    return std::memcmp(a, b, size_t(count) * sizeof(float)) == 0;
+}
+
+// Bounds may keep either zero when both -0 and +0 occur
+bool sameBound(float a, float b)
+{
+    return (a == 0.0f && b == 0.0f) || std::memcmp(&a, &b, sizeof(float)) == 0;
+}
+
+void check(bool ok, const char* kernel, Isa isa, qsizetype count, const char* input)
+{
+    if (ok) return;
+    ++g_failures;
+    std::printf("FAIL %s: %s differs from Scalar for %lld %s points\n", kernel,
+                GeometryKernels::isaName(isa), static_cast<long long>(count), input);
+}
+
+void testFacetNormals(Isa isa, qsizetype count, std::mt19937& random, bool edgeCases,
+                      const char* input)
+{
+    const Points a = randomPoints(count, random, edgeCases);
+    Points b = randomPoints(count, random, edgeCases);
+    const Points c = randomPoints(count, random, edgeCases);
+    // Some degenerate facets: b repeats a
+    for (qsizetype i = 0; i < count; i += 5) {
+        b.x[i] = a.x[i];
+        b.y[i] = a.y[i];
+        b.z[i] = a.z[i];
+    }
+    
+    Points expected(count);
+    Points actual(count);
+    GeometryKernels::setActiveIsa(Isa::Scalar);
+    GeometryKernels::facetNormals(a.constSoa(), b.constSoa(), c.constSoa(), expected.soa(), count);
+    GeometryKernels::setActiveIsa(isa);
+    GeometryKernels::facetNormals(a.constSoa(), b.constSoa(), c.constSoa(), actual.soa(), count);
+    
+    check(sameBits(expected.x.data(), actual.x.data(), count)
+          && sameBits(expected.y.data(), actual.y.data(), count)
+          && sameBits(expected.z.data(), actual.z.data(), count),
+          "facetNormals", isa, count, input);
+}
+
+void testExtendBounds(Isa isa, qsizetype count, std::mt19937& random, bool edgeCases,
+                      const char* input)
+{
+    const Points p = randomPoints(count, random, edgeCases);
+    const float start = std::numeric_limits<float>::max();
+    float expectedMin[3] = {start, start, start};
+    float expectedMax[3] = {-start, -start, -start};
+    float actualMin[3] = {start, start, start};
+    float actualMax[3] = {-start, -start, -start};
+    
+    GeometryKernels::setActiveIsa(Isa::Scalar);
+    GeometryKernels::extendBounds(p.constSoa(), count, expectedMin, expectedMax);
+    GeometryKernels::setActiveIsa(isa);
+    GeometryKernels::extendBounds(p.constSoa(), count, actualMin, actualMax);
+    
+    bool ok = true;
+    for (int axis = 0; axis < 3; ++axis) {
+        ok = ok && sameBound(expectedMin[axis], actualMin[axis])
+                && sameBound(expectedMax[axis], actualMax[axis]);
+    }
+    check(ok, "extendBounds", isa, count, input);
+}
+
+void testTranslateScale(Isa isa, qsizetype count, std::mt19937& random, bool edgeCases,
+                        const char* input)
+{
+    Points expected = randomPoints(count, random, edgeCases);
+    Points actual = expected;
+    const float translation[3] = {-12.375f, 0.1f, 3e5f};
+    const float scale = 0.0137f;
+    
+    GeometryKernels::setActiveIsa(Isa::Scalar);
+    GeometryKernels::translateScale(expected.soa(), count, translation, scale);
+    GeometryKernels::setActiveIsa(isa);
+    GeometryKernels::translateScale(actual.soa(), count, translation, scale);
+    
+    check(sameBits(expected.x.data(), actual.x.data(), count)
+          && sameBits(expected.y.data(), actual.y.data(), count)
+          && sameBits(expected.z.data(), actual.z.data(), count),
+          "translateScale", isa, count, input);
+}
+
+void testTransform(Isa isa, qsizetype count, std::mt19937& random, bool edgeCases,
+                   const char* input)
+{
+    Points expected = randomPoints(count, random, edgeCases);
+    Points actual = expected;
+    std::uniform_real_distribution<float> element(-2.0f, 2.0f);
+    float matrix[16];
+    for (float& m : matrix) {
+        m = element(random);
+    }
+    matrix[3] = matrix[7] = matrix[11] = 0.0f;
+    matrix[15] = 1.0f;
+    
+    GeometryKernels::setActiveIsa(Isa::Scalar);
+    GeometryKernels::transform(expected.soa(), count, matrix);
+    GeometryKernels::setActiveIsa(isa);
+    GeometryKernels::transform(actual.soa(), count, matrix);
+    
+    check(sameBits(expected.x.data(), actual.x.data(), count)
+          && sameBits(expected.y.data(), actual.y.data(), count)
+          && sameBits(expected.z.data(), actual.z.data(), count),
+          "transform", isa, count, input);
+}
+
+void testFacingWeight(Isa isa, qsizetype count, std::mt19937& random, bool edgeCases,
+                      const char* input)
+{
+    const Points n = randomPoints(count, random, edgeCases);
+    std::uniform_real_distribution<float> area(0.0f, 10.0f);
+    std::vector<float> weights(count);
+    for (float& w : weights) {
+        w = area(random);
+    }
+    const float direction[3] = {0.267f, -0.534f, 0.801f};
+    const float threshold = 0.7071f;
+    
+    std::vector<float> expectedDots(count);
+    std::vector<float> actualDots(count);
+    GeometryKernels::setActiveIsa(Isa::Scalar);
+    const float expected = GeometryKernels::facingWeight(n.constSoa(), weights.data(), count,
+                                                         direction, threshold, expectedDots.data());
+    GeometryKernels::setActiveIsa(isa);
+    const float actual = GeometryKernels::facingWeight(n.constSoa(), weights.data(), count,
+                                                       direction, threshold, actualDots.data());
+    
+    check(sameBits(&expected, &actual, 1)
+          && sameBits(expectedDots.data(), actualDots.data(), count),
+          "facingWeight", isa, count, input);
+}
+
+void testTrianglesCross(Isa isa, qsizetype count, std::mt19937& random, bool edgeCases,
+                        const char* input)
+{
+    // Corners in a small box so that about half the pairs cross
+    std::uniform_real_distribution<float> coordinate(-1.0f, 1.0f);
+    Points a[3] = {Points(count), Points(count), Points(count)};
+    Points b[3] = {Points(count), Points(count), Points(count)};
+    for (Points* corners : {a, b}) {
+        for (int k = 0; k < 3; ++k) {
+            for (qsizetype i = 0; i < count; ++i) {
+                corners[k].x[i] = coordinate(random);
+                corners[k].y[i] = coordinate(random);
+                corners[k].z[i] = coordinate(random);
+            }
+        }
+    }
+    if (edgeCases) {
+        // Shared corners and edges, coplanar and degenerate pairs, corners
+        // on the other plane, and special values
+        for (qsizetype i = 0; i < count; ++i) {
+            switch (i % 6) {
+            case 0:
+                b[0].x[i] = a[1].x[i];
+                b[0].y[i] = a[1].y[i];
+                b[0].z[i] = a[1].z[i];
+                break;
+            case 1:
+                for (int k = 0; k < 2; ++k) {
+                    b[k].x[i] = a[k].x[i];
+                    b[k].y[i] = a[k].y[i];
+                    b[k].z[i] = a[k].z[i];
+                }
+                break;
+            case 2:
+                for (Points* corners : {a, b}) {
+                    for (int k = 0; k < 3; ++k) {
+                        corners[k].z[i] = 0.25f;
+                    }
+                }
+                break;
+            case 3:
+                a[2].x[i] = a[0].x[i];
+                a[2].y[i] = a[0].y[i];
+                a[2].z[i] = a[0].z[i];
+                break;
+            case 4:
+                a[0].x[i] = edgeValue(random);
+                b[2].y[i] = edgeValue(random);
+                break;
+            default:
+                b[1].z[i] = a[0].z[i];
+                b[1].x[i] = a[0].x[i] * 0.5f;
+                break;
+            }
+        }
+    }
+    
+    const ConstPointsSoA cornersA[3] = {a[0].constSoa(), a[1].constSoa(), a[2].constSoa()};
+    const ConstPointsSoA cornersB[3] = {b[0].constSoa(), b[1].constSoa(), b[2].constSoa()};
+    std::unique_ptr<bool[]> expected(new bool[count + 1]());
+    std::unique_ptr<bool[]> actual(new bool[count + 1]());
+    GeometryKernels::setActiveIsa(Isa::Scalar);
+    GeometryKernels::trianglesCross(cornersA, cornersB, count, expected.get());
+    GeometryKernels::setActiveIsa(isa);
+    GeometryKernels::trianglesCross(cornersA, cornersB, count, actual.get());
+    
+    check(std::equal(expected.get(), expected.get() + count, actual.get()),
+          "trianglesCross", isa, count, input);
+}
+
+// A triangle pair and whether it properly crosses
+struct CrossCase {
+    const char* name;
+    QVector3D a[3];
+    QVector3D b[3];
+    bool crosses;
+};
+
+// A is the right triangle with legs of 2 in the z = 0 plane
+const CrossCase kCrossCases[] = {
+    {"clear crossing",
+     {{0, 0, 0}, {2, 0, 0}, {0, 2, 0}}, {{0.5f, 0.2f, -1}, {0.5f, 0.2f, 1}, {0.5f, 1, 0}}, true},
+    {"shared edge",
+     {{0, 0, 0}, {2, 0, 0}, {0, 2, 0}}, {{0, 0, 0}, {2, 0, 0}, {0, 0, 2}}, false},
+    {"shared vertex",
+     {{0, 0, 0}, {2, 0, 0}, {0, 2, 0}}, {{0, 0, 0}, {-1, -1, 1}, {-1, 0, -1}}, false},
+    {"coplanar overlap",
+     {{0, 0, 0}, {2, 0, 0}, {0, 2, 0}}, {{0.5f, 0.5f, 0}, {3, 0.5f, 0}, {0.5f, 3, 0}}, false},
+    {"degenerate",
+     {{0, 0, 0}, {2, 0, 0}, {0, 2, 0}}, {{0.5f, 0.2f, -1}, {0.5f, 0.2f, 1}, {0.5f, 0.2f, 0}}, false}
+};
+
+void expect(bool ok, const char* test, const char* name)
+{
+    if (ok) return;
+    ++g_failures;
+    std::printf("FAIL %s: %s\n", test, name);
+}
+
+// Each case alone through MeshInterference, then all of them repeated past
+// the widest vector width in one kernel call, so every lane sees each case
+void testTrianglesCrossKnownAnswers(Isa isa)
+{
+    const qsizetype caseCount = qsizetype(sizeof(kCrossCases) / sizeof(kCrossCases[0]));
+    for (const CrossCase& c : kCrossCases) {
+        expect(MeshInterference::trianglesIntersect(c.a[0], c.a[1], c.a[2], c.b[0], c.b[1], c.b[2])
+                   == c.crosses,
+               GeometryKernels::isaName(isa), c.name);
+        expect(MeshInterference::trianglesIntersect(c.b[0], c.b[1], c.b[2], c.a[0], c.a[1], c.a[2])
+                   == c.crosses,
+               GeometryKernels::isaName(isa), c.name);
+    }
+    
+    const qsizetype count = caseCount * 7;
+    Points a[3] = {Points(count), Points(count), Points(count)};
+    Points b[3] = {Points(count), Points(count), Points(count)};
+    for (qsizetype i = 0; i < count; ++i) {
+        const CrossCase& c = kCrossCases[i % caseCount];
+        for (int k = 0; k < 3; ++k) {
+            a[k].x[i] = c.a[k].x();
+            a[k].y[i] = c.a[k].y();
+            a[k].z[i] = c.a[k].z();
+            b[k].x[i] = c.b[k].x();
+            b[k].y[i] = c.b[k].y();
+            b[k].z[i] = c.b[k].z();
+        }
+    }
+    const ConstPointsSoA cornersA[3] = {a[0].constSoa(), a[1].constSoa(), a[2].constSoa()};
+    const ConstPointsSoA cornersB[3] = {b[0].constSoa(), b[1].constSoa(), b[2].constSoa()};
+    std::unique_ptr<bool[]> hits(new bool[count]());
+    GeometryKernels::trianglesCross(cornersA, cornersB, count, hits.get());
+    for (qsizetype i = 0; i < count; ++i) {
+        const CrossCase& c = kCrossCases[i % caseCount];
+        expect(hits[i] == c.crosses, GeometryKernels::isaName(isa), c.name);
+    }
+}
+
+// The twelve facets of the unit cube [0, 1]^3, wound outwards
+QVector<Triangle> unitCube()
+{
+    const int faces[6][4] = {
+        {0, 2, 3, 1}, {4, 5, 7, 6}, {0, 1, 5, 4}, {2, 6, 7, 3}, {0, 4, 6, 2}, {1, 3, 7, 5}
+    };
+    auto corner = [](int i) { return QVector3D(float(i & 1), float((i >> 1) & 1), float((i >> 2) & 1)); };
+    QVector<Triangle> triangles;
+    for (const auto& face : faces) {
+        for (int half = 0; half < 2; ++half) {
+            Triangle t;
+            t.vertex1 = corner(face[0]);
+            t.vertex2 = corner(face[1 + half]);
+            t.vertex3 = corner(face[2 + half]);
+            t.normal = QVector3D::normal(t.vertex1, t.vertex2, t.vertex3);
+            triangles.append(t);
+        }
+    }
+    return triangles;
+}
+
+bool near(const QVector3D& p, const QVector3D& q)
+{
+    return (p - q).lengthSquared() < 1e-10f;
+}
+
+void testTriangleDistance()
+{
+    const QVector<Triangle> cube = unitCube();
+    const char* test = "triangleDistanceSquared";
+    auto distance = [&](const Triangle& t, const Triangle& u, QVector3D& pointA, QVector3D& pointB) {
+        return MeshInterference::triangleDistanceSquared(t.vertex1, t.vertex2, t.vertex3,
+                                                         u.vertex1, u.vertex2, u.vertex3, pointA, pointB);
+    };
+    QVector3D pointA;
+    QVector3D pointB;
+    
+    // Opposite faces: bottom (z = 0) and top (z = 1)
+    expect(std::fabs(distance(cube[0], cube[2], pointA, pointB) - 1.0f) < 1e-6f, test, "opposite faces");
+    expect(std::fabs(pointB.z() - pointA.z() - 1.0f) < 1e-6f, test, "opposite faces points");
+    
+    // Facets of the bottom and front faces, which meet at the origin
+    expect(distance(cube[0], cube[4], pointA, pointB) < 1e-12f, test, "touching faces");
+    
+    // The top facets against a copy moved out past the corner (1, 1, 1):
+    // the closest points are that corner and the copy's nearest corner
+    Triangle apart = cube[3];
+    const QVector3D shift(1.0f, 1.0f, 1.0f);
+    apart.vertex1 += shift;
+    apart.vertex2 += shift;
+    apart.vertex3 += shift;
+    const float d2 = distance(cube[3], apart, pointA, pointB);
+    expect(std::fabs(d2 - 1.0f) < 1e-6f, test, "corner to copy");
+    expect(near(pointA, QVector3D(1, 1, 1)) && near(pointB, QVector3D(1, 1, 2)), test,
+           "corner to copy points");
+    
+    // Symmetric in its arguments
+    expect(std::fabs(distance(apart, cube[3], pointB, pointA) - d2) < 1e-6f, test, "swapped");
+}
+
+void testContains()
+{
+    const TriangleBVH tree(unitCube());
+    const char* test = "TriangleBVH::contains";
+    const QVector3D inside[] = {{0.5f, 0.5f, 0.5f}, {0.1f, 0.9f, 0.2f}, {0.99f, 0.01f, 0.5f}};
+    const QVector3D outside[] = {{1.5f, 0.5f, 0.5f}, {-0.1f, 0.5f, 0.5f}, {0.5f, 0.5f, 1.01f},
+                                 {2.0f, 2.0f, 2.0f}, {-1.0f, -1.0f, -1.0f}};
+    for (const QVector3D& p : inside) {
+        expect(tree.contains(p), test, "point inside");
+    }
+    for (const QVector3D& p : outside) {
+        expect(!tree.contains(p), test, "point outside");
+    }
+    expect(!TriangleBVH().contains(QVector3D(0.5f, 0.5f, 0.5f)), test, "empty tree");
+}
+
+} // namespace
+
+int main()
+{
+    std::mt19937 random(20240611);
+    for (Isa isa : kIsas) {
+        if (!GeometryKernels::setActiveIsa(isa)) {
+            std::printf("SKIP %s: not supported by this CPU\n", GeometryKernels::isaName(isa));
+            continue;
+        }
+        const int failuresBefore = g_failures;
+        for (qsizetype count : kCounts) {
+            for (bool edgeCases : {false, true}) {
+                const char* input = edgeCases ? "edge-case" : "random";
+                testFacetNormals(isa, count, random, edgeCases, input);
+                testExtendBounds(isa, count, random, edgeCases, input);
+                testTranslateScale(isa, count, random, edgeCases, input);
+                testTransform(isa, count, random, edgeCases, input);
+                testFacingWeight(isa, count, random, edgeCases, input);
+                testTrianglesCross(isa, count, random, edgeCases, input);
+            }
+        }
+        testTrianglesCrossKnownAnswers(isa);
+        std::printf("%s %s\n", g_failures == failuresBefore ? "PASS" : "FAIL",
+                    GeometryKernels::isaName(isa));
+    }
+    
+    const int failuresBefore = g_failures;
+    testTriangleDistance();
+    testContains();
+    std::printf("%s triangle distance and containment\n", g_failures == failuresBefore ? "PASS" : "FAIL");
+    return g_failures == 0 ? 0 : 1;
+}